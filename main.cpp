@@ -1,164 +1,687 @@
+#include <algorithm>
 #include <iostream>
-#include <fstream>
+#include <memory>
 #define _USE_MATH_DEFINES
 #include <cmath>
-#include "src/geometry/geometry.h"
+#include <string>
+#include <utility>
+#include <vector>
+#include "src/accel/bvh.h"
+#include "src/kernels/kernels.h"
+#include "src/lib/aabb.h"
 #include "src/lib/ray.h"
+#include "src/lib/ray_buffer.h"
+#include "src/lib/ray_packet.h"
 #include "src/lib/point.h"
 #include "src/lib/vector.h"
+#include "src/raytracer/framebuffer.h"
+#include "src/raytracer/image_writer.h"
+#include "src/raytracer/integrator.h"
+#include "src/raytracer/pixel_estimate.h"
+#include "src/raytracer/sampler.h"
+#include "src/raytracer/thread_pool.h"
+#include "src/raytracer/wavefront.h"
 #include "src/scene/camera.h"
+#include "src/scene/scene.h"
+#include "src/utils/KeyframeReader.cpp"
 #include "src/utils/ObjReader.cpp"
+#include "src/utils/SceneReader.cpp"
 
-template <typename T>
-T clamp(T value, T min, T max) {
-    return (value < min) ? min : (value > max) ? max : value;
-}
-
-// Objetos da cena: duas esferas e um plano
-Geometry::Sphere sphere_1(Point(2.0f, -4.5f, -2.0f), 0.5f); // point ((x, y, z), raio)
-Geometry::Sphere sphere_2(Point(0.0f, -4.0f, -2.0f), 1.0f);
-Geometry::Sphere sphere_3(Point(-3.0f, -3.5f, -2.0f), 1.5f);
+// A BVH de cada malha (um grupo do .obj) fica no cache .rtmesh do .obj: é reaproveitada quando
+// existe, senão é construída e guardada no objReader (built indica isso). Com lazy, uma malha fora
+// do cache só tem o topo da BVH construído, e nada é guardado.
+Accel::BuildStats build_mesh(Scene& scene, uint32_t id, objReader& obj, size_t group, const Accel::BuildOptions& options,
+                             bool use_cache, bool lazy, bool& built)
+{
+    std::vector<cachedBvhNode> cached_nodes;
+    std::vector<uint32_t> cached_indices;
+    built = false;
+    if (use_cache && obj.getCachedBvh(group, cached_nodes, cached_indices))
+    {
+        std::vector<Accel::BVHNode> nodes;
+        nodes.reserve(cached_nodes.size());
+        for (const auto& node : cached_nodes)
+        {
+            AABB bounds {};
+            bounds.min = Point(node.min[0], node.min[1], node.min[2]);
+            bounds.max = Point(node.max[0], node.max[1], node.max[2]);
+            nodes.push_back(Accel::BVHNode { bounds, node.offset, node.count });
+        }
+        if (scene.assign_mesh_bvh(id, std::move(nodes), std::move(cached_indices)))
+        {
+            Accel::BuildStats stats {};
+            stats.sah_cost = scene.get_mesh_bvh(id).sah_cost();
+            stats.node_count = scene.get_mesh_bvh(id).get_nodes().size();
+            return stats;
+        }
+    }
 
+    if (lazy)
+    {
+        return scene.build_mesh_lazy(id, options);
+    }
 
-// 1 - (5,  0, 0), (-1, 0, 0), Green;
-// 2 - (-5, 0, 0), (1, 0, 0), Red;
-// 3 - (0, -5, 0), (0, 1, 0), White;
-// 4 - (0,  5, 0), (0, -1, 0), White;
-// 5 - (0, 0, -5), (0, 0, 1), White;
-// 6 - (0, 0, 6), (0, 0, -1), White;
+    Accel::BuildStats stats = scene.build_mesh(id, options);
+    built = true;
 
-Geometry::Plane plane1(Point(5.0f, 0.0f, 0.0f), Vector(-1.0f, 0.0f, 0.0f));
-Geometry::Plane plane2(Point(-5.0f, 0.0f, 0.0f), Vector(1.0f, 0.0f, 0.0f));
-Geometry::Plane plane3(Point(0.0f, -5.0f, 0.0f), Vector(0.0f, 1.0f, 0.0f));
-Geometry::Plane plane4(Point(0.0f, 4.0f, 0.0f), Vector(0.0f, -1.0f, 0.0f));
-Geometry::Plane plane5(Point(0.0f, 0.0f, -5.0f), Vector(0.0f, 0.0f, 1.0f));
-Geometry::Plane plane6(Point(0.0f, 0.0f, 6.0f), Vector(0.0f, 0.0f, -1.0f));
+    if (use_cache)
+    {
+        cached_nodes.clear();
+        for (const auto& node : scene.get_mesh_bvh(id).get_nodes())
+        {
+            cached_nodes.push_back({ { node.bounds.min.x, node.bounds.min.y, node.bounds.min.z },
+                                     { node.bounds.max.x, node.bounds.max.y, node.bounds.max.z },
+                                     node.offset, node.count });
+        }
+        obj.storeBvh(group, std::move(cached_nodes), scene.get_mesh_bvh(id).get_indices());
+    }
+    return stats;
+}
 
+void report_build(const std::string& name, const Accel::BuildStats& stats)
+{
+    std::cout << name << " BVH: " << stats.node_count << " nodes, "
+              << stats.build_ms << " ms, SAH cost " << stats.sah_cost << "\n";
+}
 
-Vector color(const Ray& ray){
-    float closest_t = std::numeric_limits<float>::max();
-    Vector final_color;
-    bool any_hit = false;
+void report_memory(const std::string& name, size_t before, size_t after, size_t triangles)
+{
+    const double per_triangle = triangles > 0 ? 1.0 / triangles : 0.0;
+    std::cout << name << ": " << before * per_triangle << " -> " << after * per_triangle << " bytes per triangle\n";
+}
 
-    auto hit1 = sphere_1.hit(ray);
-    if (hit1.hit && hit1.t < closest_t) {
-        closest_t = hit1.t;
-        final_color = Vector(1.0f, 0.0f, 0.0f);  
-        any_hit = true;
+// Quanto das BVHs sob demanda os raios chegaram a construir
+void report_lazy(const Scene& scene)
+{
+    size_t clusters = 0, expanded = 0, nodes = 0;
+    for (uint32_t id = 0; id < scene.mesh_count(); ++id)
+    {
+        const Accel::LazyBVH& lazy = scene.get_mesh_lazy_bvh(id);
+        clusters += lazy.cluster_count();
+        expanded += lazy.empty() ? 0 : lazy.expanded_clusters();
+        nodes += lazy.empty() ? 0 : lazy.node_count();
     }
-
-    auto hit2 = sphere_2.hit(ray);
-    if (hit2.hit && hit2.t < closest_t) {
-        closest_t = hit2.t;
-        final_color = Vector(0.0f, 1.0f, 0.0f);  
-        any_hit = true;
+    if (clusters > 0)
+    {
+        std::cout << "Lazy BVH: " << expanded << " of " << clusters << " clusters built, " << nodes << " nodes\n";
     }
+}
 
-    auto hit3 = sphere_3.hit(ray);
-    if (hit3.hit && hit3.t < closest_t) {
-        closest_t = hit3.t;
-        final_color = Vector(0.2f, 0.2f, 0.7f);  
-        any_hit = true;
+// Como o cache de tijolos das malhas fora da memória se saiu
+void report_bricks(const Scene& scene)
+{
+    const BrickCacheStats stats = scene.get_brick_stats();
+    const uint64_t accesses = stats.hits + stats.misses + stats.duplicate_reads;
+    if (accesses == 0)
+    {
+        return;
     }
-
-    auto hit_plane1 = plane1.hit(ray);
-    if (hit_plane1.hit && hit_plane1.t < closest_t) {
-        closest_t = hit_plane1.t;
-        final_color = Vector(0.0f, 1.0f, 0.0f);  
-        any_hit = true;
+    const double mb = 1.0 / (1024.0 * 1024.0);
+    std::cout << "Bricks: " << stats.hits << " hits, " << stats.misses << " misses ("
+              << 100.0 * stats.hits / accesses << "% hits), " << stats.duplicate_reads << " duplicate reads, "
+              << stats.evictions << " evictions, " << stats.bytes_read * mb << " MB read, peak "
+              << stats.peak_bytes * mb << " MB resident\n";
+    if (stats.failures > 0)
+    {
+        std::cerr << "Warning: " << stats.failures << " bricks could not be read and were left empty\n";
     }
+}
 
-    auto hit_plane2 = plane2.hit(ray);
-    if (hit_plane2.hit && hit_plane2.t < closest_t) {
-        closest_t = hit_plane2.t;
-        final_color = Vector(1.0f, 0.0f, 0.0f); 
-        any_hit = true;
-    }
+// Versão em pacote do primeiro raio: oito raios primários vizinhos são testados de uma vez e
+// o integrador continua cada um a partir do ponto atingido
+void color_packet(const Scene& scene, const RT::Integrator& integrator, const RayPacket8& rays, const uint32_t* seeds,
+                  Vector* colors)
+{
+    RT::Trace hits[RayPacket8::size];
+    scene.trace(rays, hits);
 
-    auto hit_plane3 = plane3.hit(ray);
-    if (hit_plane3.hit && hit_plane3.t < closest_t) {
-        closest_t = hit_plane3.t;
-        final_color = Vector(0.73f, 0.73f, 0.73f);  
-        any_hit = true;
+    for (size_t lane = 0; lane < RayPacket8::size; ++lane) {
+        colors[lane] = integrator.radiance(rays.get(lane), hits[lane], seeds[lane]);
     }
+}
+
+// Grava em colors[first ..] a cor dos raios rays[first .. first + count): pacotes de 8 e o resto raio a raio.
+// seeds[i] escolhe a sequência aleatória do raio i, que só depende do pixel e da amostra.
+void shade_rays(const Scene& scene, const RT::Integrator& integrator, const RayBuffer& rays, const uint32_t* seeds,
+                size_t first, uint32_t count, Vector* colors)
+{
+    RayPacket8 packet;
+    uint32_t i = 0;
 
-    auto hit_plane4 = plane4.hit(ray);
-    if (hit_plane4.hit && hit_plane4.t < closest_t) {
-        closest_t = hit_plane4.t;
-        final_color = Vector(0.73f, 0.73f, 0.73f);  
-        any_hit = true;
+    for (; i + RayPacket8::size <= count; i += RayPacket8::size)
+    {
+        rays.load(first + i, packet);
+        color_packet(scene, integrator, packet, seeds + first + i, colors + first + i);
+    }
+    for (; i < count; ++i)
+    {
+        colors[first + i] = integrator.radiance(rays.get(first + i), seeds[first + i]);
     }
+}
+
+// Tamanho (em pixels) dos blocos distribuídos entre as threads
+constexpr uint32_t tile_size = 16;
+
+// Amostras do passe inicial e de cada rodada da amostragem adaptativa
+constexpr uint32_t adaptive_batch = 8;
+
+// Amostras de cada pixel geradas e traçadas juntas no passe inicial
+constexpr uint32_t samples_per_batch = 16;
 
-    auto hit_plane5 = plane5.hit(ray);
-    if (hit_plane5.hit && hit_plane5.t < closest_t) {
-        closest_t = hit_plane5.t;
-        final_color = Vector(0.73f, 0.73f, 0.73f);  
-        any_hit = true;
+struct RenderSettings
+{
+    RT::Sampler sampler {};
+    uint32_t samples { 1 };        // por pixel; com amostragem adaptativa, o máximo
+    float adaptive_threshold {};   // erro padrão aceito na média do pixel; 0 = sem amostragem adaptativa
+    bool wavefront {};             // traça os lotes com RT::Wavefront em vez de raio a raio
+    bool sort_rays { true };       // ordenação dos raios no modo wavefront
+};
+
+// Buffers de cada thread, reaproveitados de um tile para o outro
+struct TileScratch
+{
+    RayBuffer rays;
+    std::vector<Vector> colors;
+    std::vector<float> offset_x, offset_y;
+    std::vector<RT::PixelEstimate> estimates;
+    std::vector<uint32_t> seeds;       // sequência aleatória de cada raio
+    std::vector<uint32_t> ray_pixel;   // pixel do tile de cada raio de uma rodada adaptativa
+    std::unique_ptr<RT::Wavefront> wavefront;
+    uint64_t samples {};               // total de amostras desta thread
+};
+
+// Com samples == 1 cada pixel recebe um único raio pelo seu ponto da grade; com mais
+// amostras os raios são espalhados pela área do pixel segundo o sampler e a cor do
+// pixel é a média deles. Com adaptive_threshold > 0, depois de um passe inicial de
+// adaptive_batch amostras só os pixels cujo erro ainda passa do limite recebem mais,
+// adaptive_batch por rodada, até samples. A amostra i de um pixel depende só dele e
+// de i, então a imagem não depende da divisão do trabalho entre as threads.
+void render_tile(const Scene& scene, const RT::Integrator& integrator, const Camera& camera,
+                 const RenderSettings& settings, const RT::Tile& tile, uint32_t image_width, uint32_t image_height,
+                 TileScratch& buffers)
+{
+    const uint32_t tile_width = tile.x1 - tile.x0;
+    const size_t pixels = static_cast<size_t>(tile_width) * (tile.y1 - tile.y0);
+    const bool adaptive = settings.adaptive_threshold > 0.0f && settings.samples > adaptive_batch;
+    const uint32_t base = adaptive ? adaptive_batch : settings.samples;
+
+    if (settings.wavefront && !buffers.wavefront)
+    {
+        buffers.wavefront = std::make_unique<RT::Wavefront>(integrator, settings.sort_rays);
     }
 
-    auto hit_plane6 = plane6.hit(ray);
-    if (hit_plane6.hit && hit_plane6.t < closest_t) {
-        closest_t = hit_plane6.t;
-        final_color = Vector(0.73f, 0.73f, 0.73f);  
-        any_hit = true;
+    // Cor de rays[first .. first + count): no modo wavefront o lote inteiro passa junto por
+    // cada etapa; senão, pacotes de 8 raios vizinhos numa linha
+    auto shade = [&](size_t first, size_t count, size_t row_width) {
+        if (settings.wavefront)
+        {
+            buffers.wavefront->radiance(buffers.rays, buffers.seeds.data(), first, count, buffers.colors.data());
+            return;
+        }
+        for (size_t row = first; row < first + count; row += row_width)
+        {
+            shade_rays(scene, integrator, buffers.rays, buffers.seeds.data(), row,
+                       static_cast<uint32_t>(std::min(row_width, first + count - row)), buffers.colors.data());
+        }
+    };
+
+    buffers.estimates.assign(pixels, RT::PixelEstimate {});
+    buffers.offset_x.resize(tile_width);
+    buffers.offset_y.resize(tile_width);
+
+    // Passe inicial: todos os pixels, até samples_per_batch amostras de cada por vez; os
+    // raios primários são gerados linha a linha, a amostra s do pixel p em s * pixels + p
+    for (uint32_t batch_first = 0; batch_first < base; batch_first += samples_per_batch)
+    {
+        const uint32_t batch = std::min(samples_per_batch, base - batch_first);
+        buffers.rays.resize(batch * pixels);
+        buffers.colors.resize(batch * pixels);
+        buffers.seeds.resize(batch * pixels);
+
+        for (uint32_t s = 0; s < batch; ++s)
+        {
+            const uint32_t sample = batch_first + s;
+            for (uint32_t row = tile.y0; row < tile.y1; ++row)
+            {
+                const uint32_t py = image_height - 1 - row;
+                const size_t first = s * pixels + static_cast<size_t>(row - tile.y0) * tile_width;
+                for (uint32_t i = 0; i < tile_width; ++i)
+                {
+                    buffers.seeds[first + i] = RT::hash_combine(py * image_width + tile.x0 + i, sample);
+                }
+                if (settings.samples == 1)
+                {
+                    camera.cast_row(tile.x0, py, tile_width, buffers.rays, first);
+                    continue;
+                }
+
+                for (uint32_t i = 0; i < tile_width; ++i)
+                {
+                    settings.sampler.sample_2d(py * image_width + tile.x0 + i, sample, buffers.offset_x[i], buffers.offset_y[i]);
+                    buffers.offset_x[i] -= 0.5f;
+                    buffers.offset_y[i] -= 0.5f;
+                }
+                camera.cast_row(tile.x0, py, tile_width, buffers.offset_x.data(), buffers.offset_y.data(), buffers.rays,
+                                first);
+            }
+        }
+
+        shade(0, batch * pixels, tile_width);
+        for (uint32_t s = 0; s < batch; ++s)
+        {
+            for (size_t p = 0; p < pixels; ++p)
+            {
+                buffers.estimates[p].add(buffers.colors[s * pixels + p]);
+            }
+        }
     }
+    buffers.samples += base * pixels;
 
+    // Rodadas adaptativas: só os pixels ainda ruidosos, numa lista de raios sem ordem de linha
+    while (adaptive)
+    {
+        size_t ray_count = 0;
+        for (const RT::PixelEstimate& estimate : buffers.estimates)
+        {
+            if (estimate.count < settings.samples && estimate.error() > settings.adaptive_threshold)
+            {
+                ray_count += std::min(adaptive_batch, settings.samples - estimate.count);
+            }
+        }
+        if (ray_count == 0)
+        {
+            break;
+        }
+
+        buffers.rays.resize(ray_count);
+        buffers.colors.resize(ray_count);
+        buffers.seeds.resize(ray_count);
+        buffers.ray_pixel.resize(ray_count);
+
+        size_t next = 0;
+        for (uint32_t p = 0; p < pixels; ++p)
+        {
+            const RT::PixelEstimate& estimate = buffers.estimates[p];
+            if (estimate.count >= settings.samples || estimate.error() <= settings.adaptive_threshold)
+            {
+                continue;
+            }
+
+            const uint32_t x = tile.x0 + p % tile_width;
+            const uint32_t py = image_height - 1 - (tile.y0 + p / tile_width);
+            const uint32_t last = std::min(estimate.count + adaptive_batch, settings.samples);
+            for (uint32_t sample = estimate.count; sample < last; ++sample)
+            {
+                float offset_x {}, offset_y {};
+                settings.sampler.sample_2d(py * image_width + x, sample, offset_x, offset_y);
+                buffers.rays.set(next, camera.cast_sample(x + offset_x - 0.5f, py + offset_y - 0.5f));
+                buffers.seeds[next] = RT::hash_combine(py * image_width + x, sample);
+                buffers.ray_pixel[next++] = p;
+            }
+        }
 
-    if (!any_hit) {
-        Vector unit_direction = ray.direction.normalized();
-        float t = 0.5f * (unit_direction.y + 1.0f);
-        return Vector(1.0f, 1.0f, 1.0f) * (1.0f - t) + Vector(0.5f, 0.7f, 1.0f) * t;
+        shade(0, ray_count, ray_count);
+        for (size_t r = 0; r < ray_count; ++r)
+        {
+            buffers.estimates[buffers.ray_pixel[r]].add(buffers.colors[r]);
+        }
+        buffers.samples += ray_count;
     }
+}
 
-    return final_color;
+// Cor do mapa de amostras: preto (nenhuma) -> vermelho -> amarelo -> branco (o máximo)
+Vector heat_color(uint32_t samples, uint32_t max_samples)
+{
+    float t = 3.0f * static_cast<float>(samples) / static_cast<float>(max_samples);
+    return Vector(std::min(t, 1.0f), std::min(std::max(t - 1.0f, 0.0f), 1.0f), std::min(std::max(t - 2.0f, 0.0f), 1.0f));
 }
 
-void render_scene(const Camera& camera, const std::string& filename, uint32_t image_width, uint32_t image_height)
+// heatmap_filename, se não for vazio, recebe um mapa de amostras por pixel
+void render_scene(const Scene& scene, const RT::Integrator& integrator, const Camera& camera, const std::string& filename, uint32_t image_width,
+                  uint32_t image_height, RT::ThreadPool& pool, RT::ImageFormat format, const RenderSettings& settings,
+                  const std::string& heatmap_filename)
 {
-    std::ofstream image(filename);
-    if (!image)
+    // Cada tile é escrito por uma única thread, então o framebuffer dispensa locks.
+    // A linha 0 do framebuffer é o topo da imagem (py = image_height - 1).
+    RT::Framebuffer framebuffer { image_width, image_height };
+    std::vector<RT::Tile> tiles = framebuffer.make_tiles(tile_size);
+
+    // O arquivo é gravado em segundo plano, à medida que as linhas ficam prontas
+    RT::ImageWriter image { filename, framebuffer, format };
+    if (!image.is_open())
     {
         std::cerr << "Error creating " << filename << "\n";
         return;
     }
 
-    image << "P3\n" << image_width << " " << image_height << "\n255\n";
-
-    for (int j = image_height - 1; j >= 0; --j)
+    RT::Framebuffer heatmap;
+    std::unique_ptr<RT::ImageWriter> heatmap_image;
+    if (!heatmap_filename.empty())
     {
-        for (int i = 0; i < image_width; ++i)
+        heatmap = RT::Framebuffer { image_width, image_height };
+        heatmap_image = std::make_unique<RT::ImageWriter>(heatmap_filename, heatmap, format);
+        if (!heatmap_image->is_open())
         {
-            Vector pixel_color = color(camera.cast_ray(i, j));
+            std::cerr << "Error creating " << heatmap_filename << "\n";
+            heatmap_image.reset();
+        }
+    }
+
+    std::vector<TileScratch> scratch(pool.size());
+
+    pool.run(tiles.size(), [&](size_t index, unsigned worker) {
+        const RT::Tile& tile = tiles[index];
+        const uint32_t tile_width = tile.x1 - tile.x0;
+        TileScratch& buffers = scratch[worker];
 
-            int red   = static_cast<int>(255.99f * clamp(pixel_color.x, 0.0f, 1.0f));
-            int green = static_cast<int>(255.99f * clamp(pixel_color.y, 0.0f, 1.0f));
-            int blue  = static_cast<int>(255.99f * clamp(pixel_color.z, 0.0f, 1.0f));
+        render_tile(scene, integrator, camera, settings, tile, image_width, image_height, buffers);
+
+        for (uint32_t row = tile.y0; row < tile.y1; ++row)
+        {
+            for (uint32_t i = 0; i < tile_width; ++i)
+            {
+                const RT::PixelEstimate& estimate = buffers.estimates[static_cast<size_t>(row - tile.y0) * tile_width + i];
+                framebuffer.set(tile.x0 + i, row, estimate.mean);
+                if (heatmap_image)
+                {
+                    heatmap.set(tile.x0 + i, row, heat_color(estimate.count, settings.samples));
+                }
+            }
+        }
 
-            image << red << " " << green << " " << blue << "\n";
+        framebuffer.resolve(tile);
+        image.tile_done(tile);
+        if (heatmap_image)
+        {
+            heatmap.resolve(tile);
+            heatmap_image->tile_done(tile);
         }
+    });
+
+    uint64_t samples = 0;
+    for (const TileScratch& buffers : scratch)
+    {
+        samples += buffers.samples;
     }
+    std::cout << "Samples: " << samples << " ("
+              << static_cast<double>(samples) / (static_cast<double>(image_width) * image_height) << " per pixel)\n";
 
-    image.close();
+    if (heatmap_image)
+    {
+        if (heatmap_image->finish())
+        {
+            std::cout << "Sample map saved to " << heatmap_filename << "\n";
+        }
+        else
+        {
+            std::cerr << "Error writing " << heatmap_filename << "\n";
+        }
+    }
+
+    if (!image.finish())
+    {
+        std::cerr << "Error writing " << filename << "\n";
+        return;
+    }
     std::cout << "Image saved to " << filename << "\n";
 }
 
-int main()
+Camera make_camera(const View& view)
 {
-    // Point camera_position { 0.0f, 0.0f, 5.0f };
-    // Point look_at { 0.0f, 0.0f, 0.0f };
-    // Vector up_vector { 0.0f, 1.0f, 0.0f };
+    float vertical_fov = view.vertical_fov * M_PI / 180.0f;
+    return Camera { view.position, view.look_at, view.up, vertical_fov, view.height, view.width };
+}
 
-    // float vertical_fov = 90.0f * M_PI / 180.0f;
+// "output.ppm" no quadro 7 vira "output_0007.ppm"
+std::string frame_filename(const std::string& filename, uint32_t frame)
+{
+    std::string number = std::to_string(frame);
+    number.insert(0, number.size() < 4 ? 4 - number.size() : 0, '0');
 
-    // uint32_t image_height = 500;
-    // uint32_t image_width = 500;
+    const size_t dot = filename.find_last_of('.');
+    const size_t slash = filename.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    {
+        return filename + "_" + number;
+    }
+    return filename.substr(0, dot) + "_" + number + filename.substr(dot);
+}
 
-    // Camera camera { camera_position, look_at, up_vector, vertical_fov, image_height, image_width };
+int main(int argc, char* argv[])
+{
+    // --bvh sah|lbvh escolhe o construtor, --bvh-threads N limita as threads da BVH
+    // e --threads N as do render (padrão: std::thread::hardware_concurrency()).
+    // --p3 grava a imagem em PPM ASCII em vez de binário (P6).
+    // --no-cache lê o .obj e constrói a BVH sem usar (nem gravar) o cache .rtmesh.
+    // --scene arquivo escolhe a descrição da cena (padrão: inputs/default.scene).
+    // --spp N define as amostras por pixel e --sampler sobol|random como elas são distribuídas.
+    // --adaptive T para de amostrar os pixels cujo erro padrão fica abaixo de T (spp vira o máximo)
+    // e --spp-map arquivo grava o mapa de amostras por pixel.
+    // --integrator flat|whitted escolhe o sombreamento e --max-depth N o limite de reflexões/refrações.
+    // --wavefront traça lotes de raios em etapas (--no-ray-sort desliga a ordenação dos raios).
+    // --keys arquivo renderiza a sequência de quadros do arquivo (output_0000.ppm, ...), reajustando as
+    // BVHs a cada quadro; --rebuild-threshold R reconstrói as que ficam R vezes mais caras que ao construir.
+    // --lazy constrói só o topo da BVH das malhas fora do cache; o resto é construído quando um raio chega lá.
+    // --compress troca cada malha pela forma comprimida (vértices em 16 bits e BVH de 8 filhos em 8 bits);
+    // comprimir precisa da BVH inteira, então prevalece sobre --lazy.
+    // --out-of-core MB deixa as malhas no disco (arquivo .rtbricks ao lado do .obj) e guarda na memória
+    // no máximo MB megabytes dos tijolos lidos; essas malhas não passam por --lazy nem --compress.
+    // --isa nome força uma variante dos kernels (baseline, sse4.2, avx2, avx512) em vez da melhor que a CPU roda.
+    std::string scene_file = "inputs/default.scene";
+    Accel::BuildOptions bvh_options;
+    unsigned render_threads = 0;
+    RT::ImageFormat image_format = RT::ImageFormat::P6;
+    bool use_cache = true;
+    RenderSettings render_settings;
+    RT::SamplePattern sample_pattern = RT::SamplePattern::Sobol;
+    std::string heatmap_file;
+    RT::IntegratorSettings integrator_settings;
+    std::string keys_file;
+    float rebuild_threshold = 1.5f;
+    bool lazy = false;
+    bool compress = false;
+    bool out_of_core = false;
+    size_t brick_budget = BrickCache::default_budget;
+    std::string isa;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--bvh" && i + 1 < argc)
+        {
+            std::string method = argv[++i];
+            bvh_options.method = method == "lbvh" ? Accel::BuildMethod::LBVH : Accel::BuildMethod::BinnedSAH;
+        }
+        else if (arg == "--bvh-threads" && i + 1 < argc)
+        {
+            bvh_options.threads = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            render_threads = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--p3")
+        {
+            image_format = RT::ImageFormat::P3;
+        }
+        else if (arg == "--no-cache")
+        {
+            use_cache = false;
+        }
+        else if (arg == "--scene" && i + 1 < argc)
+        {
+            scene_file = argv[++i];
+        }
+        else if (arg == "--spp" && i + 1 < argc)
+        {
+            render_settings.samples = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        }
+        else if (arg == "--sampler" && i + 1 < argc)
+        {
+            std::string pattern = argv[++i];
+            sample_pattern = pattern == "random" ? RT::SamplePattern::Random : RT::SamplePattern::Sobol;
+        }
+        else if (arg == "--adaptive" && i + 1 < argc)
+        {
+            render_settings.adaptive_threshold = std::stof(argv[++i]);
+        }
+        else if (arg == "--spp-map" && i + 1 < argc)
+        {
+            heatmap_file = argv[++i];
+        }
+        else if (arg == "--integrator" && i + 1 < argc)
+        {
+            std::string kind = argv[++i];
+            integrator_settings.kind = kind == "flat" ? RT::IntegratorKind::Flat : RT::IntegratorKind::Whitted;
+        }
+        else if (arg == "--wavefront")
+        {
+            render_settings.wavefront = true;
+        }
+        else if (arg == "--no-ray-sort")
+        {
+            render_settings.sort_rays = false;
+        }
+        else if (arg == "--max-depth" && i + 1 < argc)
+        {
+            integrator_settings.max_depth = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        }
+        else if (arg == "--keys" && i + 1 < argc)
+        {
+            keys_file = argv[++i];
+        }
+        else if (arg == "--rebuild-threshold" && i + 1 < argc)
+        {
+            rebuild_threshold = std::stof(argv[++i]);
+        }
+        else if (arg == "--lazy")
+        {
+            lazy = true;
+        }
+        else if (arg == "--compress")
+        {
+            compress = true;
+        }
+        else if (arg == "--out-of-core" && i + 1 < argc)
+        {
+            out_of_core = true;
+            brick_budget = static_cast<size_t>(std::stod(argv[++i]) * 1024.0 * 1024.0);
+        }
+        else if (arg == "--isa" && i + 1 < argc)
+        {
+            isa = argv[++i];
+        }
+    }
+
+    if (!isa.empty())
+    {
+        if (const Kernels::Table* kernels = Kernels::find(isa))
+        {
+            Kernels::use(*kernels);
+        }
+        else
+        {
+            std::string names;
+            for (const std::string& name : Kernels::available())
+            {
+                names += " " + name;
+            }
+            std::cerr << "Warning: kernels " << isa << " not available on this CPU (available:" << names << ")\n";
+        }
+    }
+    std::cout << "Kernels: " << Kernels::active().name << "\n";
 
-    // render_scene(camera, "output.ppm", image_width, image_height);
-    objReader obj("inputs/cubo.obj");
+    Scene scene;
+    scene.set_brick_budget(brick_budget);
+    sceneReader description { scene_file, scene, use_cache, bvh_options.threads, out_of_core };
+    if (!description.is_open())
+    {
+        return 1;
+    }
+
+    report_build("Spheres", scene.build_spheres(bvh_options));
+    for (size_t file = 0; file < description.objCount(); ++file)
+    {
+        // As malhas no disco já vêm com as BVHs dos tijolos prontas
+        if (description.isOutOfCore(file))
+        {
+            const std::vector<std::string>& names = description.getGroupNames(file);
+            for (size_t group = 0; group < names.size(); ++group)
+            {
+                const BrickMesh& bricks = scene.get_mesh_bricks(description.getFirstMesh(file) + static_cast<uint32_t>(group));
+                std::cout << "Mesh (out of core) " << names[group] << ": " << bricks.triangle_count() << " triangles in "
+                          << bricks.brick_count() << " bricks, " << bricks.memory_bytes() << " bytes resident\n";
+            }
+            continue;
+        }
 
-    obj.print_faces();
+        objReader& obj = description.getObj(file);
+        Span<const meshGroup> groups = obj.getGroups();
+        const std::vector<uint32_t> indices = compress ? obj.getIndices() : std::vector<uint32_t> {};
+        bool store = false;
+        for (size_t group = 0; group < groups.size(); ++group)
+        {
+            const uint32_t id = description.getFirstMesh(file) + static_cast<uint32_t>(group);
+            bool built = false;
+            Accel::BuildStats stats = build_mesh(scene, id, obj, group, bvh_options, use_cache, lazy && !compress, built);
+            const char* kind = !scene.get_mesh_lazy_bvh(id).empty() ? "Mesh (lazy) " : built ? "Mesh " : "Mesh (cached) ";
+            report_build(kind + groups[group].name, stats);
+            store |= built;
+
+            if (compress)
+            {
+                const Span<const uint32_t> faces(indices.data() + 3 * groups[group].firstFace, 3 * groups[group].faceCount);
+                const size_t before = scene.mesh_memory(id);
+                if (scene.compress_mesh(id, obj.getVertices(), faces))
+                {
+                    report_memory("Mesh (compressed) " + groups[group].name, before, scene.mesh_memory(id),
+                                  scene.triangle_count(id));
+                }
+                else
+                {
+                    std::cerr << "Warning: could not compress mesh " << groups[group].name << "\n";
+                }
+            }
+        }
+        if (use_cache && store && !obj.saveCache())
+        {
+            std::cerr << "Warning: could not update the .rtmesh cache of mesh file " << file << "\n";
+        }
+    }
+    report_build("Instances (" + std::to_string(scene.instance_count()) + " of " + std::to_string(scene.mesh_count()) +
+                     " meshes)",
+                 scene.build_instances(bvh_options));
+
+    RT::ThreadPool pool { render_threads };
+    RT::Integrator integrator { scene, integrator_settings };
+    render_settings.sampler = RT::Sampler { sample_pattern };
+
+    if (keys_file.empty())
+    {
+        render_scene(scene, integrator, make_camera(scene.view), "output.ppm", scene.view.width, scene.view.height, pool,
+                     image_format, render_settings, heatmap_file);
+        report_lazy(scene);
+        report_bricks(scene);
+        return 0;
+    }
+
+    keyframeReader keys { keys_file };
+    if (!keys.is_open())
+    {
+        return 1;
+    }
+
+    for (uint32_t frame = 0; keys.nextFrame(scene, description, use_cache, bvh_options.threads); ++frame)
+    {
+        const UpdateStats stats = scene.update(bvh_options, rebuild_threshold);
+        std::cout << "Frame " << frame << ": update " << stats.update_ms << " ms (" << stats.refits << " refits, "
+                  << stats.rebuilds << " rebuilds)\n";
+
+        const View& view = scene.view;
+        render_scene(scene, integrator, make_camera(view), frame_filename("output.ppm", frame), view.width, view.height,
+                     pool, image_format, render_settings, heatmap_file.empty() ? "" : frame_filename(heatmap_file, frame));
+        report_lazy(scene);
+        report_bricks(scene);
+    }
 
     return 0;
 }
@@ -0,0 +1,497 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include "bvh.h"
+
+namespace Accel
+{
+    namespace
+    {
+        constexpr uint32_t fork_threshold = 4096;          // smallest subtree handed to another thread
+        constexpr uint32_t parallel_scan_threshold = 1 << 16; // smallest node whose bins are filled in parallel
+
+        // Splits [0, count) into one contiguous chunk per thread and runs
+        // body(begin, end, chunk) on each of them.
+        template <typename Body>
+        void parallel_for(size_t count, unsigned threads, Body&& body)
+        {
+            threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(count, 1)));
+            if (threads <= 1)
+            {
+                body(size_t { 0 }, count, 0u);
+                return;
+            }
+
+            std::vector<std::thread> workers;
+            workers.reserve(threads - 1);
+            const size_t chunk = (count + threads - 1) / threads;
+            for (unsigned t = 1; t < threads; ++t)
+            {
+                size_t begin = std::min(count, t * chunk);
+                size_t end = std::min(count, begin + chunk);
+                workers.emplace_back([&body, begin, end, t] { body(begin, end, t); });
+            }
+            body(size_t { 0 }, std::min(count, chunk), 0u);
+
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+        }
+
+        // Spreads the 10 low bits of v so that there are two zero bits between each.
+        uint32_t expand_bits(uint32_t v)
+        {
+            v = (v * 0x00010001u) & 0xFF0000FFu;
+            v = (v * 0x00000101u) & 0x0F00F00Fu;
+            v = (v * 0x00000011u) & 0xC30C30C3u;
+            v = (v * 0x00000005u) & 0x49249249u;
+            return v;
+        }
+
+        struct Bin
+        {
+            AABB bounds {};
+            uint32_t count {};
+        };
+    }
+
+    uint32_t morton_code(const Point& p, const AABB& frame)
+    {
+        Vector extent = frame.extent();
+        uint32_t code = 0;
+        for (size_t axis = 0; axis < 3; ++axis)
+        {
+            float f = extent[axis] > 0.0f ? (p[axis] - frame.min[axis]) / extent[axis] : 0.0f;
+            uint32_t q = static_cast<uint32_t>(std::min(std::max(f * 1024.0f, 0.0f), 1023.0f));
+            code |= expand_bits(q) << (2 - axis);
+        }
+        return code;
+    }
+
+    // Shared state of one build. Child pairs are carved out of a preallocated
+    // node array with an atomic counter, so subtrees can be emitted from any
+    // thread without further synchronization.
+    struct BVH::Builder
+    {
+        const std::vector<AABB>& bounds;
+        const uint32_t max_leaf_size;
+        std::vector<Point> centroids;
+        std::vector<uint32_t>& indices;
+        std::vector<BVHNode>& nodes;
+        std::vector<uint32_t> codes {};
+        unsigned threads;
+
+        std::atomic<uint32_t> node_count { 1 };
+        std::atomic<int> spare_threads;
+
+        Builder(const std::vector<AABB>& bounds, uint32_t max_leaf_size, std::vector<uint32_t>& indices,
+                std::vector<BVHNode>& nodes, unsigned threads)
+            : bounds { bounds }, max_leaf_size { std::max(1u, max_leaf_size) }, centroids(bounds.size()),
+              indices { indices }, nodes { nodes }, threads { threads },
+              spare_threads { static_cast<int>(threads) - 1 }
+        {
+        }
+
+        uint32_t allocate_pair()
+        {
+            return node_count.fetch_add(2, std::memory_order_relaxed);
+        }
+
+        // Runs both halves of a split, the left one on a new thread when the
+        // subtree is large enough and a thread is still free.
+        template <typename Left, typename Right>
+        void fork(uint32_t count, Left&& left, Right&& right)
+        {
+            if (count >= fork_threshold && spare_threads.fetch_sub(1, std::memory_order_acq_rel) > 0)
+            {
+                std::thread worker(std::forward<Left>(left));
+                right();
+                worker.join();
+                spare_threads.fetch_add(1, std::memory_order_acq_rel);
+                return;
+            }
+            if (count >= fork_threshold)
+            {
+                spare_threads.fetch_add(1, std::memory_order_acq_rel);
+            }
+
+            left();
+            right();
+        }
+
+        void make_interior(uint32_t node_index, uint32_t first, uint32_t left_count, uint32_t count)
+        {
+            const uint32_t left_index = allocate_pair();
+            nodes[left_index] = BVHNode { AABB {}, first, left_count };
+            nodes[left_index + 1] = BVHNode { AABB {}, first + left_count, count - left_count };
+            nodes[node_index].offset = left_index;
+            nodes[node_index].count = 0;
+        }
+
+        void subdivide_sah(uint32_t node_index, uint32_t depth);
+        void subdivide_lbvh(uint32_t node_index, uint32_t depth);
+    };
+
+    // Binned SAH split: primitives are bucketed by centroid along the longest
+    // axis of the centroid bounds and the cheapest bucket boundary is taken.
+    // Large nodes fill their bins in parallel; small ones run serially.
+    void BVH::Builder::subdivide_sah(uint32_t node_index, uint32_t depth)
+    {
+        const uint32_t first = nodes[node_index].offset;
+        const uint32_t count = nodes[node_index].count;
+        const unsigned scan_threads = count >= parallel_scan_threshold ? threads : 1;
+
+        std::vector<AABB> partial_bounds(scan_threads), partial_centroids(scan_threads);
+        parallel_for(count, scan_threads, [&](size_t begin, size_t end, unsigned chunk) {
+            for (size_t i = first + begin; i < first + end; ++i)
+            {
+                partial_bounds[chunk].expand(bounds[indices[i]]);
+                partial_centroids[chunk].expand(centroids[indices[i]]);
+            }
+        });
+
+        AABB node_bounds {}, centroid_bounds {};
+        for (unsigned t = 0; t < scan_threads; ++t)
+        {
+            node_bounds.expand(partial_bounds[t]);
+            centroid_bounds.expand(partial_centroids[t]);
+        }
+        nodes[node_index].bounds = node_bounds;
+
+        if (count <= max_leaf_size || depth + 1 >= stack_size)
+        {
+            return;
+        }
+
+        const int axis = centroid_bounds.longest_axis();
+        const float axis_min = centroid_bounds.min[axis];
+        const float axis_extent = centroid_bounds.max[axis] - axis_min;
+
+        if (axis_extent <= 0.0f)
+        {
+            return;
+        }
+
+        const float scale = bin_count / axis_extent;
+        auto bin_of = [&](uint32_t prim) {
+            uint32_t b = static_cast<uint32_t>((centroids[prim][axis] - axis_min) * scale);
+            return std::min(b, bin_count - 1);
+        };
+
+        std::vector<Bin> partial_bins(scan_threads * bin_count);
+        parallel_for(count, scan_threads, [&](size_t begin, size_t end, unsigned chunk) {
+            Bin* local = &partial_bins[chunk * bin_count];
+            for (size_t i = first + begin; i < first + end; ++i)
+            {
+                Bin& bin = local[bin_of(indices[i])];
+                bin.bounds.expand(bounds[indices[i]]);
+                bin.count++;
+            }
+        });
+
+        Bin bins[bin_count] {};
+        for (unsigned t = 0; t < scan_threads; ++t)
+        {
+            for (uint32_t b = 0; b < bin_count; ++b)
+            {
+                bins[b].bounds.expand(partial_bins[t * bin_count + b].bounds);
+                bins[b].count += partial_bins[t * bin_count + b].count;
+            }
+        }
+
+        // Sweep from the right to get the cost of every right-hand side, then
+        // from the left to evaluate each split plane.
+        float right_area[bin_count - 1] {};
+        uint32_t right_count[bin_count - 1] {};
+        AABB accumulated {};
+        uint32_t accumulated_count = 0;
+        for (uint32_t b = bin_count - 1; b > 0; --b)
+        {
+            accumulated.expand(bins[b].bounds);
+            accumulated_count += bins[b].count;
+            right_area[b - 1] = accumulated.surface_area();
+            right_count[b - 1] = accumulated_count;
+        }
+
+        float best_cost = std::numeric_limits<float>::max();
+        uint32_t best_split = 0;
+        accumulated = AABB {};
+        accumulated_count = 0;
+        for (uint32_t b = 0; b < bin_count - 1; ++b)
+        {
+            accumulated.expand(bins[b].bounds);
+            accumulated_count += bins[b].count;
+            float cost = accumulated_count * accumulated.surface_area() + right_count[b] * right_area[b];
+            if (accumulated_count > 0 && right_count[b] > 0 && cost < best_cost)
+            {
+                best_cost = cost;
+                best_split = b;
+            }
+        }
+
+        const float leaf_cost = count * node_bounds.surface_area();
+        if (best_cost >= leaf_cost && count <= 4 * max_leaf_size)
+        {
+            return;
+        }
+
+        auto middle = std::partition(indices.begin() + first, indices.begin() + first + count,
+                                     [&](uint32_t prim) { return bin_of(prim) <= best_split; });
+        const uint32_t left_count = static_cast<uint32_t>(middle - (indices.begin() + first));
+
+        if (left_count == 0 || left_count == count)
+        {
+            return;
+        }
+
+        make_interior(node_index, first, left_count, count);
+        const uint32_t left_index = nodes[node_index].offset;
+
+        fork(count,
+             [this, left_index, depth] { subdivide_sah(left_index, depth + 1); },
+             [this, left_index, depth] { subdivide_sah(left_index + 1, depth + 1); });
+    }
+
+    // Karras-style hierarchy over primitives sorted by Morton code: each node
+    // splits where the highest differing bit of its code range flips, or in the
+    // middle once all codes in the range are equal.
+    void BVH::Builder::subdivide_lbvh(uint32_t node_index, uint32_t depth)
+    {
+        const uint32_t first = nodes[node_index].offset;
+        const uint32_t count = nodes[node_index].count;
+
+        if (count <= max_leaf_size || depth + 1 >= stack_size)
+        {
+            AABB node_bounds {};
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                node_bounds.expand(bounds[indices[i]]);
+            }
+            nodes[node_index].bounds = node_bounds;
+            return;
+        }
+
+        const uint32_t last = first + count - 1;
+        uint32_t left_count = count / 2;
+
+        if (codes[first] != codes[last])
+        {
+            const uint32_t differing = codes[first] ^ codes[last];
+            const uint32_t split_bit = 1u << (31 - __builtin_clz(differing));
+            auto split = std::partition_point(codes.begin() + first, codes.begin() + last + 1,
+                                              [split_bit](uint32_t code) { return (code & split_bit) == 0; });
+            left_count = static_cast<uint32_t>(split - (codes.begin() + first));
+        }
+
+        make_interior(node_index, first, left_count, count);
+        const uint32_t left_index = nodes[node_index].offset;
+
+        fork(count,
+             [this, left_index, depth] { subdivide_lbvh(left_index, depth + 1); },
+             [this, left_index, depth] { subdivide_lbvh(left_index + 1, depth + 1); });
+
+        AABB node_bounds = nodes[left_index].bounds;
+        node_bounds.expand(nodes[left_index + 1].bounds);
+        nodes[node_index].bounds = node_bounds;
+    }
+
+    BuildStats BVH::build(const std::vector<AABB>& bounds, const BuildOptions& options)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const unsigned threads = options.threads > 0 ? options.threads
+                                                     : std::max(1u, std::thread::hardware_concurrency());
+
+        nodes.clear();
+        indices.resize(bounds.size());
+
+        if (!bounds.empty())
+        {
+            Builder builder { bounds, options.max_leaf_size, indices, nodes, threads };
+
+            parallel_for(bounds.size(), threads, [&](size_t begin, size_t end, unsigned) {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    builder.centroids[i] = bounds[i].centroid();
+                    indices[i] = static_cast<uint32_t>(i);
+                }
+            });
+
+            // Every interior node holds more than max_leaf_size primitives and the
+            // nodes at one depth are disjoint, so large leaves bound the tree well
+            // below the 2n - 1 nodes of a binary tree with one primitive per leaf.
+            const size_t interior_bound = stack_size * (bounds.size() / (builder.max_leaf_size + 1));
+            nodes.resize(std::min(2 * bounds.size() - 1, 2 * interior_bound + 1));
+            nodes[0] = BVHNode { AABB {}, 0, static_cast<uint32_t>(bounds.size()) };
+
+            if (options.method == BuildMethod::LBVH)
+            {
+                build_lbvh(builder);
+            }
+            else
+            {
+                builder.subdivide_sah(0, 0);
+            }
+
+            nodes.resize(builder.node_count.load());
+            nodes.shrink_to_fit();
+        }
+
+        BuildStats stats {};
+        stats.build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        stats.sah_cost = sah_cost();
+        stats.node_count = nodes.size();
+        build_cost = stats.sah_cost;
+        return stats;
+    }
+
+    void BVH::build_lbvh(Builder& builder)
+    {
+        const size_t count = indices.size();
+        const unsigned threads = builder.threads;
+
+        std::vector<AABB> partial(threads);
+        parallel_for(count, threads, [&](size_t begin, size_t end, unsigned chunk) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                partial[chunk].expand(builder.centroids[i]);
+            }
+        });
+        AABB frame {};
+        for (const auto& box : partial)
+        {
+            frame.expand(box);
+        }
+
+        // Code in the high half, primitive id in the low half: sorting the keys
+        // orders primitives along the curve and keeps ties deterministic.
+        std::vector<uint64_t> keys(count);
+        parallel_for(count, threads, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                keys[i] = (static_cast<uint64_t>(morton_code(builder.centroids[i], frame)) << 32) | i;
+            }
+        });
+
+        // Sort one chunk per thread, then merge neighbouring runs pairwise.
+        const unsigned sort_threads = static_cast<unsigned>(std::min<size_t>(threads, count));
+        const size_t chunk = (count + sort_threads - 1) / sort_threads;
+        parallel_for(sort_threads, sort_threads, [&](size_t begin, size_t, unsigned) {
+            size_t lo = std::min(count, begin * chunk);
+            std::sort(keys.begin() + lo, keys.begin() + std::min(count, lo + chunk));
+        });
+        for (size_t width = chunk; width < count; width *= 2)
+        {
+            const size_t merges = (count + 2 * width - 1) / (2 * width);
+            parallel_for(merges, threads, [&](size_t begin, size_t end, unsigned) {
+                for (size_t m = begin; m < end; ++m)
+                {
+                    size_t lo = m * 2 * width;
+                    size_t mid = std::min(count, lo + width);
+                    size_t hi = std::min(count, lo + 2 * width);
+                    std::inplace_merge(keys.begin() + lo, keys.begin() + mid, keys.begin() + hi);
+                }
+            });
+        }
+
+        builder.codes.resize(count);
+        parallel_for(count, threads, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                builder.codes[i] = static_cast<uint32_t>(keys[i] >> 32);
+                indices[i] = static_cast<uint32_t>(keys[i]);
+            }
+        });
+
+        builder.subdivide_lbvh(0, 0);
+    }
+
+    bool BVH::assign(std::vector<BVHNode> new_nodes, std::vector<uint32_t> new_indices, size_t primitive_count)
+    {
+        nodes.clear();
+        indices.clear();
+
+        if (new_indices.size() != primitive_count || new_nodes.empty() != new_indices.empty())
+        {
+            return false;
+        }
+        for (uint32_t index : new_indices)
+        {
+            if (index >= primitive_count)
+            {
+                return false;
+            }
+        }
+        // Children are always stored after their parent, which also rules out cycles.
+        for (size_t i = 0; i < new_nodes.size(); ++i)
+        {
+            const BVHNode& node = new_nodes[i];
+            bool valid = node.is_leaf() ? size_t { node.offset } + node.count <= new_indices.size()
+                                        : node.offset > i && size_t { node.offset } + 1 < new_nodes.size();
+            if (!valid)
+            {
+                return false;
+            }
+        }
+
+        nodes = std::move(new_nodes);
+        indices = std::move(new_indices);
+        build_cost = sah_cost();
+        return true;
+    }
+
+    float BVH::refit(const std::vector<AABB>& bounds)
+    {
+        assert(bounds.size() == indices.size());
+
+        // Children are always stored after their parent, so one backward
+        // sweep sees both children of a node before the node itself.
+        for (size_t i = nodes.size(); i-- > 0;)
+        {
+            BVHNode& node = nodes[i];
+            AABB box {};
+            if (node.is_leaf())
+            {
+                for (uint32_t k = node.offset; k < node.offset + node.count; ++k)
+                {
+                    box.expand(bounds[k]);
+                }
+            }
+            else
+            {
+                box = nodes[node.offset].bounds;
+                box.expand(nodes[node.offset + 1].bounds);
+            }
+            node.bounds = box;
+        }
+        return sah_cost();
+    }
+
+    // Expected cost of a random ray through the tree, relative to the root:
+    // one unit per traversal step and one per primitive test.
+    float BVH::sah_cost() const
+    {
+        if (nodes.empty())
+        {
+            return 0.0f;
+        }
+
+        const float root_area = nodes[0].bounds.surface_area();
+        if (root_area <= 0.0f)
+        {
+            return static_cast<float>(nodes[0].count);
+        }
+
+        double cost = 0.0;
+        for (const auto& node : nodes)
+        {
+            double weight = node.bounds.surface_area() / root_area;
+            cost += weight * (node.is_leaf() ? node.count : 1.0);
+        }
+        return static_cast<float>(cost);
+    }
+}
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "../lib/aabb.h"
+#include "../lib/point.h"
+#include "../lib/ray.h"
+#include "../lib/ray_packet.h"
+#include "../lib/vector.h"
+
+namespace Accel
+{
+    // Interior nodes have count == 0 and keep their two children next to each
+    // other at nodes[offset] and nodes[offset + 1]. Leaves reference
+    // indices[offset .. offset + count).
+    struct BVHNode
+    {
+        AABB bounds {};
+        uint32_t offset {};
+        uint32_t count {};
+
+        bool is_leaf() const { return count > 0; }
+    };
+
+    // LBVH sorts primitives along a Morton curve and is the fastest to build;
+    // binned SAH takes longer but gives cheaper trees to trace.
+    enum class BuildMethod
+    {
+        BinnedSAH,
+        LBVH,
+    };
+
+    struct BuildOptions
+    {
+        BuildMethod method { BuildMethod::BinnedSAH };
+        unsigned threads {};  // 0 = std::thread::hardware_concurrency()
+        uint32_t max_leaf_size { 4 };
+    };
+
+    // 30-bit Morton code of p, quantized to 1024 steps per axis of frame.
+    uint32_t morton_code(const Point& p, const AABB& frame);
+
+    struct BuildStats
+    {
+        double build_ms {};
+        float sah_cost {};
+        size_t node_count {};
+    };
+
+    class BVH
+    {
+    private:
+        std::vector<BVHNode> nodes {};
+        std::vector<uint32_t> indices {};
+        float build_cost {};
+
+        static constexpr uint32_t bin_count = 12;
+        static constexpr uint32_t stack_size = 64;
+
+        struct Builder;
+        void build_lbvh(Builder& builder);
+
+    public:
+        BVH() = default;
+        BVH(const BVH&) = default;
+        BVH(BVH&&) = default;
+        ~BVH() = default;
+        BVH& operator=(const BVH&) = default;
+        BVH& operator=(BVH&&) = default;
+
+        // Builds the hierarchy over one bounding box per primitive. The
+        // primitive ids handed back during traversal are positions in this list.
+        BuildStats build(const std::vector<AABB>& bounds, const BuildOptions& options = BuildOptions {});
+
+        // Adopts nodes and indices produced by an earlier build (e.g. read back
+        // from a cache). Returns false, leaving the tree empty, if they do not
+        // form a valid hierarchy over primitive_count primitives.
+        bool assign(std::vector<BVHNode> nodes, std::vector<uint32_t> indices, size_t primitive_count);
+
+        // Refits every box to primitives that moved, keeping the topology:
+        // leaves take the union of their primitives' boxes, bottom-up, and
+        // interior nodes the union of their children. bounds[i] is the box of
+        // the primitive at get_indices()[i], i.e. in leaf order, as the boxes
+        // of a store reordered along the tree already are. Returns the new
+        // sah_cost(); compare it with get_build_cost() to decide when the
+        // tree has drifted far enough to be worth rebuilding.
+        float refit(const std::vector<AABB>& bounds);
+
+        float sah_cost() const;
+
+        // sah_cost() right after the last build() or assign().
+        float get_build_cost() const { return build_cost; }
+
+        bool empty() const { return nodes.empty(); }
+        const std::vector<BVHNode>& get_nodes() const { return nodes; }
+
+        // Heap bytes held by the tree.
+        size_t memory_bytes() const { return nodes.capacity() * sizeof(BVHNode) + indices.capacity() * sizeof(uint32_t); }
+        const std::vector<uint32_t>& get_indices() const { return indices; }
+
+        // Visits the leaves pierced by the ray front to back. leaf(first, count, t_max)
+        // tests the primitives at get_indices()[first .. first + count) and, on a
+        // closer hit, shrinks t_max and returns true.
+        template <typename Leaf>
+        bool traverse(const Ray& ray, float& t_max, Leaf&& leaf) const;
+
+        // Any-hit walk for shadow rays: returns true as soon as leaf(first, count)
+        // reports a hit before t_max. Children are still visited near to far so
+        // that occluders close to the origin end the search early.
+        template <typename Leaf>
+        bool traverse_any(const Ray& ray, float t_max, Leaf&& leaf) const;
+
+        // Same walk, one primitive at a time: intersect(id) tests whether
+        // primitive id is hit before t_max.
+        template <typename Intersect>
+        bool occluded(const Ray& ray, float t_max, Intersect&& intersect) const;
+
+        // Same walk, one primitive at a time: intersect(id, t_max) tests
+        // primitive id with the contract above.
+        template <typename Intersect>
+        bool closest_hit(const Ray& ray, float& t_max, Intersect&& intersect) const;
+
+        // Packet traversal: a node is entered when any lane's ray hits it.
+        // leaf(first, count, active, t_max) tests the lanes in the active mask
+        // against the primitives at get_indices()[first .. first + count),
+        // lowers their t_max on closer hits and returns the mask of those lanes.
+        template <size_t N, typename Leaf>
+        uint32_t traverse(const RayPacket<N>& rays, float* t_max, Leaf&& leaf) const;
+
+        // Same packet walk, one primitive at a time: intersect(id, active, t_max).
+        template <size_t N, typename Intersect>
+        uint32_t closest_hit(const RayPacket<N>& rays, float* t_max, Intersect&& intersect) const;
+    };
+
+    template <typename Intersect>
+    bool BVH::closest_hit(const Ray& ray, float& t_max, Intersect&& intersect) const
+    {
+        return traverse(ray, t_max, [&](uint32_t first, uint32_t count, float& t) {
+            bool hit { false };
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                hit |= intersect(indices[i], t);
+            }
+            return hit;
+        });
+    }
+
+    template <typename Leaf>
+    bool BVH::traverse(const Ray& ray, float& t_max, Leaf&& leaf) const
+    {
+        if (nodes.empty())
+        {
+            return false;
+        }
+
+        const Vector inv_direction = AABB::inverse(ray.direction);
+        bool hit { false };
+        float t_entry {};
+
+        if (!nodes[0].bounds.intersect(ray.origin, inv_direction, t_max, t_entry))
+        {
+            return false;
+        }
+
+        uint32_t stack[stack_size];
+        uint32_t stack_top = 0;
+        uint32_t current = 0;
+
+        while (true)
+        {
+            const BVHNode& node = nodes[current];
+
+            if (node.is_leaf())
+            {
+                hit |= leaf(node.offset, node.count, t_max);
+            }
+            else
+            {
+                float t_left {}, t_right {};
+                uint32_t left = node.offset;
+                uint32_t right = node.offset + 1;
+                bool hit_left = nodes[left].bounds.intersect(ray.origin, inv_direction, t_max, t_left);
+                bool hit_right = nodes[right].bounds.intersect(ray.origin, inv_direction, t_max, t_right);
+
+                if (hit_left && hit_right)
+                {
+                    if (t_right < t_left)
+                    {
+                        std::swap(left, right);
+                    }
+                    stack[stack_top++] = right;
+                    current = left;
+                    continue;
+                }
+                if (hit_left || hit_right)
+                {
+                    current = hit_left ? left : right;
+                    continue;
+                }
+            }
+
+            // Pop until we find a node that is still in front of the closest hit.
+            bool found { false };
+            while (stack_top > 0)
+            {
+                current = stack[--stack_top];
+                if (nodes[current].bounds.intersect(ray.origin, inv_direction, t_max, t_entry))
+                {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found)
+            {
+                break;
+            }
+        }
+
+        return hit;
+    }
+
+    template <typename Intersect>
+    bool BVH::occluded(const Ray& ray, float t_max, Intersect&& intersect) const
+    {
+        return traverse_any(ray, t_max, [&](uint32_t first, uint32_t count) {
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                if (intersect(indices[i]))
+                {
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    template <typename Leaf>
+    bool BVH::traverse_any(const Ray& ray, float t_max, Leaf&& leaf) const
+    {
+        if (nodes.empty())
+        {
+            return false;
+        }
+
+        const Vector inv_direction = AABB::inverse(ray.direction);
+        float t_entry {};
+
+        if (!nodes[0].bounds.intersect(ray.origin, inv_direction, t_max, t_entry))
+        {
+            return false;
+        }
+
+        // t_max never shrinks here, so a node on the stack was already tested
+        // against the final interval and can be visited without a second test.
+        uint32_t stack[stack_size];
+        uint32_t stack_top = 0;
+        uint32_t current = 0;
+
+        while (true)
+        {
+            const BVHNode& node = nodes[current];
+
+            if (node.is_leaf())
+            {
+                if (leaf(node.offset, node.count))
+                {
+                    return true;
+                }
+            }
+            else
+            {
+                float t_left {}, t_right {};
+                uint32_t left = node.offset;
+                uint32_t right = node.offset + 1;
+                bool hit_left = nodes[left].bounds.intersect(ray.origin, inv_direction, t_max, t_left);
+                bool hit_right = nodes[right].bounds.intersect(ray.origin, inv_direction, t_max, t_right);
+
+                if (hit_left && hit_right)
+                {
+                    if (t_right < t_left)
+                    {
+                        std::swap(left, right);
+                    }
+                    stack[stack_top++] = right;
+                    current = left;
+                    continue;
+                }
+                if (hit_left || hit_right)
+                {
+                    current = hit_left ? left : right;
+                    continue;
+                }
+            }
+
+            if (stack_top == 0)
+            {
+                return false;
+            }
+            current = stack[--stack_top];
+        }
+    }
+
+    template <size_t N, typename Intersect>
+    uint32_t BVH::closest_hit(const RayPacket<N>& rays, float* t_max, Intersect&& intersect) const
+    {
+        return traverse<N>(rays, t_max, [&](uint32_t first, uint32_t count, uint32_t active, float* t) {
+            uint32_t hit = 0;
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                hit |= intersect(indices[i], active, t);
+            }
+            return hit;
+        });
+    }
+
+    template <size_t N, typename Leaf>
+    uint32_t BVH::traverse(const RayPacket<N>& rays, float* t_max, Leaf&& leaf) const
+    {
+        if (nodes.empty())
+        {
+            return 0;
+        }
+
+        alignas(32) float inv_x[N], inv_y[N], inv_z[N];
+        for (size_t lane = 0; lane < N; ++lane)
+        {
+            inv_x[lane] = AABB::inverse(rays.dx[lane]);
+            inv_y[lane] = AABB::inverse(rays.dy[lane]);
+            inv_z[lane] = AABB::inverse(rays.dz[lane]);
+        }
+
+        // Lanes whose ray overlaps the box before its current t_max; nearest
+        // receives the smallest entry distance among them.
+        auto test = [&](const AABB& box, float& nearest) {
+            uint32_t mask = 0;
+            nearest = std::numeric_limits<float>::max();
+            for (size_t lane = 0; lane < N; ++lane)
+            {
+                float x0 = (box.min.x - rays.ox[lane]) * inv_x[lane], x1 = (box.max.x - rays.ox[lane]) * inv_x[lane];
+                float y0 = (box.min.y - rays.oy[lane]) * inv_y[lane], y1 = (box.max.y - rays.oy[lane]) * inv_y[lane];
+                float z0 = (box.min.z - rays.oz[lane]) * inv_z[lane], z1 = (box.max.z - rays.oz[lane]) * inv_z[lane];
+                float t0 = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.0f));
+                float t1 = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::max(z0, z1)) * AABB::far_scale;
+                t1 = std::min(t1, t_max[lane]);
+                if (t0 <= t1)
+                {
+                    mask |= 1u << lane;
+                    nearest = std::min(nearest, t0);
+                }
+            }
+            return mask;
+        };
+
+        uint32_t hit = 0;
+        float t_entry {};
+        uint32_t active = test(nodes[0].bounds, t_entry);
+        if (!active)
+        {
+            return 0;
+        }
+
+        uint32_t stack[stack_size];
+        uint32_t stack_top = 0;
+        uint32_t current = 0;
+
+        while (true)
+        {
+            const BVHNode& node = nodes[current];
+
+            if (node.is_leaf())
+            {
+                hit |= leaf(node.offset, node.count, active, t_max);
+            }
+            else
+            {
+                float t_left {}, t_right {};
+                uint32_t left = node.offset;
+                uint32_t right = node.offset + 1;
+                uint32_t mask_left = test(nodes[left].bounds, t_left);
+                uint32_t mask_right = test(nodes[right].bounds, t_right);
+
+                if (mask_left && mask_right)
+                {
+                    if (t_right < t_left)
+                    {
+                        std::swap(left, right);
+                        std::swap(mask_left, mask_right);
+                    }
+                    stack[stack_top++] = right;
+                    current = left;
+                    active = mask_left;
+                    continue;
+                }
+                if (mask_left || mask_right)
+                {
+                    current = mask_left ? left : right;
+                    active = mask_left ? mask_left : mask_right;
+                    continue;
+                }
+            }
+
+            bool found { false };
+            while (stack_top > 0)
+            {
+                current = stack[--stack_top];
+                active = test(nodes[current].bounds, t_entry);
+                if (active)
+                {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found)
+            {
+                break;
+            }
+        }
+
+        return hit;
+    }
+}
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include "lazy_bvh.h"
+
+namespace Accel
+{
+    BuildStats LazyBVH::build(const std::vector<AABB>& bounds, const BuildOptions& options, RangeBounds range_bounds,
+                              RangeReorder range_reorder, uint32_t cluster_size)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        // The top tree is an ordinary build that stops at cluster_size
+        BuildOptions top_options = options;
+        top_options.max_leaf_size = std::max(cluster_size, options.max_leaf_size);
+        BuildStats stats = top.build(bounds, top_options);
+
+        cluster_firsts.clear();
+        for (const BVHNode& node : top.get_nodes())
+        {
+            if (node.is_leaf())
+            {
+                cluster_firsts.push_back(node.offset);
+            }
+        }
+        std::sort(cluster_firsts.begin(), cluster_firsts.end());
+
+        clusters = std::make_unique<Cluster[]>(cluster_firsts.size());
+        for (const BVHNode& node : top.get_nodes())
+        {
+            if (node.is_leaf())
+            {
+                const size_t id = std::lower_bound(cluster_firsts.begin(), cluster_firsts.end(), node.offset) -
+                                  cluster_firsts.begin();
+                clusters[id].first = node.offset;
+                clusters[id].count = node.count;
+            }
+        }
+
+        this->range_bounds = std::move(range_bounds);
+        this->range_reorder = std::move(range_reorder);
+        cluster_options = options;
+        cluster_options.threads = 1;
+        expanded = std::make_unique<Counters>();
+
+        stats.build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+
+    size_t LazyBVH::memory_bytes() const
+    {
+        size_t bytes = top.memory_bytes() + cluster_firsts.capacity() * sizeof(uint32_t) +
+                       cluster_firsts.size() * sizeof(Cluster);
+        for (size_t id = 0; id < cluster_firsts.size(); ++id)
+        {
+            bytes += clusters[id].bvh.memory_bytes();
+        }
+        return bytes;
+    }
+
+    const LazyBVH::Cluster& LazyBVH::expand(uint32_t first) const
+    {
+        const size_t id = std::lower_bound(cluster_firsts.begin(), cluster_firsts.end(), first) - cluster_firsts.begin();
+        Cluster& cluster = clusters[id];
+
+        // Rays elsewhere only ever read clusters that are already built, so
+        // the range can be reordered while they run.
+        std::call_once(cluster.built, [&] {
+            cluster.bvh.build(range_bounds(cluster.first, cluster.count), cluster_options);
+            range_reorder(cluster.first, cluster.bvh.get_indices());
+            expanded->clusters.fetch_add(1, std::memory_order_relaxed);
+            expanded->nodes.fetch_add(cluster.bvh.get_nodes().size(), std::memory_order_relaxed);
+        });
+        return cluster;
+    }
+}
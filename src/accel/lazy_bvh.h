@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "../lib/aabb.h"
+#include "../lib/ray.h"
+#include "bvh.h"
+
+namespace Accel
+{
+    // BVH whose lower levels are built on demand. build() only splits the
+    // primitives into clusters of about cluster_size (the leaves of a top
+    // tree); a cluster gets its own BVH the first time a ray reaches it, so
+    // geometry that no ray ever gets near is never subdivided. One thread
+    // builds a cluster while the others that reach it wait for it.
+    //
+    // As with BVH, the owner keeps its primitives in the order of
+    // get_indices() after build(), so that every cluster is a contiguous
+    // range. Expanding a cluster asks the owner for the boxes of that range
+    // and then has it permute the range along the cluster's tree; leaves
+    // handed to the traversal callbacks are then contiguous ranges as well.
+    class LazyBVH
+    {
+    public:
+        // Boxes of the primitives [first, first + count), in their current order.
+        using RangeBounds = std::function<std::vector<AABB>(uint32_t first, uint32_t count)>;
+
+        // Moves the primitive at first + order[i] to first + i.
+        using RangeReorder = std::function<void(uint32_t first, const std::vector<uint32_t>& order)>;
+
+        static constexpr uint32_t default_cluster_size = 4096;
+
+    private:
+        struct Cluster
+        {
+            uint32_t first {};
+            uint32_t count {};
+            std::once_flag built {};
+            BVH bvh {};
+        };
+
+        BVH top {};
+        std::vector<uint32_t> cluster_firsts {};  // ascending, one per cluster
+        std::unique_ptr<Cluster[]> clusters {};
+        RangeBounds range_bounds {};
+        RangeReorder range_reorder {};
+        BuildOptions cluster_options {};
+
+        // Shared by the threads that expand clusters during traversal.
+        struct Counters
+        {
+            std::atomic<uint32_t> clusters {};
+            std::atomic<size_t> nodes {};
+        };
+        std::unique_ptr<Counters> expanded { std::make_unique<Counters>() };
+
+        // The cluster whose range starts at first, built if no ray reached it yet.
+        const Cluster& expand(uint32_t first) const;
+
+    public:
+        LazyBVH() = default;
+        LazyBVH(LazyBVH&&) = default;
+        ~LazyBVH() = default;
+        LazyBVH& operator=(LazyBVH&&) = default;
+
+        LazyBVH(const LazyBVH&) = delete;
+        LazyBVH& operator=(const LazyBVH&) = delete;
+
+        // Builds the top tree over one box per primitive. The clusters are
+        // built later with the same method and leaf size but on one thread,
+        // since they are expanded by render threads that already fill the
+        // machine.
+        BuildStats build(const std::vector<AABB>& bounds, const BuildOptions& options, RangeBounds range_bounds,
+                         RangeReorder range_reorder, uint32_t cluster_size = default_cluster_size);
+
+        bool empty() const { return top.empty(); }
+        const BVH& get_top() const { return top; }
+        const std::vector<uint32_t>& get_indices() const { return top.get_indices(); }
+
+        size_t cluster_count() const { return cluster_firsts.size(); }
+        uint32_t expanded_clusters() const { return expanded->clusters.load(std::memory_order_relaxed); }
+
+        // Nodes of the top tree plus those of the clusters expanded so far.
+        size_t node_count() const { return top.get_nodes().size() + expanded->nodes.load(std::memory_order_relaxed); }
+
+        // Heap bytes held by the top tree and the clusters expanded so far
+        // (only exact while no ray is traversing).
+        size_t memory_bytes() const;
+
+        // Same contracts as BVH::traverse and BVH::traverse_any.
+        template <typename Leaf>
+        bool traverse(const Ray& ray, float& t_max, Leaf&& leaf) const;
+
+        template <typename Leaf>
+        bool traverse_any(const Ray& ray, float t_max, Leaf&& leaf) const;
+    };
+
+    template <typename Leaf>
+    bool LazyBVH::traverse(const Ray& ray, float& t_max, Leaf&& leaf) const
+    {
+        return top.traverse(ray, t_max, [&](uint32_t first, uint32_t, float& t) {
+            const Cluster& cluster = expand(first);
+            return cluster.bvh.traverse(ray, t, [&](uint32_t leaf_first, uint32_t leaf_count, float& t_leaf) {
+                return leaf(cluster.first + leaf_first, leaf_count, t_leaf);
+            });
+        });
+    }
+
+    template <typename Leaf>
+    bool LazyBVH::traverse_any(const Ray& ray, float t_max, Leaf&& leaf) const
+    {
+        return top.traverse_any(ray, t_max, [&](uint32_t first, uint32_t) {
+            const Cluster& cluster = expand(first);
+            return cluster.bvh.traverse_any(ray, t_max, [&](uint32_t leaf_first, uint32_t leaf_count) {
+                return leaf(cluster.first + leaf_first, leaf_count);
+            });
+        });
+    }
+}
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include "../kernels/kernels.h"
+#include "wide_bvh.h"
+
+namespace Accel
+{
+    namespace
+    {
+        // 2^exponent, built from its bits (exponent is within the normal range).
+        float power_of_two(int exponent)
+        {
+            const uint32_t bits = static_cast<uint32_t>(exponent + 127) << 23;
+            float f;
+            std::memcpy(&f, &bits, sizeof(f));
+            return f;
+        }
+
+        // Grids of a node: the smallest power-of-two step whose 255 steps reach
+        // the far side of the box from its near side.
+        void set_grid(WideNode& node, const AABB& box)
+        {
+            for (size_t axis = 0; axis < 3; ++axis)
+            {
+                const float origin = box.min[axis];
+                const float extent = box.max[axis] - origin;
+                int exponent = -126;
+                if (extent > 0.0f)
+                {
+                    std::frexp(extent / 255.0f, &exponent);
+                    exponent = std::max(exponent, -126);
+                    while (origin + 255.0f * power_of_two(exponent) < box.max[axis])
+                    {
+                        ++exponent;
+                    }
+                }
+                node.origin[axis] = origin;
+                node.exponent[axis] = static_cast<int8_t>(exponent);
+            }
+        }
+
+        // Codes of child in slot, rounded outward until the decoded box contains it.
+        void quantize(WideNode& node, uint32_t slot, const AABB& child)
+        {
+            for (size_t axis = 0; axis < 3; ++axis)
+            {
+                const float origin = node.origin[axis];
+                const float step = power_of_two(node.exponent[axis]);
+                auto code = [](float grid) { return static_cast<int>(std::min(std::max(grid, 0.0f), 255.0f)); };
+
+                int lo = code(std::floor((child.min[axis] - origin) / step));
+                int hi = code(std::ceil((child.max[axis] - origin) / step));
+                while (lo > 0 && origin + lo * step > child.min[axis])
+                {
+                    --lo;
+                }
+                while (hi < 255 && origin + hi * step < child.max[axis])
+                {
+                    ++hi;
+                }
+                node.lo[axis][slot] = static_cast<uint8_t>(lo);
+                node.hi[axis][slot] = static_cast<uint8_t>(hi);
+            }
+        }
+    }
+
+    bool WideBVH::build(const BVH& binary, std::vector<uint32_t>& order)
+    {
+        nodes.clear();
+        order.clear();
+        bounds = AABB {};
+
+        const std::vector<BVHNode>& source = binary.get_nodes();
+        if (source.empty())
+        {
+            return true;
+        }
+        bounds = source[0].bounds;
+        order.reserve(binary.get_indices().size());
+
+        // Breadth first: the interior children of a node are allocated
+        // together, so they sit next to each other from node_base on.
+        std::vector<std::pair<uint32_t, uint32_t>> pending { { 0, 0 } };  // binary node, wide node
+        nodes.emplace_back();
+        for (size_t next = 0; next < pending.size(); ++next)
+        {
+            const uint32_t from = pending[next].first;
+            uint32_t slots[WideNode::width] {};
+            uint32_t slot_count = 0;
+
+            if (source[from].is_leaf())
+            {
+                slots[slot_count++] = from;
+            }
+            else
+            {
+                slots[slot_count++] = source[from].offset;
+                slots[slot_count++] = source[from].offset + 1;
+
+                // Open the interior child with the largest box until the node is full
+                while (slot_count < WideNode::width)
+                {
+                    int widest = -1;
+                    float widest_area = -1.0f;
+                    for (uint32_t s = 0; s < slot_count; ++s)
+                    {
+                        const BVHNode& child = source[slots[s]];
+                        if (!child.is_leaf() && child.bounds.surface_area() > widest_area)
+                        {
+                            widest = static_cast<int>(s);
+                            widest_area = child.bounds.surface_area();
+                        }
+                    }
+                    if (widest < 0)
+                    {
+                        break;
+                    }
+                    const uint32_t opened = source[slots[widest]].offset;
+                    slots[widest] = opened;
+                    slots[slot_count++] = opened + 1;
+                }
+            }
+
+            WideNode node {};
+            set_grid(node, source[from].bounds);
+            node.child_count = static_cast<uint8_t>(slot_count);
+            node.node_base = static_cast<uint32_t>(nodes.size());
+            node.primitive_base = static_cast<uint32_t>(order.size());
+
+            for (uint32_t s = 0; s < slot_count; ++s)
+            {
+                const BVHNode& child = source[slots[s]];
+                quantize(node, s, child.bounds);
+                if (child.is_leaf())
+                {
+                    if (child.count > 255)
+                    {
+                        nodes.clear();
+                        order.clear();
+                        return false;
+                    }
+                    node.primitive_count[s] = static_cast<uint8_t>(child.count);
+                    for (uint32_t i = child.offset; i < child.offset + child.count; ++i)
+                    {
+                        order.push_back(i);
+                    }
+                }
+                else
+                {
+                    pending.emplace_back(slots[s], static_cast<uint32_t>(nodes.size()));
+                    nodes.emplace_back();
+                }
+            }
+
+            nodes[pending[next].second] = node;
+        }
+
+        nodes.shrink_to_fit();
+        return true;
+    }
+
+    uint32_t WideBVH::intersect_children(const WideNode& node, const Ray& ray, const Vector& inv_direction, float t_max,
+                                         Entry* hits) const
+    {
+        alignas(32) float t_entry[WideNode::width];
+        const uint32_t mask = Kernels::active().intersect_children(node, ray, inv_direction, t_max, t_entry);
+
+        // Slots in order, then an insertion sort by entry distance
+        uint32_t count = 0, interior = 0, primitive = node.primitive_base;
+        for (uint32_t s = 0; s < node.child_count; ++s)
+        {
+            const uint32_t primitives = node.primitive_count[s];
+            if (mask & (1u << s))
+            {
+                Entry entry = primitives > 0 ? Entry { primitive, primitives, t_entry[s] }
+                                             : Entry { node.node_base + interior, 0, t_entry[s] };
+                uint32_t i = count++;
+                while (i > 0 && hits[i - 1].t > entry.t)
+                {
+                    hits[i] = hits[i - 1];
+                    --i;
+                }
+                hits[i] = entry;
+            }
+            primitive += primitives;
+            interior += primitives > 0 ? 0 : 1;
+        }
+        return count;
+    }
+}
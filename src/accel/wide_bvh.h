@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../lib/aabb.h"
+#include "../lib/point.h"
+#include "../lib/ray.h"
+#include "../lib/vector.h"
+#include "bvh.h"
+
+namespace Accel
+{
+    // Node of a WideBVH: up to eight children whose boxes are stored with 8
+    // bits per coordinate, on a grid laid over the node's own box. The grid
+    // step along each axis is a power of two, so a code decodes to
+    // origin + code * step with a single rounding. Codes are rounded outward
+    // until the decoded box contains the child's box, so the compressed
+    // hierarchy is conservative: it can only add box hits, never lose one.
+    struct WideNode
+    {
+        static constexpr uint32_t width = 8;
+
+        float origin[3] {};
+        int8_t exponent[3] {};                // grid step along each axis is 2^exponent
+        uint8_t child_count {};               // slots [0, child_count) are in use
+        uint32_t node_base {};                // interior children: nodes from here, in slot order
+        uint32_t primitive_base {};           // leaf children: primitives from here, in slot order
+        uint8_t primitive_count[width] {};    // per slot; 0 for an interior child
+        uint8_t lo[3][width] {}, hi[3][width] {};
+    };
+
+    static_assert(sizeof(WideNode) == 80, "a wide node is meant to fill 80 bytes");
+
+    // Eight-wide BVH with quantized child boxes, collapsed from a binary BVH:
+    // 80 bytes per node for up to eight children, where the binary tree spends
+    // 32 bytes on every single node. The owner reorders its primitives along
+    // the wide tree (see build()), after which leaves are contiguous ranges as
+    // in BVH, and no index list is kept.
+    class WideBVH
+    {
+    private:
+        std::vector<WideNode> nodes {};
+        AABB bounds {};
+
+        static constexpr uint32_t stack_size = (WideNode::width - 1) * 64 + 1;
+
+        struct Entry
+        {
+            uint32_t index {};  // node, or first primitive when count > 0
+            uint32_t count {};
+            float t {};         // distance at which the ray enters the box
+        };
+
+        // Children of node the ray enters before t_max, nearest first.
+        // Returns how many were written to hits.
+        uint32_t intersect_children(const WideNode& node, const Ray& ray, const Vector& inv_direction, float t_max,
+                                    Entry* hits) const;
+
+    public:
+        WideBVH() = default;
+        WideBVH(const WideBVH&) = default;
+        WideBVH(WideBVH&&) = default;
+        ~WideBVH() = default;
+        WideBVH& operator=(const WideBVH&) = default;
+        WideBVH& operator=(WideBVH&&) = default;
+
+        // Collapses binary, whose leaves index a store already reordered
+        // along it (as after BVH::get_indices()). order receives the new
+        // layout for that store: slot i takes the primitive now at order[i].
+        // Returns false, leaving the tree empty, if a leaf holds more than 255
+        // primitives.
+        bool build(const BVH& binary, std::vector<uint32_t>& order);
+
+        bool empty() const { return nodes.empty(); }
+        const AABB& get_bounds() const { return bounds; }
+        size_t node_count() const { return nodes.size(); }
+
+        // Heap bytes held by the tree.
+        size_t memory_bytes() const { return nodes.capacity() * sizeof(WideNode); }
+
+        // Same contracts as BVH::traverse and BVH::traverse_any.
+        template <typename Leaf>
+        bool traverse(const Ray& ray, float& t_max, Leaf&& leaf) const;
+
+        template <typename Leaf>
+        bool traverse_any(const Ray& ray, float t_max, Leaf&& leaf) const;
+    };
+
+    template <typename Leaf>
+    bool WideBVH::traverse(const Ray& ray, float& t_max, Leaf&& leaf) const
+    {
+        const Vector inv_direction = AABB::inverse(ray.direction);
+        float t_entry {};
+        if (nodes.empty() || !bounds.intersect(ray.origin, inv_direction, t_max, t_entry))
+        {
+            return false;
+        }
+
+        Entry stack[stack_size];
+        uint32_t stack_top = 0;
+        stack[stack_top++] = Entry { 0, 0, t_entry };
+        bool hit { false };
+
+        while (stack_top > 0)
+        {
+            const Entry entry = stack[--stack_top];
+            if (entry.t > t_max)
+            {
+                continue;  // a closer hit was found after the entry was pushed
+            }
+            if (entry.count > 0)
+            {
+                hit |= leaf(entry.index, entry.count, t_max);
+                continue;
+            }
+
+            // Pushed far to near, so the nearest child is visited next
+            Entry children[WideNode::width];
+            const uint32_t count = intersect_children(nodes[entry.index], ray, inv_direction, t_max, children);
+            for (uint32_t i = count; i-- > 0;)
+            {
+                stack[stack_top++] = children[i];
+            }
+        }
+
+        return hit;
+    }
+
+    template <typename Leaf>
+    bool WideBVH::traverse_any(const Ray& ray, float t_max, Leaf&& leaf) const
+    {
+        const Vector inv_direction = AABB::inverse(ray.direction);
+        float t_entry {};
+        if (nodes.empty() || !bounds.intersect(ray.origin, inv_direction, t_max, t_entry))
+        {
+            return false;
+        }
+
+        Entry stack[stack_size];
+        uint32_t stack_top = 0;
+        stack[stack_top++] = Entry { 0, 0, t_entry };
+
+        while (stack_top > 0)
+        {
+            const Entry entry = stack[--stack_top];
+            if (entry.count > 0)
+            {
+                if (leaf(entry.index, entry.count))
+                {
+                    return true;
+                }
+                continue;
+            }
+
+            Entry children[WideNode::width];
+            const uint32_t count = intersect_children(nodes[entry.index], ray, inv_direction, t_max, children);
+            for (uint32_t i = count; i-- > 0;)
+            {
+                stack[stack_top++] = children[i];
+            }
+        }
+
+        return false;
+    }
+}
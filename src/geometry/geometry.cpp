@@ -1,60 +1,62 @@
 #include <cmath>
+#include <utility>
+#include "../lib/simd.h"
 #include "geometry.h"
 
 namespace Geometry
 {
-    RT::Trace Sphere::hit(const Ray& ray) const
+    bool Sphere::hit(const Ray& ray, float& t_max) const
     {
-        bool hit { false };
-        Point origin { ray.origin };
-        Point position {};
-        Vector normal {};
-
-        Vector o = ray.origin - center;
+        Vector f = ray.origin - center;
         Vector d = ray.direction;
-        float r = radius;
+        float r2 = radius * radius;
 
+        // b is half the usual linear coefficient. The discriminant b^2 - ac is
+        // rewritten as a (r^2 - |l|^2), with l the offset from the center to
+        // the closest point on the ray's line, which avoids the cancellation
+        // of b^2 - ac for small, distant spheres.
         float a = dot(d, d);
-        float b = 2.0f * dot(o, d);
-        float c = dot(o, o) - r * r;
-        float discriminant = b * b - 4.0f * a * c;
+        float b = dot(f, d);
+        Vector l = f - (b / a) * d;
+        float discriminant = a * (r2 - dot(l, l));
 
         if (discriminant < 0.0f)
         {
-            return RT::Trace { hit, 0.0f, origin, position, normal };
+            return false;
         }
 
-        float t {};
-        float t1 = (-b - std::sqrt(discriminant)) / (2.0f * a);
-        float t2 = (-b + std::sqrt(discriminant)) / (2.0f * a);
-
-        if (t1 > 0.0f)
-        {
-            t = t1;
-        }
-        else if (t2 > 0.0f)
-        {
-            t = t2;
-        }
-        else
+        // One square root; q never subtracts nearly equal values, and the
+        // two roots are c / q and q / a.
+        float c = dot(f, f) - r2;
+        float root = std::sqrt(discriminant);
+        float q = b < 0.0f ? root - b : -(b + root);
+        float t0 = c / q;
+        float t1 = q / a;
+        float t_near = t0 < t1 ? t0 : t1;
+        float t_far = t0 < t1 ? t1 : t0;
+        float t = t_near > 0.0f ? t_near : t_far;
+
+        if (!(t > 0.0f) || t >= t_max)
         {
-            return RT::Trace { hit, 0.0f, origin, position, normal };
+            return false;
         }
 
-        hit = true;
-        position = ray.at(t);
-        normal = (position - center).normalized();
+        t_max = t;
+        return true;
+    }
 
-        return RT::Trace { hit, t, origin, position, normal };
+    Vector Sphere::normal_at(const Point& position) const
+    {
+        return (position - center).normalized();
     }
 
-    RT::Trace Plane::hit(const Ray& ray) const
+    AABB Sphere::bounds() const
     {
-        bool hit { false };
-        Point origin { ray.origin };
-        Point position {};
-        Vector normal {};
+        return AABB { center - Vector { radius }, center + Vector { radius } };
+    }
 
+    bool Plane::hit(const Ray& ray, float& t_max) const
+    {
         Point o = ray.origin;
         Vector d = ray.direction;
         Point p = this->point;
@@ -64,32 +66,119 @@ namespace Geometry
 
         if (std::abs(dot(n, d)) < epsilon)
         {
-            return RT::Trace { hit, 0.0f, origin, position, normal };
+            return false;
         }
 
         float t = dot(n, p - o) / dot(n, d);
 
-        if (t < 0.0f)
+        if (t < 0.0f || t >= t_max)
+        {
+            return false;
+        }
+
+        t_max = t;
+        return true;
+    }
+
+    Vector Plane::normal_at(const Point&) const
+    {
+        return normal.normalized();
+    }
+
+    RayShear shear_of(const Vector& direction)
+    {
+        const Vector size = direction.abs();
+        RayShear shear {};
+        shear.kz = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+        shear.kx = (shear.kz + 1) % 3;
+        shear.ky = (shear.kx + 1) % 3;
+        if (direction[shear.kz] < 0.0f)
+        {
+            std::swap(shear.kx, shear.ky);
+        }
+
+        shear.sx = direction[shear.kx] / direction[shear.kz];
+        shear.sy = direction[shear.ky] / direction[shear.kz];
+        shear.sz = 1.0f / direction[shear.kz];
+        return shear;
+    }
+
+    bool intersect_triangle(const Ray& ray, const Point& a, const Point& b, const Point& c, float& t)
+    {
+        const RayShear shear = shear_of(ray.direction);
+
+        // Vertices relative to the origin, sheared so that the ray is the z axis
+        float x[3], y[3], z[3];
+        const Point* corners[3] { &a, &b, &c };
+        for (size_t i = 0; i < 3; ++i)
+        {
+            const Vector p = *corners[i] - ray.origin;
+            x[i] = p[shear.kx] - SIMD::rounded(shear.sx * p[shear.kz]);
+            y[i] = p[shear.ky] - SIMD::rounded(shear.sy * p[shear.kz]);
+            z[i] = shear.sz * p[shear.kz];
+        }
+
+        // Edge functions: on which side of each edge the ray passes
+        float u = SIMD::rounded(x[2] * y[1]) - SIMD::rounded(y[2] * x[1]);
+        float v = SIMD::rounded(x[0] * y[2]) - SIMD::rounded(y[0] * x[2]);
+        float w = SIMD::rounded(x[1] * y[0]) - SIMD::rounded(y[1] * x[0]);
+
+        // Zero may only be a float rounding off; products of floats are
+        // exact in double
+        if (u == 0.0f || v == 0.0f || w == 0.0f)
+        {
+            u = static_cast<float>(double { x[2] } * y[1] - double { y[2] } * x[1]);
+            v = static_cast<float>(double { x[0] } * y[2] - double { y[0] } * x[2]);
+            w = static_cast<float>(double { x[1] } * y[0] - double { y[1] } * x[0]);
+        }
+
+        if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f))
+        {
+            return false;
+        }
+
+        float det = u + v + w;
+
+        if (det == 0.0f)
         {
-            return RT::Trace { hit, 0.0f, origin, position, normal };
+            return false;
         }
 
-        hit = true;
-        position = ray.at(t);
-        normal = n.normalized();
+        float distance = (u * z[0] + v * z[1] + w * z[2]) / det;
 
-        return RT::Trace { hit, t, origin, position, normal };
+        if (!(distance > 0.0f))
+        {
+            return false;
+        }
+
+        t = distance;
+        return true;
     }
 
-    RT::Trace Triangle::hit(const Ray& ray) const
+    bool Triangle::hit(const Ray& ray, float& t_max) const
     {
-        // TODO: Implement the hit function for Triangle
+        float t {};
+
+        if (!intersect_triangle(ray, a, b, c, t) || t >= t_max)
+        {
+            return false;
+        }
+
+        t_max = t;
+        return true;
+    }
 
-        bool hit { false };
-        Point origin { ray.origin };
-        Point position {};
-        Vector normal {};
+    Vector Triangle::normal_at(const Point&) const
+    {
+        return cross(b - a, c - a).normalized();
+    }
 
-        return RT::Trace { hit, 0.0f, origin, position, normal };
+    AABB Triangle::bounds() const
+    {
+        AABB box {};
+        box.expand(a);
+        box.expand(b);
+        box.expand(c);
+        return box;
     }
 }
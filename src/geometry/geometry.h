@@ -1,12 +1,36 @@
 #pragma once
 
+#include <cstdint>
+#include "../lib/aabb.h"
 #include "../lib/point.h"
 #include "../lib/ray.h"
+#include "../lib/ray_packet.h"
 #include "../lib/vector.h"
-#include "../raytracer/trace.h"
 
 namespace Geometry
 {
+    // A ray direction in the frame of the watertight ray/triangle test (Woop,
+    // Benthin and Wald, 2013): kz is its dominant axis, kx and ky the other
+    // two (swapped when the direction is negative along kz, which keeps the
+    // winding), and a point p relative to the origin lands at
+    // (p[kx] - sx p[kz], p[ky] - sy p[kz], sz p[kz]), where the ray is the
+    // positive z axis.
+    struct RayShear
+    {
+        uint32_t kx {}, ky {}, kz {};
+        float sx {}, sy {}, sz {};
+    };
+
+    RayShear shear_of(const Vector& direction);
+
+    // Watertight ray/triangle test against the triangle (a, b, c). Each edge
+    // is decided from its two vertices alone, the same way in the triangles
+    // on both sides of it, and edge values that come out as exactly zero are
+    // recomputed in double precision; so a ray through an edge or vertex
+    // shared by triangles that meet there hits at least one of them. On a hit
+    // in front of the origin, stores t.
+    bool intersect_triangle(const Ray& ray, const Point& a, const Point& b, const Point& c, float& t);
+
     class Sphere
     {
     public:
@@ -20,7 +44,18 @@ namespace Geometry
         ~Sphere() = default;
         Sphere& operator=(const Sphere&) = default;
 
-        RT::Trace hit(const Ray& ray) const;
+        // On a hit in front of the origin and closer than t_max, lowers t_max
+        // and returns true. Only the distance is computed; the surface at the
+        // hit comes from normal_at() once the closest hit is known.
+        bool hit(const Ray& ray, float& t_max) const;
+        Vector normal_at(const Point& position) const;
+
+        // Packet versions: t_max holds one distance per lane and is lowered
+        // where a lane finds a closer hit. Returns the mask of those lanes.
+        uint32_t hit(const RayPacket4& rays, float* t_max) const;
+        uint32_t hit(const RayPacket8& rays, float* t_max) const;
+
+        AABB bounds() const;
     };
 
     class Plane
@@ -36,7 +71,12 @@ namespace Geometry
         ~Plane() = default;
         Plane& operator=(const Plane&) = default;
 
-        RT::Trace hit(const Ray& ray) const;
+        // Same contract as Sphere's, scalar and packet.
+        bool hit(const Ray& ray, float& t_max) const;
+        Vector normal_at(const Point& position) const;
+
+        uint32_t hit(const RayPacket4& rays, float* t_max) const;
+        uint32_t hit(const RayPacket8& rays, float* t_max) const;
     };
 
     class Triangle
@@ -51,6 +91,10 @@ namespace Geometry
         ~Triangle() = default;
         Triangle& operator=(const Triangle&) = default;
 
-        RT::Trace hit(const Ray& ray) const;
+        // Same contract as Sphere's.
+        bool hit(const Ray& ray, float& t_max) const;
+        Vector normal_at(const Point& position) const;
+
+        AABB bounds() const;
     };
 }
@@ -0,0 +1,98 @@
+#include "../lib/simd.h"
+#include "geometry.h"
+
+// Packet intersection kernels. Each one mirrors the scalar hit() of the same
+// primitive operation for operation, with lanes that miss masked out instead
+// of branching.
+namespace Geometry
+{
+    namespace
+    {
+        template <typename F, size_t N>
+        uint32_t sphere_hit(const Sphere& sphere, const RayPacket<N>& rays, float* t_max)
+        {
+            uint32_t mask = 0;
+            for (size_t base = 0; base < N; base += F::width)
+            {
+                F fx = F::load(rays.ox + base) - F { sphere.center.x };
+                F fy = F::load(rays.oy + base) - F { sphere.center.y };
+                F fz = F::load(rays.oz + base) - F { sphere.center.z };
+                F dx = F::load(rays.dx + base);
+                F dy = F::load(rays.dy + base);
+                F dz = F::load(rays.dz + base);
+                F zero { 0.0f };
+                F r2 { sphere.radius * sphere.radius };
+
+                F a = dx * dx + dy * dy + dz * dz;
+                F b = fx * dx + fy * dy + fz * dz;
+                F s = b / a;
+                F lx = fx - s * dx, ly = fy - s * dy, lz = fz - s * dz;
+                F discriminant = a * (r2 - (lx * lx + ly * ly + lz * lz));
+
+                F c = (fx * fx + fy * fy + fz * fz) - r2;
+                F root = SIMD::sqrt(SIMD::max(discriminant, zero));
+                F q = SIMD::select(b < zero, root - b, -(b + root));
+                F t0 = c / q;
+                F t1 = q / a;
+                F t_near = SIMD::select(t0 < t1, t0, t1);
+                F t_far = SIMD::select(t0 < t1, t1, t0);
+                F t = SIMD::select(t_near > zero, t_near, t_far);
+
+                F closest = F::loadu(t_max + base);
+                F hit = (discriminant >= zero) & (t > zero) & (t < closest);
+
+                SIMD::select(hit, t, closest).storeu(t_max + base);
+                mask |= SIMD::movemask(hit) << base;
+            }
+            return mask;
+        }
+
+        template <typename F, size_t N>
+        uint32_t plane_hit(const Plane& plane, const RayPacket<N>& rays, float* t_max)
+        {
+            constexpr float epsilon = 1e-6f;
+
+            uint32_t mask = 0;
+            for (size_t base = 0; base < N; base += F::width)
+            {
+                F nx { plane.normal.x }, ny { plane.normal.y }, nz { plane.normal.z };
+                F dx = F::load(rays.dx + base);
+                F dy = F::load(rays.dy + base);
+                F dz = F::load(rays.dz + base);
+                F px = F { plane.point.x } - F::load(rays.ox + base);
+                F py = F { plane.point.y } - F::load(rays.oy + base);
+                F pz = F { plane.point.z } - F::load(rays.oz + base);
+
+                F denominator = nx * dx + ny * dy + nz * dz;
+                F t = (nx * px + ny * py + nz * pz) / denominator;
+
+                F closest = F::loadu(t_max + base);
+                F hit = (SIMD::abs(denominator) >= F { epsilon }) & (t >= F { 0.0f }) & (t < closest);
+
+                SIMD::select(hit, t, closest).storeu(t_max + base);
+                mask |= SIMD::movemask(hit) << base;
+            }
+            return mask;
+        }
+    }
+
+    uint32_t Sphere::hit(const RayPacket4& rays, float* t_max) const
+    {
+        return sphere_hit<SIMD::float4>(*this, rays, t_max);
+    }
+
+    uint32_t Sphere::hit(const RayPacket8& rays, float* t_max) const
+    {
+        return sphere_hit<SIMD::float8>(*this, rays, t_max);
+    }
+
+    uint32_t Plane::hit(const RayPacket4& rays, float* t_max) const
+    {
+        return plane_hit<SIMD::float4>(*this, rays, t_max);
+    }
+
+    uint32_t Plane::hit(const RayPacket8& rays, float* t_max) const
+    {
+        return plane_hit<SIMD::float8>(*this, rays, t_max);
+    }
+}
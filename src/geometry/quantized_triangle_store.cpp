@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cmath>
+#include "../kernels/kernels.h"
+#include "quantized_triangle_store.h"
+
+namespace Geometry
+{
+    QuantizedTriangleStore::QuantizedTriangleStore(Span<const Point> vertices, Span<const uint32_t> indices,
+                                                   const TriangleStore& layout)
+    {
+        // The grid spans the vertices the triangles use
+        AABB box {};
+        for (uint32_t id = 0; id < layout.size(); ++id)
+        {
+            const uint32_t* corner = &indices[3 * size_t { layout.get_face(id) }];
+            box.expand(vertices[corner[0]]);
+            box.expand(vertices[corner[1]]);
+            box.expand(vertices[corner[2]]);
+        }
+
+        if (!box.empty())
+        {
+            origin = box.min;
+            for (size_t axis = 0; axis < 3; ++axis)
+            {
+                // Smallest power of two with 65535 steps covering the extent
+                const float extent = box.max[axis] - box.min[axis];
+                int exponent = 0;
+                std::frexp(extent / 65535.0f, &exponent);
+                step[axis] = extent > 0.0f ? std::ldexp(1.0f, exponent) : 1.0f;
+            }
+        }
+
+        auto quantize = [&](float value, size_t axis) {
+            const float q = std::round((value - origin[axis]) / step[axis]);
+            return static_cast<uint16_t>(std::min(std::max(q, 0.0f), 65535.0f));
+        };
+
+        // Padded so that a batch starting at any triangle can be loaded whole
+        const size_t padded = layout.size() + batch_width;
+        for (Corner& corner : corners)
+        {
+            corner.x.assign(padded, 0);
+            corner.y.assign(padded, 0);
+            corner.z.assign(padded, 0);
+        }
+        faces.resize(layout.size());
+
+        for (uint32_t id = 0; id < layout.size(); ++id)
+        {
+            faces[id] = layout.get_face(id);
+            for (size_t c = 0; c < 3; ++c)
+            {
+                const Point& p = vertices[indices[3 * size_t { faces[id] } + c]];
+                corners[c].x[id] = quantize(p.x, 0);
+                corners[c].y[id] = quantize(p.y, 1);
+                corners[c].z[id] = quantize(p.z, 2);
+            }
+        }
+    }
+
+    Vector QuantizedTriangleStore::get_normal(uint32_t id) const
+    {
+        const Point a = decode(0, id);
+        Vector n = cross(decode(1, id) - a, decode(2, id) - a);
+        return n.norm_sqr() > 0.0f ? n.normalized() : n;
+    }
+
+    AABB QuantizedTriangleStore::bounds(uint32_t id) const
+    {
+        AABB box {};
+        for (size_t c = 0; c < 3; ++c)
+        {
+            box.expand(decode(c, id));
+        }
+        return box;
+    }
+
+    std::vector<AABB> QuantizedTriangleStore::all_bounds() const
+    {
+        std::vector<AABB> boxes(size());
+        for (uint32_t id = 0; id < size(); ++id)
+        {
+            boxes[id] = bounds(id);
+        }
+        return boxes;
+    }
+
+    size_t QuantizedTriangleStore::memory_bytes() const
+    {
+        size_t bytes = faces.capacity() * sizeof(uint32_t);
+        for (const Corner& corner : corners)
+        {
+            bytes += (corner.x.capacity() + corner.y.capacity() + corner.z.capacity()) * sizeof(uint16_t);
+        }
+        return bytes;
+    }
+
+    void QuantizedTriangleStore::reorder(const std::vector<uint32_t>& order)
+    {
+        auto permute = [&](auto& column) {
+            auto sorted = column;
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                sorted[i] = column[order[i]];
+            }
+            column.swap(sorted);
+        };
+
+        for (Corner& corner : corners)
+        {
+            permute(corner.x);
+            permute(corner.y);
+            permute(corner.z);
+        }
+        permute(faces);
+    }
+
+    uint32_t QuantizedTriangleStore::hit_batch(uint32_t base, uint32_t end, const Ray& ray, float t_max,
+                                               float* t_lanes) const
+    {
+        QuantizedTriangleBatch batch { {}, { origin.x, origin.y, origin.z }, { step.x, step.y, step.z } };
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            batch.corners[corner][0] = &corners[corner].x[base];
+            batch.corners[corner][1] = &corners[corner].y[base];
+            batch.corners[corner][2] = &corners[corner].z[base];
+        }
+        return Kernels::active().intersect_quantized_triangles(batch, std::min(end - base, batch_width), ray, t_max,
+                                                               t_lanes);
+    }
+
+    bool QuantizedTriangleStore::hit(uint32_t first, uint32_t count, const Ray& ray, float& t_max,
+                                     uint32_t& hit_id) const
+    {
+        bool found { false };
+        alignas(32) float t_lanes[batch_width];
+
+        for (uint32_t base = first; base < first + count; base += batch_width)
+        {
+            uint32_t lanes = hit_batch(base, first + count, ray, t_max, t_lanes);
+            for (uint32_t lane = 0; lanes && lane < batch_width; ++lane)
+            {
+                if ((lanes & (1u << lane)) && t_lanes[lane] < t_max)
+                {
+                    t_max = t_lanes[lane];
+                    hit_id = base + lane;
+                    found = true;
+                }
+            }
+        }
+
+        return found;
+    }
+
+    bool QuantizedTriangleStore::occluded(uint32_t first, uint32_t count, const Ray& ray, float t_max) const
+    {
+        alignas(32) float t_lanes[batch_width];
+
+        for (uint32_t base = first; base < first + count; base += batch_width)
+        {
+            if (hit_batch(base, first + count, ray, t_max, t_lanes))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
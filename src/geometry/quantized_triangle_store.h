@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../lib/aabb.h"
+#include "../lib/point.h"
+#include "../lib/ray.h"
+#include "../lib/span.h"
+#include "../lib/vector.h"
+#include "triangle_store.h"
+
+namespace Geometry
+{
+    // Eight quantized triangles: the grid codes of each corner, one pointer
+    // per corner and coordinate, and the grid they are on; see
+    // Kernels::Table::intersect_quantized_triangles.
+    struct QuantizedTriangleBatch
+    {
+        const uint16_t* corners[3][3];  // [corner][axis]
+        float origin[3];
+        float step[3];
+    };
+
+    // Mesh triangles with every vertex snapped to a 16-bit grid laid over the
+    // mesh's bounds: 18 bytes per triangle instead of the 48 of a
+    // TriangleStore, decoded to floats eight at a time right before the
+    // watertight test. Normals are not stored but recomputed on demand.
+    //
+    // A vertex's code depends on the vertex alone, so a vertex shared by
+    // several triangles decodes to the very same floats in all of them and
+    // edges between neighbours stay shared exactly: quantizing moves the
+    // surface slightly but opens no cracks. The grid step is a power of two,
+    // so code * step is exact and a decode rounds once, the same way wherever
+    // it happens; bounds() are those of the decoded triangles, so a hierarchy
+    // fitted to them encloses exactly what is intersected.
+    class QuantizedTriangleStore
+    {
+    private:
+        struct Corner
+        {
+            std::vector<uint16_t> x {}, y {}, z {};
+        };
+
+        Point origin {};
+        Vector step {};
+        Corner corners[3] {};
+        std::vector<uint32_t> faces {};  // source face of each triangle
+
+        Point decode(size_t corner, uint32_t id) const
+        {
+            return Point { origin.x + corners[corner].x[id] * step.x, origin.y + corners[corner].y[id] * step.y,
+                           origin.z + corners[corner].z[id] * step.z };
+        }
+
+        // Decodes the batch of triangles starting at base and tests it like
+        // TriangleStore does.
+        uint32_t hit_batch(uint32_t base, uint32_t end, const Ray& ray, float t_max, float* t_lanes) const;
+
+    public:
+        static constexpr uint32_t batch_width = TriangleStore::batch_width;
+
+        // The triangles of layout, in the same order. Their faces index
+        // indices (three per face), which index vertices, as in the
+        // TriangleStore constructor.
+        explicit QuantizedTriangleStore(Span<const Point> vertices, Span<const uint32_t> indices,
+                                        const TriangleStore& layout);
+
+        QuantizedTriangleStore() = default;
+        QuantizedTriangleStore(const QuantizedTriangleStore&) = default;
+        QuantizedTriangleStore(QuantizedTriangleStore&&) = default;
+        ~QuantizedTriangleStore() = default;
+        QuantizedTriangleStore& operator=(const QuantizedTriangleStore&) = default;
+        QuantizedTriangleStore& operator=(QuantizedTriangleStore&&) = default;
+
+        size_t size() const { return faces.size(); }
+        uint32_t get_face(uint32_t id) const { return faces[id]; }
+        Vector get_normal(uint32_t id) const;
+
+        AABB bounds(uint32_t id) const;
+        std::vector<AABB> all_bounds() const;
+
+        // Heap bytes held by the store.
+        size_t memory_bytes() const;
+
+        // Same contracts as TriangleStore's.
+        void reorder(const std::vector<uint32_t>& order);
+        bool hit(uint32_t first, uint32_t count, const Ray& ray, float& t_max, uint32_t& hit_id) const;
+        bool occluded(uint32_t first, uint32_t count, const Ray& ray, float t_max) const;
+    };
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include "../kernels/kernels.h"
+#include "sphere_store.h"
+
+namespace Geometry
+{
+    void SphereStore::pad()
+    {
+        // Padded so that a batch starting at any sphere can be loaded whole
+        const size_t padded = count + batch_width;
+        for (std::vector<float>* column : { &cx, &cy, &cz, &radius })
+        {
+            column->resize(padded, 0.0f);
+        }
+    }
+
+    void SphereStore::reserve(size_t spheres)
+    {
+        for (std::vector<float>* column : { &cx, &cy, &cz, &radius })
+        {
+            column->reserve(spheres + batch_width);
+        }
+    }
+
+    uint32_t SphereStore::add(const Point& center, float r)
+    {
+        cx.resize(count);
+        cy.resize(count);
+        cz.resize(count);
+        radius.resize(count);
+
+        cx.push_back(center.x);
+        cy.push_back(center.y);
+        cz.push_back(center.z);
+        radius.push_back(r);
+        ++count;
+
+        pad();
+        return static_cast<uint32_t>(count - 1);
+    }
+
+    void SphereStore::add_records(Span<const float> xyzr)
+    {
+        const size_t first = count;
+        count += xyzr.size() / 4;
+        pad();
+
+        for (size_t i = first; i < count; ++i)
+        {
+            const float* record = xyzr.data() + 4 * (i - first);
+            cx[i] = record[0];
+            cy[i] = record[1];
+            cz[i] = record[2];
+            radius[i] = record[3];
+        }
+    }
+
+    void SphereStore::set(uint32_t id, const Point& center, float r)
+    {
+        cx[id] = center.x;
+        cy[id] = center.y;
+        cz[id] = center.z;
+        radius[id] = r;
+    }
+
+    AABB SphereStore::bounds(uint32_t id) const
+    {
+        return get(id).bounds();
+    }
+
+    std::vector<AABB> SphereStore::all_bounds() const
+    {
+        std::vector<AABB> boxes(size());
+        for (uint32_t id = 0; id < size(); ++id)
+        {
+            boxes[id] = bounds(id);
+        }
+        return boxes;
+    }
+
+    void SphereStore::reorder(const std::vector<uint32_t>& order)
+    {
+        std::vector<float> sorted(cx.size(), 0.0f);
+        for (std::vector<float>* column : { &cx, &cy, &cz, &radius })
+        {
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                sorted[i] = (*column)[order[i]];
+            }
+            column->swap(sorted);
+        }
+    }
+
+    uint32_t SphereStore::hit_batch(uint32_t base, uint32_t end, const Ray& ray, float t_max, float* t_lanes) const
+    {
+        const SphereBatch batch { { &cx[base], &cy[base], &cz[base] }, &radius[base] };
+        return Kernels::active().intersect_spheres(batch, std::min(end - base, batch_width), ray, t_max, t_lanes);
+    }
+
+    bool SphereStore::hit(uint32_t first, uint32_t count, const Ray& ray, float& t_max, uint32_t& hit_id) const
+    {
+        bool found { false };
+        alignas(32) float t_lanes[batch_width];
+
+        for (uint32_t base = first; base < first + count; base += batch_width)
+        {
+            uint32_t lanes = hit_batch(base, first + count, ray, t_max, t_lanes);
+            if (!lanes)
+            {
+                continue;
+            }
+
+            for (uint32_t lane = 0; lane < batch_width; ++lane)
+            {
+                if ((lanes & (1u << lane)) && t_lanes[lane] < t_max)
+                {
+                    t_max = t_lanes[lane];
+                    hit_id = base + lane;
+                    found = true;
+                }
+            }
+        }
+
+        return found;
+    }
+
+    bool SphereStore::occluded(uint32_t first, uint32_t count, const Ray& ray, float t_max) const
+    {
+        alignas(32) float t_lanes[batch_width];
+
+        for (uint32_t base = first; base < first + count; base += batch_width)
+        {
+            if (hit_batch(base, first + count, ray, t_max, t_lanes))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "../lib/aabb.h"
+#include "../lib/point.h"
+#include "../lib/ray.h"
+#include "../lib/span.h"
+#include "geometry.h"
+
+namespace Geometry
+{
+    // Eight spheres, one pointer per coordinate array and one to the radii;
+    // see Kernels::Table::intersect_spheres.
+    struct SphereBatch
+    {
+        const float* center[3];
+        const float* radius;
+    };
+
+    // Spheres in structure-of-arrays form (16 bytes each), for scenes with
+    // millions of them such as particle or molecular data. As in TriangleStore,
+    // the arrays end with a batch width of padding so a batch loaded from any
+    // sphere never reads past the end.
+    class SphereStore
+    {
+    private:
+        std::vector<float> cx {}, cy {}, cz {}, radius {};
+        size_t count {};
+
+        void pad();
+
+    public:
+        static constexpr uint32_t batch_width = 8;
+
+        SphereStore() = default;
+        SphereStore(const SphereStore&) = default;
+        ~SphereStore() = default;
+        SphereStore& operator=(const SphereStore&) = default;
+
+        void reserve(size_t spheres);
+        uint32_t add(const Point& center, float r);
+
+        // Appends spheres stored as interleaved x, y, z, radius records.
+        void add_records(Span<const float> xyzr);
+
+        // Moves or resizes sphere id.
+        void set(uint32_t id, const Point& center, float r);
+
+        size_t size() const { return count; }
+        Sphere get(uint32_t id) const { return Sphere { Point { cx[id], cy[id], cz[id] }, radius[id] }; }
+
+        AABB bounds(uint32_t id) const;
+        std::vector<AABB> all_bounds() const;
+
+        // Permutes the spheres so that the one at order[i] moves to slot i.
+        void reorder(const std::vector<uint32_t>& order);
+
+        // Tests spheres [first, first + count) batch_width at a time with the
+        // same math as Sphere::hit. On a hit closer than t_max, lowers t_max,
+        // stores the sphere in hit_id and returns true.
+        bool hit(uint32_t first, uint32_t count, const Ray& ray, float& t_max, uint32_t& hit_id) const;
+
+        // Any-hit version for shadow rays.
+        bool occluded(uint32_t first, uint32_t count, const Ray& ray, float t_max) const;
+
+    private:
+        // Lanes of the batch at base (masking off spheres at or past end) hit
+        // before t_max; every lane's distance goes to t_lanes.
+        uint32_t hit_batch(uint32_t base, uint32_t end, const Ray& ray, float t_max, float* t_lanes) const;
+    };
+}
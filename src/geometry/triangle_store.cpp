@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <type_traits>
+#include "../kernels/kernels.h"
+#include "geometry.h"
+#include "triangle_store.h"
+
+namespace Geometry
+{
+    TriangleStore::TriangleStore(Span<const Point> vertices, Span<const uint32_t> indices)
+    {
+        const size_t triangles = indices.size() / 3;
+        for (Columns* column : { &v0, &v1, &v2, &normal })
+        {
+            column->x.reserve(triangles + batch_width);
+            column->y.reserve(triangles + batch_width);
+            column->z.reserve(triangles + batch_width);
+        }
+        faces.reserve(triangles);
+
+        for (size_t i = 0; i < triangles; ++i)
+        {
+            const uint32_t a = indices[3 * i], b = indices[3 * i + 1], c = indices[3 * i + 2];
+            if (a >= vertices.size() || b >= vertices.size() || c >= vertices.size())
+            {
+                continue;
+            }
+
+            Vector n = cross(vertices[b] - vertices[a], vertices[c] - vertices[a]);
+            n = n.norm_sqr() > 0.0f ? n.normalized() : n;
+
+            v0.x.push_back(vertices[a].x);
+            v0.y.push_back(vertices[a].y);
+            v0.z.push_back(vertices[a].z);
+            v1.x.push_back(vertices[b].x);
+            v1.y.push_back(vertices[b].y);
+            v1.z.push_back(vertices[b].z);
+            v2.x.push_back(vertices[c].x);
+            v2.y.push_back(vertices[c].y);
+            v2.z.push_back(vertices[c].z);
+            normal.x.push_back(n.x);
+            normal.y.push_back(n.y);
+            normal.z.push_back(n.z);
+            faces.push_back(static_cast<uint32_t>(i));
+        }
+
+        pad();
+    }
+
+    void TriangleStore::pad()
+    {
+        // Padded so that a batch starting at any triangle can be loaded whole
+        const size_t padded = faces.size() + batch_width;
+        for (Columns* column : { &v0, &v1, &v2, &normal })
+        {
+            column->x.resize(padded, 0.0f);
+            column->y.resize(padded, 0.0f);
+            column->z.resize(padded, 0.0f);
+        }
+    }
+
+    AABB TriangleStore::bounds(uint32_t id) const
+    {
+        AABB box {};
+        for (const Columns* corner : { &v0, &v1, &v2 })
+        {
+            box.expand(Point { corner->x[id], corner->y[id], corner->z[id] });
+        }
+        return box;
+    }
+
+    std::vector<AABB> TriangleStore::all_bounds() const
+    {
+        std::vector<AABB> boxes(size());
+        for (uint32_t id = 0; id < size(); ++id)
+        {
+            boxes[id] = bounds(id);
+        }
+        return boxes;
+    }
+
+    size_t TriangleStore::memory_bytes() const
+    {
+        size_t bytes = faces.capacity() * sizeof(uint32_t);
+        for (const Columns* column : { &v0, &v1, &v2, &normal })
+        {
+            bytes += (column->x.capacity() + column->y.capacity() + column->z.capacity()) * sizeof(float);
+        }
+        return bytes;
+    }
+
+    std::vector<AABB> TriangleStore::range_bounds(uint32_t first, uint32_t count) const
+    {
+        std::vector<AABB> boxes(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            boxes[i] = bounds(first + i);
+        }
+        return boxes;
+    }
+
+    bool TriangleStore::update(Span<const Point> vertices, Span<const uint32_t> indices)
+    {
+        for (uint32_t face : faces)
+        {
+            if (3 * size_t { face } + 2 >= indices.size() || indices[3 * face] >= vertices.size() ||
+                indices[3 * face + 1] >= vertices.size() || indices[3 * face + 2] >= vertices.size())
+            {
+                return false;
+            }
+        }
+
+        for (uint32_t id = 0; id < size(); ++id)
+        {
+            const uint32_t* corner = &indices[3 * faces[id]];
+            const Point& a = vertices[corner[0]];
+            const Point& b = vertices[corner[1]];
+            const Point& c = vertices[corner[2]];
+            Vector n = cross(b - a, c - a);
+            n = n.norm_sqr() > 0.0f ? n.normalized() : n;
+
+            v0.x[id] = a.x;
+            v0.y[id] = a.y;
+            v0.z[id] = a.z;
+            v1.x[id] = b.x;
+            v1.y[id] = b.y;
+            v1.z[id] = b.z;
+            v2.x[id] = c.x;
+            v2.y[id] = c.y;
+            v2.z[id] = c.z;
+            normal.x[id] = n.x;
+            normal.y[id] = n.y;
+            normal.z[id] = n.z;
+        }
+        return true;
+    }
+
+    void TriangleStore::reorder(const std::vector<uint32_t>& order)
+    {
+        reorder(0, order);
+    }
+
+    void TriangleStore::reorder(uint32_t first, const std::vector<uint32_t>& order)
+    {
+        auto permute = [&](auto& column) {
+            std::vector<std::decay_t<decltype(column[0])>> sorted(order.size());
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                sorted[i] = column[first + order[i]];
+            }
+            std::copy(sorted.begin(), sorted.end(), column.begin() + first);
+        };
+
+        for (Columns* column : { &v0, &v1, &v2, &normal })
+        {
+            permute(column->x);
+            permute(column->y);
+            permute(column->z);
+        }
+        permute(faces);
+    }
+
+    bool TriangleStore::hit(uint32_t id, const Ray& ray, float& t_max) const
+    {
+        float t {};
+        bool found = intersect_triangle(ray, Point { v0.x[id], v0.y[id], v0.z[id] },
+                                        Point { v1.x[id], v1.y[id], v1.z[id] },
+                                        Point { v2.x[id], v2.y[id], v2.z[id] }, t);
+        if (found && t < t_max)
+        {
+            t_max = t;
+            return true;
+        }
+        return false;
+    }
+
+    uint32_t TriangleStore::hit_batch(uint32_t base, uint32_t end, const Ray& ray, float t_max, float* t_lanes) const
+    {
+        const TriangleBatch batch { { { &v0.x[base], &v0.y[base], &v0.z[base] },
+                                      { &v1.x[base], &v1.y[base], &v1.z[base] },
+                                      { &v2.x[base], &v2.y[base], &v2.z[base] } } };
+        return Kernels::active().intersect_triangles(batch, std::min(end - base, batch_width), ray, t_max, t_lanes);
+    }
+
+    bool TriangleStore::hit(uint32_t first, uint32_t count, const Ray& ray, float& t_max, uint32_t& hit_id) const
+    {
+        bool found { false };
+        alignas(32) float t_lanes[batch_width];
+
+        for (uint32_t base = first; base < first + count; base += batch_width)
+        {
+            uint32_t lanes = hit_batch(base, first + count, ray, t_max, t_lanes);
+            if (!lanes)
+            {
+                continue;
+            }
+
+            for (uint32_t lane = 0; lane < batch_width; ++lane)
+            {
+                if ((lanes & (1u << lane)) && t_lanes[lane] < t_max)
+                {
+                    t_max = t_lanes[lane];
+                    hit_id = base + lane;
+                    found = true;
+                }
+            }
+        }
+
+        return found;
+    }
+
+    bool TriangleStore::occluded(uint32_t first, uint32_t count, const Ray& ray, float t_max) const
+    {
+        alignas(32) float t_lanes[batch_width];
+
+        for (uint32_t base = first; base < first + count; base += batch_width)
+        {
+            if (hit_batch(base, first + count, ray, t_max, t_lanes))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
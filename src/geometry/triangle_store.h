@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "../lib/aabb.h"
+#include "../lib/point.h"
+#include "../lib/ray.h"
+#include "../lib/span.h"
+#include "../lib/vector.h"
+
+namespace Geometry
+{
+    // Eight triangles, one pointer per corner and coordinate array; see
+    // Kernels::Table::intersect_triangles.
+    struct TriangleBatch
+    {
+        const float* corners[3][3];  // [corner][axis]
+    };
+
+    // Mesh triangles kept for intersection in structure-of-arrays form: the
+    // three vertices and the unit normal, one float array per coordinate.
+    // Vertices are stored as they are rather than as one vertex and two
+    // edges, so a vertex shared by several triangles is the very same point
+    // in all of them, which the watertight test needs. Arrays end with a
+    // batch width of degenerate triangles: BVH leaves start anywhere, and a
+    // batch loaded from any triangle must not read past the end.
+    class TriangleStore
+    {
+    private:
+        struct Columns
+        {
+            std::vector<float> x {}, y {}, z {};
+        };
+
+        Columns v0 {}, v1 {}, v2 {}, normal {};
+        std::vector<uint32_t> faces {};  // source face of each triangle
+
+        void pad();
+
+        // Tests the batch of triangles starting at base (those at or past end are
+        // masked off). Returns the mask of lanes hit before t_max and stores
+        // every lane's distance in t_lanes.
+        uint32_t hit_batch(uint32_t base, uint32_t end, const Ray& ray, float t_max, float* t_lanes) const;
+
+    public:
+        static constexpr uint32_t batch_width = 8;
+
+        // indices holds three vertex indices per triangle; triangles referencing
+        // vertices out of range are skipped.
+        explicit TriangleStore(Span<const Point> vertices, Span<const uint32_t> indices);
+
+        TriangleStore() = default;
+        TriangleStore(const TriangleStore&) = default;
+        TriangleStore(TriangleStore&&) = default;
+        ~TriangleStore() = default;
+        TriangleStore& operator=(const TriangleStore&) = default;
+        TriangleStore& operator=(TriangleStore&&) = default;
+
+        size_t size() const { return faces.size(); }
+        uint32_t get_face(uint32_t id) const { return faces[id]; }
+        Vector get_normal(uint32_t id) const { return Vector { normal.x[id], normal.y[id], normal.z[id] }; }
+
+        AABB bounds(uint32_t id) const;
+        std::vector<AABB> all_bounds() const;
+
+        // Heap bytes held by the store.
+        size_t memory_bytes() const;
+
+        // Boxes of triangles [first, first + count).
+        std::vector<AABB> range_bounds(uint32_t first, uint32_t count) const;
+
+        // Moves the triangles to new vertex positions. indices must be the
+        // list given to the constructor (the faces stay the same, only the
+        // vertices move). Returns false, changing nothing, if a face now
+        // references a vertex out of range.
+        bool update(Span<const Point> vertices, Span<const uint32_t> indices);
+
+        // Permutes the triangles so that the one at order[i] moves to slot i,
+        // e.g. with BVH::get_indices() so that every leaf is a contiguous range.
+        void reorder(const std::vector<uint32_t>& order);
+
+        // Same within one range: the triangle at first + order[i] moves to
+        // first + i, and the triangles outside the range stay where they are.
+        void reorder(uint32_t first, const std::vector<uint32_t>& order);
+
+        // Watertight test of one triangle. On a hit closer than t_max, lowers
+        // t_max and returns true.
+        bool hit(uint32_t id, const Ray& ray, float& t_max) const;
+
+        // Tests triangles [first, first + count) batch_width at a time. On a
+        // hit closer than t_max, lowers t_max, stores the triangle in hit_id
+        // and returns true.
+        bool hit(uint32_t first, uint32_t count, const Ray& ray, float& t_max, uint32_t& hit_id) const;
+
+        // Any-hit version for shadow rays: true as soon as one triangle in
+        // [first, first + count) is hit before t_max.
+        bool occluded(uint32_t first, uint32_t count, const Ray& ray, float t_max) const;
+    };
+}
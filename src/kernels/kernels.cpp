@@ -0,0 +1,118 @@
+#include "kernels.h"
+
+namespace Kernels
+{
+    namespace baseline
+    {
+        extern const Table table;
+    }
+#if KERNELS_VARIANTS
+    namespace sse42
+    {
+        extern const Table table;
+    }
+    namespace avx2
+    {
+        extern const Table table;
+    }
+    namespace avx512
+    {
+        extern const Table table;
+    }
+#endif
+
+    namespace
+    {
+        struct Variant
+        {
+            const Table& table;
+            bool (*supported)();
+        };
+
+        bool always()
+        {
+            return true;
+        }
+
+#if KERNELS_VARIANTS
+        // __builtin_cpu_supports also checks that the OS saves the AVX and
+        // AVX-512 registers. The init call makes it safe before main().
+        bool has_sse42()
+        {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.2");
+        }
+
+        bool has_avx2()
+        {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        }
+
+        bool has_avx512()
+        {
+            __builtin_cpu_init();
+            return has_avx2() && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+                   __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq");
+        }
+#endif
+
+        // Slowest first
+        const Variant variants[] {
+            { baseline::table, always },
+#if KERNELS_VARIANTS
+            { sse42::table, has_sse42 },
+            { avx2::table, has_avx2 },
+            { avx512::table, has_avx512 },
+#endif
+        };
+    }
+
+    namespace detail
+    {
+        const Table* current = &best();
+    }
+
+    const Table& best()
+    {
+        const Table* fastest = &baseline::table;
+        for (const Variant& variant : variants)
+        {
+            if (variant.supported())
+            {
+                fastest = &variant.table;
+            }
+        }
+        return *fastest;
+    }
+
+    const Table* find(const std::string& name)
+    {
+        for (const Variant& variant : variants)
+        {
+            if (name == variant.table.name && variant.supported())
+            {
+                return &variant.table;
+            }
+        }
+        return nullptr;
+    }
+
+    std::vector<std::string> available()
+    {
+        std::vector<std::string> names;
+        for (const Variant& variant : variants)
+        {
+            if (variant.supported())
+            {
+                names.push_back(variant.table.name);
+            }
+        }
+        return names;
+    }
+
+    void use(const Table& table)
+    {
+        detail::current = &table;
+    }
+}
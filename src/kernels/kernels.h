@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../lib/ray.h"
+#include "../lib/vector.h"
+
+// The SSE4.2, AVX2 and AVX-512 variants need g++'s #pragma GCC target and an
+// x86 CPU; elsewhere only the baseline is built.
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_VARIANTS 1
+#else
+#define KERNELS_VARIANTS 0
+#endif
+
+namespace Accel
+{
+    struct WideNode;
+}
+
+namespace Geometry
+{
+    struct TriangleBatch;
+    struct QuantizedTriangleBatch;
+    struct SphereBatch;
+}
+
+// The innermost loops of the renderer, compiled once for the instruction set
+// of the build and, with g++ on x86, once more for each of SSE4.2, AVX2 and
+// AVX-512 (kernels_<isa>.cpp). The best variant the CPU runs is picked at
+// startup, so the same binary uses 256-bit registers and FMA where they exist
+// and still runs on the machines without them.
+//
+// Variants round differently (FMA fuses a multiply and an add), so images
+// rendered with two of them can differ in the last bits of a few pixels;
+// use() pins one, e.g. to compare timings or to reproduce an image exactly.
+namespace Kernels
+{
+    // Film of a pinhole camera: pixel (x, y) lies at base + x * du + y * dv
+    // from the camera center.
+    struct Film
+    {
+        Vector base {};
+        Vector du {}, dv {};
+    };
+
+    struct Table
+    {
+        const char* name;
+
+        // Watertight test (Geometry::intersect_triangle) of the first lanes
+        // triangles of batch; the others are masked off. Returns the mask of
+        // lanes hit before t_max and stores every lane's distance in t_lanes.
+        uint32_t (*intersect_triangles)(const Geometry::TriangleBatch& batch, uint32_t lanes, const Ray& ray,
+                                        float t_max, float* t_lanes);
+
+        // Same over eight quantized triangles, decoded first.
+        uint32_t (*intersect_quantized_triangles)(const Geometry::QuantizedTriangleBatch& batch, uint32_t lanes,
+                                                  const Ray& ray, float t_max, float* t_lanes);
+
+        // Same for eight spheres, with the math of Geometry::Sphere::hit.
+        uint32_t (*intersect_spheres)(const Geometry::SphereBatch& batch, uint32_t lanes, const Ray& ray,
+                                      float t_max, float* t_lanes);
+
+        // Slab test of the ray against the decoded boxes of all children of
+        // node. Returns the mask of the children hit before t_max and stores
+        // the distance at which the ray enters each of them in t_entry.
+        uint32_t (*intersect_children)(const Accel::WideNode& node, const Ray& ray, const Vector& inv_direction,
+                                       float t_max, float* t_entry);
+
+        // Unit directions through pixels px .. px + 7 of row py of film, each
+        // moved by (offset_x[i], offset_y[i]) pixels unless the offsets are null.
+        void (*primary_directions)(const Film& film, uint32_t px, uint32_t py, const float* offset_x,
+                                   const float* offset_y, float* dx, float* dy, float* dz);
+
+        // Clamps count colors to [0, 1] and scales them to bytes.
+        void (*colors_to_bytes)(const float* colors, size_t count, uint8_t* bytes);
+    };
+
+    namespace detail
+    {
+        extern const Table* current;
+    }
+
+    // Variant in use. Reading it is not synchronized with use(), so pick the
+    // variant before rendering starts.
+    inline const Table& active()
+    {
+        return *detail::current;
+    }
+
+    // Fastest variant built into the program that this CPU runs.
+    const Table& best();
+
+    // Variant called name ("baseline", "sse4.2", "avx2" or "avx512"), or
+    // nullptr if it was not built or this CPU cannot run it.
+    const Table* find(const std::string& name);
+
+    // Names of the variants this CPU runs, slowest first.
+    std::vector<std::string> available();
+
+    void use(const Table& table);
+}
@@ -0,0 +1,14 @@
+// Kernels for AVX2 and FMA: eight lanes in one register, fused multiply-adds.
+#include "kernels_variant.h"
+
+#if KERNELS_VARIANTS
+#pragma GCC target("avx2,fma")
+
+#define KERNELS_ISA avx2
+#define KERNELS_NAME "avx2"
+#define SIMD_SSE2 1
+#define SIMD_SSE41 1
+#define SIMD_AVX 1
+#define SIMD_AVX2 1
+#include "kernels_body.h"
+#endif
@@ -0,0 +1,16 @@
+// Kernels for AVX-512 (F, VL, BW, DQ). Batches and wide nodes hold eight
+// lanes, so the kernels stay 256 bits wide; they gain the 32 registers and
+// the mask registers of AVX-512, which the compiler uses for comparisons.
+#include "kernels_variant.h"
+
+#if KERNELS_VARIANTS
+#pragma GCC target("avx512f,avx512vl,avx512bw,avx512dq,avx2,fma")
+
+#define KERNELS_ISA avx512
+#define KERNELS_NAME "avx512"
+#define SIMD_SSE2 1
+#define SIMD_SSE41 1
+#define SIMD_AVX 1
+#define SIMD_AVX2 1
+#include "kernels_body.h"
+#endif
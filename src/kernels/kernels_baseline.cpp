@@ -0,0 +1,7 @@
+// Kernels for the instruction set the program is built for, which every CPU
+// that runs it has.
+#include "kernels_variant.h"
+
+#define KERNELS_ISA baseline
+#define KERNELS_NAME "baseline"
+#include "kernels_body.h"
@@ -0,0 +1,236 @@
+// Kernels of one variant, in namespace Kernels::KERNELS_ISA, ending with
+// the variant's Table. No include guard: kernels_<isa>.cpp includes this once,
+// after kernels_variant.h and after its #pragma GCC target, with KERNELS_ISA
+// and the SIMD_* switches of ../lib/simd.h set for the instruction set.
+//
+// Only simd.h is compiled here for the variant. Everything else the kernels
+// use was already included for the build's instruction set, and nothing else
+// may be: an inline function or template compiled here for AVX2 could be
+// the copy the linker keeps for the whole program.
+
+#define SIMD_TARGET KERNELS_ISA
+#include "../lib/simd.h"
+
+namespace Kernels
+{
+    namespace KERNELS_ISA
+    {
+        namespace
+        {
+            using SIMD::float8;
+            static_assert(float8::width == Geometry::TriangleStore::batch_width &&
+                              float8::width == Geometry::SphereStore::batch_width,
+                          "one SIMD lane per primitive of a batch");
+
+            // Edge function of the edge from (px, py) to (qx, qy), in double,
+            // where the products of floats are exact.
+            float edge_in_double(float px, float py, float qx, float qy)
+            {
+                return static_cast<float>(double { qx } * py - double { qy } * px);
+            }
+
+            uint32_t intersect_triangles(const Geometry::TriangleBatch& batch, uint32_t lanes, const Ray& ray,
+                                         float t_max, float* t_lanes)
+            {
+                // Same steps as Geometry::intersect_triangle
+                const Geometry::RayShear shear = Geometry::shear_of(ray.direction);
+                const float8 sx { shear.sx }, sy { shear.sy }, sz { shear.sz };
+                const float8 zero { 0.0f };
+
+                float8 x[3], y[3], z[3];
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    const float8 px = float8::loadu(batch.corners[i][shear.kx]) - float8 { ray.origin[shear.kx] };
+                    const float8 py = float8::loadu(batch.corners[i][shear.ky]) - float8 { ray.origin[shear.ky] };
+                    const float8 pz = float8::loadu(batch.corners[i][shear.kz]) - float8 { ray.origin[shear.kz] };
+                    x[i] = px - SIMD::rounded(sx * pz);
+                    y[i] = py - SIMD::rounded(sy * pz);
+                    z[i] = sz * pz;
+                }
+
+                float8 u = SIMD::rounded(x[2] * y[1]) - SIMD::rounded(y[2] * x[1]);
+                float8 v = SIMD::rounded(x[0] * y[2]) - SIMD::rounded(y[0] * x[2]);
+                float8 w = SIMD::rounded(x[1] * y[0]) - SIMD::rounded(y[1] * x[0]);
+
+                const float8 in_range = float8::iota(0.0f) < float8 { static_cast<float>(lanes) };
+                auto is_zero = [&](float8 e) { return (e >= zero) & (e <= zero); };
+                const uint32_t flat = SIMD::movemask(in_range & (is_zero(u) | is_zero(v) | is_zero(w)));
+                if (flat)
+                {
+                    alignas(32) float xs[3][8], ys[3][8], us[8], vs[8], ws[8];
+                    for (size_t i = 0; i < 3; ++i)
+                    {
+                        x[i].store(xs[i]);
+                        y[i].store(ys[i]);
+                    }
+                    u.store(us);
+                    v.store(vs);
+                    w.store(ws);
+                    for (uint32_t lane = 0; lane < float8::width; ++lane)
+                    {
+                        if (flat & (1u << lane))
+                        {
+                            us[lane] = edge_in_double(xs[1][lane], ys[1][lane], xs[2][lane], ys[2][lane]);
+                            vs[lane] = edge_in_double(xs[2][lane], ys[2][lane], xs[0][lane], ys[0][lane]);
+                            ws[lane] = edge_in_double(xs[0][lane], ys[0][lane], xs[1][lane], ys[1][lane]);
+                        }
+                    }
+                    u = float8::load(us);
+                    v = float8::load(vs);
+                    w = float8::load(ws);
+                }
+
+                const float8 inside = ((u >= zero) & (v >= zero) & (w >= zero)) |
+                                      ((u <= zero) & (v <= zero) & (w <= zero));
+                const float8 det = u + v + w;
+                const float8 t = (u * z[0] + v * z[1] + w * z[2]) / det;
+                const float8 mask = in_range & inside & ((det < zero) | (det > zero)) & (t > zero) &
+                                    (t < float8 { t_max });
+
+                t.store(t_lanes);
+                return SIMD::movemask(mask);
+            }
+
+            uint32_t intersect_quantized_triangles(const Geometry::QuantizedTriangleBatch& batch, uint32_t lanes,
+                                                   const Ray& ray, float t_max, float* t_lanes)
+            {
+                // Every corner is decoded the same way, so a shared vertex is
+                // the same point in all its triangles
+                alignas(32) float corners[3][3][8];
+                for (size_t axis = 0; axis < 3; ++axis)
+                {
+                    const float8 o { batch.origin[axis] }, s { batch.step[axis] };
+                    for (size_t i = 0; i < 3; ++i)
+                    {
+                        (o + float8::convert(batch.corners[i][axis]) * s).store(corners[i][axis]);
+                    }
+                }
+
+                const Geometry::TriangleBatch decoded { { { corners[0][0], corners[0][1], corners[0][2] },
+                                                          { corners[1][0], corners[1][1], corners[1][2] },
+                                                          { corners[2][0], corners[2][1], corners[2][2] } } };
+                return intersect_triangles(decoded, lanes, ray, t_max, t_lanes);
+            }
+
+            uint32_t intersect_spheres(const Geometry::SphereBatch& batch, uint32_t lanes, const Ray& ray,
+                                       float t_max, float* t_lanes)
+            {
+                // a depends on the ray alone
+                const float8 dx { ray.direction.x }, dy { ray.direction.y }, dz { ray.direction.z };
+                const float8 zero { 0.0f };
+                const float8 a = dx * dx + dy * dy + dz * dz;
+
+                float8 fx = float8 { ray.origin.x } - float8::loadu(batch.center[0]);
+                float8 fy = float8 { ray.origin.y } - float8::loadu(batch.center[1]);
+                float8 fz = float8 { ray.origin.z } - float8::loadu(batch.center[2]);
+                float8 r = float8::loadu(batch.radius);
+                float8 r2 = r * r;
+
+                // Same steps as Sphere::hit
+                float8 b = fx * dx + fy * dy + fz * dz;
+                float8 s = b / a;
+                float8 lx = fx - s * dx, ly = fy - s * dy, lz = fz - s * dz;
+                float8 discriminant = a * (r2 - (lx * lx + ly * ly + lz * lz));
+
+                float8 c = (fx * fx + fy * fy + fz * fz) - r2;
+                float8 root = SIMD::sqrt(SIMD::max(discriminant, zero));
+                float8 q = SIMD::select(b < zero, root - b, -(b + root));
+                float8 t0 = c / q;
+                float8 t1 = q / a;
+                float8 t_near = SIMD::select(t0 < t1, t0, t1);
+                float8 t_far = SIMD::select(t0 < t1, t1, t0);
+                float8 t = SIMD::select(t_near > zero, t_near, t_far);
+
+                float8 in_range = float8::iota(0.0f) < float8 { static_cast<float>(lanes) };
+                float8 mask = in_range & (discriminant >= zero) & (t > zero) & (t < float8 { t_max });
+
+                t.store(t_lanes);
+                return SIMD::movemask(mask);
+            }
+
+            // 2^exponent, built from its bits (exponent is within the normal range).
+            float power_of_two(int exponent)
+            {
+                const uint32_t bits = static_cast<uint32_t>(exponent + 127) << 23;
+                float f;
+                std::memcpy(&f, &bits, sizeof(f));
+                return f;
+            }
+
+            uint32_t intersect_children(const Accel::WideNode& node, const Ray& ray, const Vector& inv_direction,
+                                        float t_max, float* t_entry)
+            {
+                static_assert(float8::width == Accel::WideNode::width, "one SIMD lane per child");
+
+                // Decoded boxes, then the same slab test as AABB::intersect on all children at once
+                const float8 far_scale { AABB::far_scale };
+                float8 t0 { 0.0f }, t1 { t_max };
+                for (size_t axis = 0; axis < 3; ++axis)
+                {
+                    const float8 origin { node.origin[axis] }, step { power_of_two(node.exponent[axis]) };
+                    const float8 o { ray.origin[axis] }, inv { inv_direction[axis] };
+                    const float8 near = (origin + float8::convert(node.lo[axis]) * step - o) * inv;
+                    const float8 far = (origin + float8::convert(node.hi[axis]) * step - o) * inv;
+                    t0 = SIMD::max(t0, SIMD::min(near, far));
+                    t1 = SIMD::min(t1, SIMD::max(near, far) * far_scale);
+                }
+
+                const float8 used = float8::iota(0.0f) < float8 { static_cast<float>(node.child_count) };
+                t0.store(t_entry);
+                return SIMD::movemask(used & (t0 <= t1));
+            }
+
+            void primary_directions(const Film& film, uint32_t px, uint32_t py, const float* offset_x,
+                                    const float* offset_y, float* dx, float* dy, float* dz)
+            {
+                float8 x, y, z;
+                if (offset_x)
+                {
+                    const float8 sx = float8::iota(static_cast<float>(px)) + float8::loadu(offset_x);
+                    const float8 sy = float8 { static_cast<float>(py) } + float8::loadu(offset_y);
+
+                    x = (float8 { film.base.x } + sx * float8 { film.du.x }) + sy * float8 { film.dv.x };
+                    y = (float8 { film.base.y } + sx * float8 { film.du.y }) + sy * float8 { film.dv.y };
+                    z = (float8 { film.base.z } + sx * float8 { film.du.z }) + sy * float8 { film.dv.z };
+                }
+                else
+                {
+                    // Offset of the row from the camera center, then one step per pixel
+                    const float row[3] { film.base.x + static_cast<float>(py) * film.dv.x,
+                                         film.base.y + static_cast<float>(py) * film.dv.y,
+                                         film.base.z + static_cast<float>(py) * film.dv.z };
+                    const float8 sx = float8::iota(static_cast<float>(px));
+
+                    x = float8 { row[0] } + sx * float8 { film.du.x };
+                    y = float8 { row[1] } + sx * float8 { film.du.y };
+                    z = float8 { row[2] } + sx * float8 { film.du.z };
+                }
+
+                float8 norm = SIMD::sqrt(x * x + y * y + z * z);
+                (x / norm).storeu(dx);
+                (y / norm).storeu(dy);
+                (z / norm).storeu(dz);
+            }
+
+            void colors_to_bytes(const float* colors, size_t count, uint8_t* bytes)
+            {
+                const float8 zero { 0.0f }, one { 1.0f }, scale { 255.99f };
+                size_t i = 0;
+                for (; i + float8::width <= count; i += float8::width)
+                {
+                    (SIMD::min(SIMD::max(float8::loadu(colors + i), zero), one) * scale).store_bytes(bytes + i);
+                }
+                for (; i < count; ++i)
+                {
+                    const float c = colors[i] > 0.0f ? colors[i] : 0.0f;
+                    bytes[i] = static_cast<uint8_t>(255.99f * (c < 1.0f ? c : 1.0f));
+                }
+            }
+        }
+
+        extern const Table table;
+        const Table table { KERNELS_NAME,        &intersect_triangles, &intersect_quantized_triangles,
+                            &intersect_spheres,  &intersect_children,  &primary_directions,
+                            &colors_to_bytes };
+    }
+}
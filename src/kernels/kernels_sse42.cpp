@@ -0,0 +1,12 @@
+// Kernels for SSE4.2: blends and widening conversions in one instruction.
+#include "kernels_variant.h"
+
+#if KERNELS_VARIANTS
+#pragma GCC target("sse4.2")
+
+#define KERNELS_ISA sse42
+#define KERNELS_NAME "sse4.2"
+#define SIMD_SSE2 1
+#define SIMD_SSE41 1
+#include "kernels_body.h"
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+// Everything kernels_body.h uses besides ../lib/simd.h. Each kernels_<isa>.cpp
+// includes this first, so that all of it is compiled for the build's
+// instruction set before the file switches to its own.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "../accel/wide_bvh.h"
+#include "../geometry/geometry.h"
+#include "../geometry/quantized_triangle_store.h"
+#include "../geometry/sphere_store.h"
+#include "../geometry/triangle_store.h"
+#include "../lib/ray.h"
+#include "../lib/vector.h"
+#include "kernels.h"
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <ostream>
+#include "point.h"
+#include "vector.h"
+
+struct AABB
+{
+    Point min { std::numeric_limits<float>::max() };
+    Point max { -std::numeric_limits<float>::max() };
+
+    explicit AABB(Point min, Point max) : min { min }, max { max } {}
+
+    AABB() = default;
+    AABB(const AABB&) = default;
+    ~AABB() = default;
+    AABB& operator=(const AABB&) = default;
+
+    bool empty() const
+    {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+
+    void expand(const Point& p)
+    {
+        min = Point { std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z) };
+        max = Point { std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z) };
+    }
+
+    void expand(const AABB& b)
+    {
+        min = Point { std::min(min.x, b.min.x), std::min(min.y, b.min.y), std::min(min.z, b.min.z) };
+        max = Point { std::max(max.x, b.max.x), std::max(max.y, b.max.y), std::max(max.z, b.max.z) };
+    }
+
+    Point centroid() const
+    {
+        return min + (max - min) * 0.5f;
+    }
+
+    Vector extent() const
+    {
+        return max - min;
+    }
+
+    float surface_area() const
+    {
+        if (empty())
+        {
+            return 0.0f;
+        }
+
+        Vector e = extent();
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
+    int longest_axis() const
+    {
+        Vector e = extent();
+        if (e.x > e.y && e.x > e.z)
+        {
+            return 0;
+        }
+        return e.y > e.z ? 1 : 2;
+    }
+
+    // 1 / d for the slab test. A zero component (an axis-aligned shadow or
+    // bounce ray) maps to the largest float of the same sign rather than to
+    // infinity, so that an origin lying on a slab plane gives 0 instead of
+    // 0 * inf = NaN.
+    static float inverse(float d)
+    {
+        return d != 0.0f ? 1.0f / d : std::copysign(std::numeric_limits<float>::max(), d);
+    }
+
+    static Vector inverse(const Vector& direction)
+    {
+        return Vector { inverse(direction.x), inverse(direction.y), inverse(direction.z) };
+    }
+
+    // Slab distances are off by up to three roundings (the difference, the
+    // reciprocal and the product), so the far ones are widened by this factor,
+    // just above 1 + 2 gamma(3): a ray grazing a box still enters it and finds
+    // the triangles lying on its faces, which the watertight triangle test
+    // counts on (Ize, Robust BVH Ray Traversal, 2013).
+    static constexpr float far_scale = 1.0f + 4.0f * std::numeric_limits<float>::epsilon();
+
+    // Slab test. inv_direction holds 1 / ray.direction per component; on a hit,
+    // t_entry receives the distance at which the ray enters the box (clamped to 0).
+    bool intersect(const Point& origin, const Vector& inv_direction, float t_max, float& t_entry) const
+    {
+        float t0 = 0.0f;
+        float t1 = t_max;
+
+        for (size_t axis = 0; axis < 3; ++axis)
+        {
+            float near = (min[axis] - origin[axis]) * inv_direction[axis];
+            float far = (max[axis] - origin[axis]) * inv_direction[axis];
+
+            if (near > far)
+            {
+                std::swap(near, far);
+            }
+            far *= far_scale;
+
+            t0 = near > t0 ? near : t0;
+            t1 = far < t1 ? far : t1;
+
+            if (t0 > t1)
+            {
+                return false;
+            }
+        }
+
+        t_entry = t0;
+        return true;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const AABB& b)
+{
+    os << "AABB(" << b.min << ", " << b.max << ")";
+    return os;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "point.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "vector.h"
+
+// A variable number of rays in structure-of-arrays layout, e.g. a whole tile
+// of primary rays. Like RayPacket, ray i is element i of every array; the
+// arrays are padded to a multiple of 8 so packets can be loaded from any
+// multiple of 8 without reading past the end.
+class RayBuffer
+{
+private:
+    size_t count {};
+
+public:
+    std::vector<float> ox {}, oy {}, oz {};
+    std::vector<float> dx {}, dy {}, dz {};
+
+    RayBuffer() = default;
+    RayBuffer(const RayBuffer&) = default;
+    ~RayBuffer() = default;
+    RayBuffer& operator=(const RayBuffer&) = default;
+
+    size_t size() const { return count; }
+
+    // Keeps the allocation when shrinking, so a buffer reused tile after
+    // tile only allocates for the largest one.
+    void resize(size_t rays)
+    {
+        count = rays;
+        const size_t padded = (rays + 7) / 8 * 8;
+        for (std::vector<float>* array : { &ox, &oy, &oz, &dx, &dy, &dz })
+        {
+            array->resize(padded, 0.0f);
+        }
+    }
+
+    void set(size_t i, const Ray& ray)
+    {
+        assert(i < count);
+        ox[i] = ray.origin.x;
+        oy[i] = ray.origin.y;
+        oz[i] = ray.origin.z;
+        dx[i] = ray.direction.x;
+        dy[i] = ray.direction.y;
+        dz[i] = ray.direction.z;
+    }
+
+    Ray get(size_t i) const
+    {
+        assert(i < count);
+        return Ray { Point { ox[i], oy[i], oz[i] }, Vector { dx[i], dy[i], dz[i] } };
+    }
+
+    // Copies rays first .. first + N - 1 into a packet.
+    template <size_t N>
+    void load(size_t first, RayPacket<N>& packet) const
+    {
+        assert(first + N <= ox.size());
+        for (size_t lane = 0; lane < N; ++lane)
+        {
+            packet.ox[lane] = ox[first + lane];
+            packet.oy[lane] = oy[first + lane];
+            packet.oz[lane] = oz[first + lane];
+            packet.dx[lane] = dx[first + lane];
+            packet.dy[lane] = dy[first + lane];
+            packet.dz[lane] = dz[first + lane];
+        }
+    }
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include "point.h"
+#include "ray.h"
+#include "vector.h"
+
+// N rays in structure-of-arrays layout, lane i being ray i, so that packet
+// kernels can load each coordinate of all rays with one instruction.
+template <size_t N>
+struct RayPacket
+{
+    static constexpr size_t size = N;
+    static constexpr uint32_t all_lanes = (N >= 32) ? ~0u : ((1u << N) - 1u);
+
+    alignas(32) float ox[N] {};
+    alignas(32) float oy[N] {};
+    alignas(32) float oz[N] {};
+    alignas(32) float dx[N] {};
+    alignas(32) float dy[N] {};
+    alignas(32) float dz[N] {};
+
+    void set(size_t lane, const Ray& ray)
+    {
+        assert(lane < N);
+        ox[lane] = ray.origin.x;
+        oy[lane] = ray.origin.y;
+        oz[lane] = ray.origin.z;
+        dx[lane] = ray.direction.x;
+        dy[lane] = ray.direction.y;
+        dz[lane] = ray.direction.z;
+    }
+
+    Ray get(size_t lane) const
+    {
+        assert(lane < N);
+        return Ray { Point { ox[lane], oy[lane], oz[lane] }, Vector { dx[lane], dy[lane], dz[lane] } };
+    }
+};
+
+using RayPacket4 = RayPacket<4>;
+using RayPacket8 = RayPacket<8>;
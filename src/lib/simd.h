@@ -0,0 +1,287 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Instruction sets the wrappers below use: those the compiler targets,
+// unless the including file has set them itself. A file compiled for more
+// than the build's instruction set with #pragma GCC target (the kernel
+// variants of src/kernels) has to, because g++ does not update __AVX2__
+// and the like after the pragma. That file also sets SIMD_TARGET, the
+// namespace that keeps its wrappers apart from those of the rest of the
+// program at link time.
+#ifndef SIMD_SSE2
+#if defined(__SSE2__)
+#define SIMD_SSE2 1
+#else
+#define SIMD_SSE2 0
+#endif
+#endif
+#ifndef SIMD_SSE41
+#if defined(__SSE4_1__)
+#define SIMD_SSE41 1
+#else
+#define SIMD_SSE41 0
+#endif
+#endif
+#ifndef SIMD_AVX
+#if defined(__AVX__)
+#define SIMD_AVX 1
+#else
+#define SIMD_AVX 0
+#endif
+#endif
+#ifndef SIMD_AVX2
+#if defined(__AVX2__)
+#define SIMD_AVX2 1
+#else
+#define SIMD_AVX2 0
+#endif
+#endif
+#ifndef SIMD_TARGET
+#define SIMD_TARGET build
+#endif
+
+#if SIMD_SSE2
+#include <immintrin.h>
+#endif
+
+// Empty asm the compiler cannot see through, keeping a value in a register
+// (or in memory where floats have no register class it can name).
+#if defined(__GNUC__) && SIMD_SSE2
+#define SIMD_ROUNDED(value) __asm__("" : "+x"(value))
+#elif defined(__GNUC__)
+#define SIMD_ROUNDED(value) __asm__("" : "+m"(value))
+#else
+#define SIMD_ROUNDED(value) ((void)0)
+#endif
+
+// Thin wrappers over 4- and 8-wide float registers so that the packet kernels
+// are written once. Comparisons return a lane mask of the same type (all bits
+// set where true); movemask() packs it into the low bits of an integer.
+// Without AVX a float8 is two float4 halves; without SSE both fall back to
+// plain arrays.
+namespace SIMD
+{
+inline namespace SIMD_TARGET
+{
+    // a, as already rounded. The compiler is free to fuse a product into the
+    // sum or difference that uses it (one FMA, one rounding instead of two),
+    // and not always on the same side of a - b; passing the products through
+    // rounded() makes x * y - z * w exactly -(z * w - x * y), which the
+    // watertight triangle test relies on.
+    inline float rounded(float a) { SIMD_ROUNDED(a); return a; }
+
+#if SIMD_SSE2
+    struct float4
+    {
+        static constexpr int width = 4;
+        __m128 v;
+
+        float4() = default;
+        float4(__m128 v) : v { v } {}
+        explicit float4(float s) : v { _mm_set1_ps(s) } {}
+
+        static float4 load(const float* p) { return _mm_load_ps(p); }
+        static float4 loadu(const float* p) { return _mm_loadu_ps(p); }
+        void store(float* p) const { _mm_store_ps(p, v); }
+        void storeu(float* p) const { _mm_storeu_ps(p, v); }
+        static float4 iota(float base) { return _mm_add_ps(_mm_set1_ps(base), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f)); }
+
+        // Four unsigned integers converted to floats.
+        static float4 convert(const uint8_t* p)
+        {
+            int32_t bits;
+            std::memcpy(&bits, p, sizeof(bits));
+#if SIMD_SSE41
+            return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bits)));
+#else
+            const __m128i zero = _mm_setzero_si128();
+            return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bits), zero), zero));
+#endif
+        }
+        static float4 convert(const uint16_t* p)
+        {
+            const __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+#if SIMD_SSE41
+            return _mm_cvtepi32_ps(_mm_cvtepu16_epi32(x));
+#else
+            return _mm_cvtepi32_ps(_mm_unpacklo_epi16(x, _mm_setzero_si128()));
+#endif
+        }
+
+        // The four lanes, which must lie in [0, 256), truncated to bytes.
+        void store_bytes(uint8_t* p) const
+        {
+            const __m128i x = _mm_cvttps_epi32(v);
+            const int32_t bits = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(x, x), x));
+            std::memcpy(p, &bits, sizeof(bits));
+        }
+    };
+
+    inline float4 operator+(float4 a, float4 b) { return _mm_add_ps(a.v, b.v); }
+    inline float4 operator-(float4 a, float4 b) { return _mm_sub_ps(a.v, b.v); }
+    inline float4 operator*(float4 a, float4 b) { return _mm_mul_ps(a.v, b.v); }
+    inline float4 operator/(float4 a, float4 b) { return _mm_div_ps(a.v, b.v); }
+    inline float4 operator-(float4 a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+    inline float4 operator<(float4 a, float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+    inline float4 operator<=(float4 a, float4 b) { return _mm_cmple_ps(a.v, b.v); }
+    inline float4 operator>(float4 a, float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+    inline float4 operator>=(float4 a, float4 b) { return _mm_cmpge_ps(a.v, b.v); }
+    inline float4 operator&(float4 a, float4 b) { return _mm_and_ps(a.v, b.v); }
+    inline float4 operator|(float4 a, float4 b) { return _mm_or_ps(a.v, b.v); }
+    inline float4 sqrt(float4 a) { return _mm_sqrt_ps(a.v); }
+    inline float4 min(float4 a, float4 b) { return _mm_min_ps(a.v, b.v); }
+    inline float4 max(float4 a, float4 b) { return _mm_max_ps(a.v, b.v); }
+    inline float4 abs(float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+#if SIMD_SSE41
+    inline float4 select(float4 mask, float4 a, float4 b) { return _mm_blendv_ps(b.v, a.v, mask.v); }
+#else
+    inline float4 select(float4 mask, float4 a, float4 b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+#endif
+    inline uint32_t movemask(float4 mask) { return static_cast<uint32_t>(_mm_movemask_ps(mask.v)); }
+    inline float4 rounded(float4 a) { SIMD_ROUNDED(a.v); return a; }
+#else
+    struct float4
+    {
+        static constexpr int width = 4;
+        float v[4];
+
+        float4() = default;
+        explicit float4(float s) : v { s, s, s, s } {}
+
+        static float4 load(const float* p) { float4 r; std::memcpy(r.v, p, sizeof(r.v)); return r; }
+        static float4 loadu(const float* p) { return load(p); }
+        void store(float* p) const { std::memcpy(p, v, sizeof(v)); }
+        void storeu(float* p) const { store(p); }
+        static float4 iota(float base) { float4 r; for (int i = 0; i < 4; ++i) r.v[i] = base + i; return r; }
+        static float4 convert(const uint8_t* p) { float4 r; for (int i = 0; i < 4; ++i) r.v[i] = p[i]; return r; }
+        static float4 convert(const uint16_t* p) { float4 r; for (int i = 0; i < 4; ++i) r.v[i] = p[i]; return r; }
+        void store_bytes(uint8_t* p) const { for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(v[i]); }
+    };
+
+    namespace detail
+    {
+        inline float mask_bits(bool b) { uint32_t bits = b ? ~0u : 0u; float f; std::memcpy(&f, &bits, sizeof(f)); return f; }
+        inline uint32_t bits_of(float f) { uint32_t bits; std::memcpy(&bits, &f, sizeof(bits)); return bits; }
+
+        template <typename Op>
+        float4 lanes(float4 a, float4 b, Op op) { float4 r; for (int i = 0; i < 4; ++i) r.v[i] = op(a.v[i], b.v[i]); return r; }
+        template <typename Op>
+        float4 compare(float4 a, float4 b, Op op) { float4 r; for (int i = 0; i < 4; ++i) r.v[i] = mask_bits(op(a.v[i], b.v[i])); return r; }
+    }
+
+    inline float4 operator+(float4 a, float4 b) { return detail::lanes(a, b, [](float x, float y) { return x + y; }); }
+    inline float4 operator-(float4 a, float4 b) { return detail::lanes(a, b, [](float x, float y) { return x - y; }); }
+    inline float4 operator*(float4 a, float4 b) { return detail::lanes(a, b, [](float x, float y) { return x * y; }); }
+    inline float4 operator/(float4 a, float4 b) { return detail::lanes(a, b, [](float x, float y) { return x / y; }); }
+    inline float4 operator-(float4 a) { return float4 { 0.0f } - a; }
+    inline float4 operator<(float4 a, float4 b) { return detail::compare(a, b, [](float x, float y) { return x < y; }); }
+    inline float4 operator<=(float4 a, float4 b) { return detail::compare(a, b, [](float x, float y) { return x <= y; }); }
+    inline float4 operator>(float4 a, float4 b) { return detail::compare(a, b, [](float x, float y) { return x > y; }); }
+    inline float4 operator>=(float4 a, float4 b) { return detail::compare(a, b, [](float x, float y) { return x >= y; }); }
+    inline float4 operator&(float4 a, float4 b) { return detail::compare(a, b, [](float x, float y) { return (detail::bits_of(x) & detail::bits_of(y)) != 0; }); }
+    inline float4 operator|(float4 a, float4 b) { return detail::compare(a, b, [](float x, float y) { return (detail::bits_of(x) | detail::bits_of(y)) != 0; }); }
+    inline float4 sqrt(float4 a) { float4 r; for (int i = 0; i < 4; ++i) r.v[i] = std::sqrt(a.v[i]); return r; }
+    inline float4 min(float4 a, float4 b) { return detail::lanes(a, b, [](float x, float y) { return y < x ? y : x; }); }
+    inline float4 max(float4 a, float4 b) { return detail::lanes(a, b, [](float x, float y) { return x < y ? y : x; }); }
+    inline float4 abs(float4 a) { float4 r; for (int i = 0; i < 4; ++i) r.v[i] = std::abs(a.v[i]); return r; }
+    inline float4 select(float4 mask, float4 a, float4 b) { float4 r; for (int i = 0; i < 4; ++i) r.v[i] = detail::bits_of(mask.v[i]) ? a.v[i] : b.v[i]; return r; }
+    inline uint32_t movemask(float4 mask) { uint32_t m = 0; for (int i = 0; i < 4; ++i) m |= (detail::bits_of(mask.v[i]) ? 1u : 0u) << i; return m; }
+    inline float4 rounded(float4 a) { for (int i = 0; i < 4; ++i) a.v[i] = rounded(a.v[i]); return a; }
+#endif
+
+#if SIMD_AVX
+    struct float8
+    {
+        static constexpr int width = 8;
+        __m256 v;
+
+        float8() = default;
+        float8(__m256 v) : v { v } {}
+        explicit float8(float s) : v { _mm256_set1_ps(s) } {}
+
+        static float8 load(const float* p) { return _mm256_load_ps(p); }
+        static float8 loadu(const float* p) { return _mm256_loadu_ps(p); }
+        void store(float* p) const { _mm256_store_ps(p, v); }
+        void storeu(float* p) const { _mm256_storeu_ps(p, v); }
+        static float8 iota(float base) { return _mm256_add_ps(_mm256_set1_ps(base), _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f)); }
+
+        // Eight unsigned integers converted to floats.
+#if SIMD_AVX2
+        static float8 convert(const uint8_t* p) { return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)))); }
+        static float8 convert(const uint16_t* p) { return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))); }
+#else
+        static float8 convert(const uint8_t* p) { return _mm256_set_m128(float4::convert(p + 4).v, float4::convert(p).v); }
+        static float8 convert(const uint16_t* p) { return _mm256_set_m128(float4::convert(p + 4).v, float4::convert(p).v); }
+#endif
+
+        // The eight lanes, which must lie in [0, 256), truncated to bytes.
+        void store_bytes(uint8_t* p) const
+        {
+            const __m256i x = _mm256_cvttps_epi32(v);
+            const __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(x), _mm256_extractf128_si256(x, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(words, words));
+        }
+    };
+
+    inline float8 operator+(float8 a, float8 b) { return _mm256_add_ps(a.v, b.v); }
+    inline float8 operator-(float8 a, float8 b) { return _mm256_sub_ps(a.v, b.v); }
+    inline float8 operator*(float8 a, float8 b) { return _mm256_mul_ps(a.v, b.v); }
+    inline float8 operator/(float8 a, float8 b) { return _mm256_div_ps(a.v, b.v); }
+    inline float8 operator-(float8 a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+    inline float8 operator<(float8 a, float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+    inline float8 operator<=(float8 a, float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+    inline float8 operator>(float8 a, float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+    inline float8 operator>=(float8 a, float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+    inline float8 operator&(float8 a, float8 b) { return _mm256_and_ps(a.v, b.v); }
+    inline float8 operator|(float8 a, float8 b) { return _mm256_or_ps(a.v, b.v); }
+    inline float8 sqrt(float8 a) { return _mm256_sqrt_ps(a.v); }
+    inline float8 min(float8 a, float8 b) { return _mm256_min_ps(a.v, b.v); }
+    inline float8 max(float8 a, float8 b) { return _mm256_max_ps(a.v, b.v); }
+    inline float8 abs(float8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+    inline float8 select(float8 mask, float8 a, float8 b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+    inline uint32_t movemask(float8 mask) { return static_cast<uint32_t>(_mm256_movemask_ps(mask.v)); }
+    inline float8 rounded(float8 a) { SIMD_ROUNDED(a.v); return a; }
+#else
+    struct float8
+    {
+        static constexpr int width = 8;
+        float4 lo, hi;
+
+        float8() = default;
+        float8(float4 lo, float4 hi) : lo { lo }, hi { hi } {}
+        explicit float8(float s) : lo { s }, hi { s } {}
+
+        static float8 load(const float* p) { return float8 { float4::load(p), float4::load(p + 4) }; }
+        static float8 loadu(const float* p) { return float8 { float4::loadu(p), float4::loadu(p + 4) }; }
+        void store(float* p) const { lo.store(p); hi.store(p + 4); }
+        void storeu(float* p) const { lo.storeu(p); hi.storeu(p + 4); }
+        static float8 iota(float base) { return float8 { float4::iota(base), float4::iota(base + 4.0f) }; }
+        static float8 convert(const uint8_t* p) { return float8 { float4::convert(p), float4::convert(p + 4) }; }
+        static float8 convert(const uint16_t* p) { return float8 { float4::convert(p), float4::convert(p + 4) }; }
+        void store_bytes(uint8_t* p) const { lo.store_bytes(p); hi.store_bytes(p + 4); }
+    };
+
+    inline float8 operator+(float8 a, float8 b) { return float8 { a.lo + b.lo, a.hi + b.hi }; }
+    inline float8 operator-(float8 a, float8 b) { return float8 { a.lo - b.lo, a.hi - b.hi }; }
+    inline float8 operator*(float8 a, float8 b) { return float8 { a.lo * b.lo, a.hi * b.hi }; }
+    inline float8 operator/(float8 a, float8 b) { return float8 { a.lo / b.lo, a.hi / b.hi }; }
+    inline float8 operator-(float8 a) { return float8 { -a.lo, -a.hi }; }
+    inline float8 operator<(float8 a, float8 b) { return float8 { a.lo < b.lo, a.hi < b.hi }; }
+    inline float8 operator<=(float8 a, float8 b) { return float8 { a.lo <= b.lo, a.hi <= b.hi }; }
+    inline float8 operator>(float8 a, float8 b) { return float8 { a.lo > b.lo, a.hi > b.hi }; }
+    inline float8 operator>=(float8 a, float8 b) { return float8 { a.lo >= b.lo, a.hi >= b.hi }; }
+    inline float8 operator&(float8 a, float8 b) { return float8 { a.lo & b.lo, a.hi & b.hi }; }
+    inline float8 operator|(float8 a, float8 b) { return float8 { a.lo | b.lo, a.hi | b.hi }; }
+    inline float8 sqrt(float8 a) { return float8 { sqrt(a.lo), sqrt(a.hi) }; }
+    inline float8 min(float8 a, float8 b) { return float8 { min(a.lo, b.lo), min(a.hi, b.hi) }; }
+    inline float8 max(float8 a, float8 b) { return float8 { max(a.lo, b.lo), max(a.hi, b.hi) }; }
+    inline float8 abs(float8 a) { return float8 { abs(a.lo), abs(a.hi) }; }
+    inline float8 select(float8 mask, float8 a, float8 b) { return float8 { select(mask.lo, a.lo, b.lo), select(mask.hi, a.hi, b.hi) }; }
+    inline uint32_t movemask(float8 mask) { return movemask(mask.lo) | (movemask(mask.hi) << 4); }
+    inline float8 rounded(float8 a) { return float8 { rounded(a.lo), rounded(a.hi) }; }
+#endif
+}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+// Non-owning view of a contiguous array (std::span is C++20). The viewed
+// storage must outlive the span.
+template <typename T>
+class Span
+{
+private:
+    T* first { nullptr };
+    size_t count {};
+
+public:
+    Span() = default;
+    Span(T* data, size_t size) : first { data }, count { size } {}
+
+    template <typename U>
+    Span(const std::vector<U>& items) : first { items.data() }, count { items.size() } {}
+
+    template <typename U>
+    Span(std::vector<U>& items) : first { items.data() }, count { items.size() } {}
+
+    Span(const Span&) = default;
+    ~Span() = default;
+    Span& operator=(const Span&) = default;
+
+    T* data() const { return first; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    T* begin() const { return first; }
+    T* end() const { return first + count; }
+
+    T& operator[](size_t idx) const
+    {
+        assert(idx < count);
+        return first[idx];
+    }
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include "aabb.h"
+#include "point.h"
+#include "ray.h"
+#include "vector.h"
+
+// Affine transform: a 3x3 linear part in the first three columns of m and a
+// translation in the last. Points get the translation, vectors do not.
+struct Transform
+{
+    float m[3][4] { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f } };
+
+    Transform() = default;
+    Transform(const Transform&) = default;
+    ~Transform() = default;
+    Transform& operator=(const Transform&) = default;
+
+    static Transform translation(const Vector& offset)
+    {
+        Transform t {};
+        t.m[0][3] = offset.x;
+        t.m[1][3] = offset.y;
+        t.m[2][3] = offset.z;
+        return t;
+    }
+
+    static Transform scaling(const Vector& factors)
+    {
+        Transform t {};
+        t.m[0][0] = factors.x;
+        t.m[1][1] = factors.y;
+        t.m[2][2] = factors.z;
+        return t;
+    }
+
+    // Counterclockwise rotation by degrees around axis (any length but zero),
+    // looking down the axis toward the origin.
+    static Transform rotation(const Vector& axis, float degrees)
+    {
+        constexpr float pi = 3.14159265358979f;
+        const Vector a = axis.normalized();
+        const float radians = degrees * pi / 180.0f;
+        const float c = std::cos(radians), s = std::sin(radians), k = 1.0f - c;
+
+        Transform t {};
+        t.m[0][0] = c + a.x * a.x * k;
+        t.m[0][1] = a.x * a.y * k - a.z * s;
+        t.m[0][2] = a.x * a.z * k + a.y * s;
+        t.m[1][0] = a.y * a.x * k + a.z * s;
+        t.m[1][1] = c + a.y * a.y * k;
+        t.m[1][2] = a.y * a.z * k - a.x * s;
+        t.m[2][0] = a.z * a.x * k - a.y * s;
+        t.m[2][1] = a.z * a.y * k + a.x * s;
+        t.m[2][2] = c + a.z * a.z * k;
+        return t;
+    }
+
+    // this after t: (a * b).apply(p) == a.apply(b.apply(p)).
+    Transform operator*(const Transform& t) const
+    {
+        Transform r {};
+        for (size_t i = 0; i < 3; ++i)
+        {
+            for (size_t j = 0; j < 4; ++j)
+            {
+                r.m[i][j] = m[i][0] * t.m[0][j] + m[i][1] * t.m[1][j] + m[i][2] * t.m[2][j] + (j == 3 ? m[i][3] : 0.0f);
+            }
+        }
+        return r;
+    }
+
+    Point apply(const Point& p) const
+    {
+        return Point { m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+                       m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+                       m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3] };
+    }
+
+    Vector apply(const Vector& v) const
+    {
+        return Vector { m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+                        m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+                        m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z };
+    }
+
+    // The direction is not renormalized, so a distance t along the result
+    // reaches the image of the point at t along the original ray.
+    Ray apply(const Ray& ray) const
+    {
+        return Ray { apply(ray.origin), apply(ray.direction) };
+    }
+
+    // Linear part transposed. Normals follow the inverse transpose, so the
+    // inverse of a transform maps normals back with this (then normalize).
+    Vector apply_transposed(const Vector& v) const
+    {
+        return Vector { m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z,
+                        m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z,
+                        m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z };
+    }
+
+    // Smallest box holding the transformed box (Arvo's method).
+    AABB apply(const AABB& box) const
+    {
+        if (box.empty())
+        {
+            return box;
+        }
+
+        AABB r { Point { m[0][3], m[1][3], m[2][3] }, Point { m[0][3], m[1][3], m[2][3] } };
+        for (size_t i = 0; i < 3; ++i)
+        {
+            for (size_t j = 0; j < 3; ++j)
+            {
+                const float a = m[i][j] * box.min[j];
+                const float b = m[i][j] * box.max[j];
+                r.min[i] += std::min(a, b);
+                r.max[i] += std::max(a, b);
+            }
+        }
+        return r;
+    }
+
+    float determinant() const
+    {
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+               m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+               m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    }
+
+    // Only valid when determinant() != 0.
+    Transform inverse() const
+    {
+        const float d = 1.0f / determinant();
+
+        Transform r {};
+        r.m[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * d;
+        r.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * d;
+        r.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * d;
+        r.m[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * d;
+        r.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * d;
+        r.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * d;
+        r.m[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * d;
+        r.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * d;
+        r.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * d;
+
+        const Vector t = r.apply(Vector { m[0][3], m[1][3], m[2][3] });
+        r.m[0][3] = -t.x;
+        r.m[1][3] = -t.y;
+        r.m[2][3] = -t.z;
+        return r;
+    }
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include "../kernels/kernels.h"
+#include "../lib/vector.h"
+
+namespace RT
+{
+    // Rectangle of pixels [x0, x1) x [y0, y1) rendered as one unit of work.
+    struct Tile
+    {
+        uint32_t x0 {}, y0 {};
+        uint32_t x1 {}, y1 {};
+    };
+
+    // Row-major float RGB image, row 0 at the top, plus its packed RGB8 copy
+    // for output. Both are flat arrays of three channels per pixel, so a run
+    // of pixels is converted as one array of floats. Tiles never overlap, so
+    // render threads write into both concurrently without any locking.
+    class Framebuffer
+    {
+    private:
+        uint32_t width {}, height {};
+        std::vector<float> pixels {};
+        std::vector<uint8_t> bytes {};
+
+    public:
+        explicit Framebuffer(uint32_t width, uint32_t height)
+            : width { width }, height { height }, pixels(3 * static_cast<size_t>(width) * height),
+              bytes(3 * static_cast<size_t>(width) * height) {}
+
+        Framebuffer() = default;
+        Framebuffer(const Framebuffer&) = default;
+        ~Framebuffer() = default;
+        Framebuffer& operator=(const Framebuffer&) = default;
+
+        uint32_t get_width() const { return width; }
+        uint32_t get_height() const { return height; }
+
+        void set(uint32_t x, uint32_t y, const Vector& color)
+        {
+            assert(x < width && y < height);
+            float* pixel = &pixels[3 * (static_cast<size_t>(y) * width + x)];
+            pixel[0] = color.x;
+            pixel[1] = color.y;
+            pixel[2] = color.z;
+        }
+
+        Vector get(uint32_t x, uint32_t y) const
+        {
+            assert(x < width && y < height);
+            const float* pixel = &pixels[3 * (static_cast<size_t>(y) * width + x)];
+            return Vector { pixel[0], pixel[1], pixel[2] };
+        }
+
+        // Converts the tile's float pixels to clamped RGB8.
+        void resolve(const Tile& tile)
+        {
+            for (uint32_t y = tile.y0; y < tile.y1; ++y)
+            {
+                const size_t first = 3 * (static_cast<size_t>(y) * width + tile.x0);
+                Kernels::active().colors_to_bytes(&pixels[first], 3 * static_cast<size_t>(tile.x1 - tile.x0),
+                                                  &bytes[first]);
+            }
+        }
+
+        const uint8_t* row_bytes(uint32_t y) const
+        {
+            assert(y < height);
+            return &bytes[3 * static_cast<size_t>(y) * width];
+        }
+
+        // Splits the image into tile_size x tile_size tiles in scanline order;
+        // tiles on the right and bottom edges are clipped.
+        std::vector<Tile> make_tiles(uint32_t tile_size) const
+        {
+            std::vector<Tile> tiles;
+            for (uint32_t y = 0; y < height; y += tile_size)
+            {
+                for (uint32_t x = 0; x < width; x += tile_size)
+                {
+                    tiles.push_back(Tile { x, y, std::min(x + tile_size, width), std::min(y + tile_size, height) });
+                }
+            }
+            return tiles;
+        }
+    };
+}
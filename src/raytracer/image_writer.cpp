@@ -0,0 +1,141 @@
+#include <charconv>
+#include <vector>
+#include "image_writer.h"
+
+namespace RT
+{
+    ImageWriter::ImageWriter(const std::string& filename, const Framebuffer& framebuffer, ImageFormat format)
+        : framebuffer { framebuffer }, format { format }
+    {
+        const uint32_t width = framebuffer.get_width();
+        const uint32_t height = framebuffer.get_height();
+
+        file = std::fopen(filename.c_str(), "wb");
+        if (!file)
+        {
+            return;
+        }
+
+        remaining = std::make_unique<std::atomic<uint32_t>[]>(height);
+        for (uint32_t row = 0; row < height; ++row)
+        {
+            remaining[row].store(width, std::memory_order_relaxed);
+        }
+
+        std::string header = (format == ImageFormat::P6 ? "P6\n" : "P3\n") + std::to_string(width) + " " +
+                             std::to_string(height) + "\n255\n";
+        failed = std::fwrite(header.data(), 1, header.size(), file) != header.size();
+
+        writer = std::thread { [this] { writer_loop(); } };
+    }
+
+    ImageWriter::~ImageWriter()
+    {
+        {
+            std::lock_guard<std::mutex> guard { lock };
+            aborted = true;
+        }
+        row_ready.notify_one();
+
+        if (writer.joinable() || file)
+        {
+            finish();
+        }
+    }
+
+    void ImageWriter::tile_done(const Tile& tile)
+    {
+        if (!file)
+        {
+            return;
+        }
+
+        bool completed_row { false };
+        for (uint32_t row = tile.y0; row < tile.y1; ++row)
+        {
+            const uint32_t columns = tile.x1 - tile.x0;
+            if (remaining[row].fetch_sub(columns, std::memory_order_acq_rel) == columns)
+            {
+                completed_row = true;
+            }
+        }
+
+        if (completed_row)
+        {
+            std::lock_guard<std::mutex> guard { lock };
+            row_ready.notify_one();
+        }
+    }
+
+    void ImageWriter::write_rows(uint32_t first, uint32_t last)
+    {
+        const uint32_t width = framebuffer.get_width();
+
+        if (format == ImageFormat::P6)
+        {
+            // Rows are contiguous in the framebuffer, so the whole run is one write.
+            const size_t size = 3 * static_cast<size_t>(width) * (last - first);
+            failed |= std::fwrite(framebuffer.row_bytes(first), 1, size, file) != size;
+            return;
+        }
+
+        // Worst case "255 255 255\n" per pixel.
+        std::vector<char> text(12 * static_cast<size_t>(width) * (last - first));
+        char* out = text.data();
+        for (uint32_t row = first; row < last; ++row)
+        {
+            const uint8_t* bytes = framebuffer.row_bytes(row);
+            for (size_t i = 0; i < 3 * static_cast<size_t>(width); ++i)
+            {
+                out = std::to_chars(out, text.data() + text.size(), bytes[i]).ptr;
+                *out++ = (i % 3 == 2) ? '\n' : ' ';
+            }
+        }
+
+        const size_t size = static_cast<size_t>(out - text.data());
+        failed |= std::fwrite(text.data(), 1, size, file) != size;
+    }
+
+    void ImageWriter::writer_loop()
+    {
+        const uint32_t height = framebuffer.get_height();
+        uint32_t next = 0;
+
+        while (next < height)
+        {
+            {
+                std::unique_lock<std::mutex> guard { lock };
+                row_ready.wait(guard, [&] { return ready(next) || aborted; });
+                if (!ready(next))
+                {
+                    return;
+                }
+            }
+
+            uint32_t last = next + 1;
+            while (last < height && ready(last))
+            {
+                last++;
+            }
+
+            write_rows(next, last);
+            next = last;
+        }
+    }
+
+    bool ImageWriter::finish()
+    {
+        if (writer.joinable())
+        {
+            writer.join();
+        }
+
+        if (file)
+        {
+            failed |= std::fclose(file) != 0;
+            file = nullptr;
+        }
+
+        return !failed;
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "framebuffer.h"
+
+namespace RT
+{
+    enum class ImageFormat
+    {
+        P6,  // binary PPM
+        P3,  // ASCII PPM
+    };
+
+    // Streams a framebuffer to a PPM file from a background thread. Render
+    // threads report finished tiles; every run of consecutive completed rows
+    // starting at the next unwritten one is emitted with a single write, so
+    // output overlaps with rendering of the remaining rows.
+    class ImageWriter
+    {
+    private:
+        const Framebuffer& framebuffer;
+        ImageFormat format;
+        std::FILE* file { nullptr };
+        bool failed { false };
+
+        // Pixels still missing in each row; a row is ready when it hits zero.
+        std::unique_ptr<std::atomic<uint32_t>[]> remaining {};
+
+        std::mutex lock {};
+        std::condition_variable row_ready {};
+        bool aborted { false };  // guarded by lock; the render stopped before every row was done
+        std::thread writer {};
+
+        bool ready(uint32_t row) const { return remaining[row].load(std::memory_order_acquire) == 0; }
+        void write_rows(uint32_t first, uint32_t last);
+        void writer_loop();
+
+    public:
+        explicit ImageWriter(const std::string& filename, const Framebuffer& framebuffer, ImageFormat format);
+
+        // Without finish(), e.g. when an exception ends the render early, stops
+        // the writer after the rows already completed instead of waiting for
+        // rows that will never come.
+        ~ImageWriter();
+
+        ImageWriter(const ImageWriter&) = delete;
+        ImageWriter& operator=(const ImageWriter&) = delete;
+
+        bool is_open() const { return file != nullptr; }
+
+        // Called once per tile after Framebuffer::resolve(tile).
+        void tile_done(const Tile& tile);
+
+        // Waits until every row is on disk and closes the file. Returns false
+        // if any write failed.
+        bool finish();
+    };
+}
@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include "integrator.h"
+
+namespace RT
+{
+    namespace
+    {
+        // Secondary rays start this far off the surface so they do not hit it again
+        constexpr float ray_epsilon = 1e-4f;
+
+        float max_component(const Vector& v)
+        {
+            return std::max(std::max(v.x, v.y), v.z);
+        }
+
+        Vector reflect(const Vector& direction, const Vector& normal)
+        {
+            return direction - 2.0f * dot(direction, normal) * normal;
+        }
+    }
+
+    Integrator::Integrator(const Scene& scene, const IntegratorSettings& settings)
+        : scene { scene }, settings { settings }
+    {
+        this->settings.max_depth = std::min(this->settings.max_depth, stack_size - 1);
+    }
+
+    Vector Integrator::background(const Ray& ray)
+    {
+        Vector unit_direction = ray.direction.normalized();
+        float t = 0.5f * (unit_direction.y + 1.0f);
+        return Vector(1.0f, 1.0f, 1.0f) * (1.0f - t) + Vector(0.5f, 0.7f, 1.0f) * t;
+    }
+
+    ShadingPoint Integrator::shading_point(const Ray& ray, const Trace& hit) const
+    {
+        const SurfaceInteraction surface = scene.interact(ray, hit);
+
+        ShadingPoint point {};
+        point.position = surface.position;
+        point.entering = dot(surface.normal, ray.direction) < 0.0f;
+        point.normal = point.entering ? surface.normal : -surface.normal;
+        point.material = &scene.get_material(surface.material);
+        return point;
+    }
+
+    Vector Integrator::emitted(const PathRay& ray, const ShadingPoint& point) const
+    {
+        const Material& material = *point.material;
+        if (settings.kind == IntegratorKind::Flat)
+        {
+            return ray.weight * material.color;
+        }
+
+        const float opacity = std::min(std::max(material.opacity, 0.0f), 1.0f);
+        return ray.weight * (material.emission + opacity * (scene.ambient * material.color));
+    }
+
+    // Lambert plus a Blinn-Phong highlight (Ks, Ns), on the opaque part of the surface.
+    bool Integrator::shadow_ray(const PathRay& ray, const ShadingPoint& point, uint32_t id, ShadowRay& shadow) const
+    {
+        if (settings.kind == IntegratorKind::Flat)
+        {
+            return false;
+        }
+
+        const Material& material = *point.material;
+        const Light& light = scene.get_light(id);
+        const Point origin = point.position + ray_epsilon * point.normal;
+        Vector to_light = light.position - origin;
+        const float distance_sqr = to_light.norm_sqr();
+        const float distance = std::sqrt(distance_sqr);
+        to_light /= distance;
+
+        const float cos_light = dot(point.normal, to_light);
+        if (cos_light <= 0.0f)
+        {
+            return false;
+        }
+
+        Vector reflected = cos_light * material.color;
+        if (material.shininess > 0.0f)
+        {
+            const float cos_half = std::max(dot(point.normal, (to_light - ray.ray.direction).normalized()), 0.0f);
+            reflected += std::pow(cos_half, material.shininess) * material.specular;
+        }
+
+        const float opacity = std::min(std::max(material.opacity, 0.0f), 1.0f);
+        shadow.ray = Ray { origin, to_light };
+        shadow.t_max = distance;
+        shadow.light = ray.weight * (opacity * (reflected * light.intensity / distance_sqr));
+        return true;
+    }
+
+    uint32_t Integrator::scatter(const PathRay& ray, const ShadingPoint& point, uint32_t seed, PathRay* children) const
+    {
+        if (settings.kind == IntegratorKind::Flat || ray.depth + 1 >= settings.max_depth)
+        {
+            return 0;
+        }
+
+        const Material& material = *point.material;
+        const Vector& direction = ray.ray.direction;
+        const Vector& normal = point.normal;
+        const float opacity = std::min(std::max(material.opacity, 0.0f), 1.0f);
+
+        // Mirror reflection scaled by Ks; the transparent part (1 - d) is split
+        // between reflection and refraction by Schlick's Fresnel approximation.
+        Vector reflect_weight = material.specular;
+        Vector refract_weight {};
+        Vector refracted {};
+
+        if (opacity < 1.0f)
+        {
+            const float eta = point.entering ? 1.0f / material.ior : material.ior;
+            const float cos_in = -dot(normal, direction);
+            const float sin_out_sqr = eta * eta * (1.0f - cos_in * cos_in);
+
+            if (sin_out_sqr >= 1.0f)
+            {
+                reflect_weight += Vector { 1.0f, 1.0f, 1.0f } * (1.0f - opacity);
+            }
+            else
+            {
+                const float cos_out = std::sqrt(1.0f - sin_out_sqr);
+                const float r0 = ((1.0f - material.ior) / (1.0f + material.ior)) *
+                                 ((1.0f - material.ior) / (1.0f + material.ior));
+                const float c = 1.0f - (point.entering ? cos_in : cos_out);
+                const float fresnel = r0 + (1.0f - r0) * c * c * c * c * c;
+
+                reflect_weight += Vector { 1.0f, 1.0f, 1.0f } * ((1.0f - opacity) * fresnel);
+                refract_weight = Vector { 1.0f, 1.0f, 1.0f } * ((1.0f - opacity) * (1.0f - fresnel));
+                refracted = (eta * direction + (eta * cos_in - cos_out) * normal).normalized();
+            }
+        }
+
+        uint32_t count = 0;
+        if (max_component(reflect_weight) > 0.0f)
+        {
+            children[count++] = PathRay { Ray { point.position + ray_epsilon * normal, reflect(direction, normal) },
+                                          ray.weight * reflect_weight, ray.depth + 1, 2 * ray.path };
+        }
+        if (max_component(refract_weight) > 0.0f)
+        {
+            children[count++] = PathRay { Ray { point.position - ray_epsilon * normal, refracted },
+                                          ray.weight * refract_weight, ray.depth + 1, 2 * ray.path + 1 };
+        }
+
+        Random random { hash_combine(seed, ray.path) };
+
+        // Past split_depth, follow one of the two, chosen in proportion to its weight
+        if (count == 2 && ray.depth >= settings.split_depth)
+        {
+            const float first_weight = max_component(children[0].weight);
+            const float pick = first_weight / (first_weight + max_component(children[1].weight));
+            const uint32_t chosen = random.next_float() < pick ? 0 : 1;
+            children[0] = children[chosen];
+            children[0].weight /= chosen == 0 ? pick : 1.0f - pick;
+            count = 1;
+        }
+
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            PathRay child = children[i];
+            if (child.depth >= settings.roulette_depth)
+            {
+                const float survival = std::min(max_component(child.weight), 1.0f);
+                if (random.next_float() >= survival)
+                {
+                    continue;
+                }
+                child.weight /= survival;
+            }
+            children[kept++] = child;
+        }
+        return kept;
+    }
+
+    Vector Integrator::radiance(const Ray& ray, const Trace& first_hit, uint32_t seed) const
+    {
+        PathRay stack[stack_size];
+        uint32_t stack_top = 0;
+        stack[stack_top++] = PathRay { ray, Vector { 1.0f, 1.0f, 1.0f }, 0, 1 };
+
+        Vector light_sum {};
+        bool first { true };
+
+        while (stack_top > 0)
+        {
+            const PathRay current = stack[--stack_top];
+            const Trace hit = first ? first_hit : scene.trace(current.ray);
+            first = false;
+
+            if (!hit.hit())
+            {
+                light_sum += current.weight * background(current.ray);
+                continue;
+            }
+
+            const ShadingPoint point = shading_point(current.ray, hit);
+            light_sum += emitted(current, point);
+
+            ShadowRay shadow {};
+            for (uint32_t id = 0; id < scene.light_count(); ++id)
+            {
+                if (shadow_ray(current, point, id, shadow) && !scene.occluded(shadow.ray, shadow.t_max))
+                {
+                    light_sum += shadow.light;
+                }
+            }
+
+            assert(stack_top + 2 <= stack_size);
+            stack_top += scatter(current, point, seed, stack + stack_top);
+        }
+
+        return light_sum;
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include "../lib/point.h"
+#include "../lib/ray.h"
+#include "../lib/vector.h"
+#include "../scene/scene.h"
+#include "sampler.h"
+#include "trace.h"
+
+namespace RT
+{
+    enum class IntegratorKind
+    {
+        Flat,     // material color of the first hit, no lighting
+        Whitted,  // direct light with shadows, mirror reflection, refraction and emission
+    };
+
+    struct IntegratorSettings
+    {
+        IntegratorKind kind { IntegratorKind::Whitted };
+        uint32_t max_depth { 8 };       // surfaces a camera ray may bounce off, at most stack_size - 1
+        uint32_t split_depth { 2 };     // below it a glass hit follows both reflection and refraction
+        uint32_t roulette_depth { 3 };  // from it on, weak rays are ended by Russian roulette
+    };
+
+    // A ray of a camera sample's path tree. path numbers the node: the camera
+    // ray is 1 and the reflected and refracted rays of node p are 2p and
+    // 2p + 1. The random choices made at a node depend only on the sample's
+    // seed and path, so any traversal order gives the same image.
+    struct PathRay
+    {
+        Ray ray {};
+        Vector weight {};  // fraction of this ray's light that reaches the camera
+        uint32_t depth {};
+        uint32_t path { 1 };
+    };
+
+    // Light that reaches the camera if nothing lies between ray.origin and t_max.
+    struct ShadowRay
+    {
+        Ray ray {};
+        float t_max {};
+        Vector light {};
+    };
+
+    // Surface seen by a path ray, with the normal turned toward the ray.
+    struct ShadingPoint
+    {
+        Point position {};
+        Vector normal {};
+        bool entering {};  // the ray hit the outside of the surface
+        const Material* material { nullptr };
+    };
+
+    // Turns a camera ray into the light arriving along it.
+    //
+    // Each hit splits into three parts, usable one ray at a time (radiance())
+    // or by a caller that runs whole batches of rays through each step:
+    // emitted() is the light known without tracing, shadow_ray() the light
+    // from each lamp pending a visibility test, and scatter() the reflected
+    // and refracted rays to follow.
+    //
+    // radiance() keeps the pending rays on a fixed-size stack instead of
+    // recursing. Every hit pushes at most two rays one level deeper, so
+    // depth-first order never holds more than max_depth + 1 of them. Past
+    // split_depth only one of the reflected and refracted rays is followed,
+    // picked at random by weight. Past roulette_depth a ray survives with
+    // probability equal to its weight. Both choices are unbiased: the
+    // survivor's weight is divided by its probability. The work per camera
+    // ray stays bounded even inside nested glass, where every hit would
+    // otherwise double it.
+    class Integrator
+    {
+    private:
+        const Scene& scene;
+        IntegratorSettings settings {};
+
+    public:
+        static constexpr uint32_t stack_size = 16;
+
+        explicit Integrator(const Scene& scene, const IntegratorSettings& settings);
+
+        Integrator(const Integrator&) = delete;
+        Integrator& operator=(const Integrator&) = delete;
+
+        const Scene& get_scene() const { return scene; }
+
+        // Sky gradient seen by rays that leave the scene.
+        static Vector background(const Ray& ray);
+
+        ShadingPoint shading_point(const Ray& ray, const Trace& hit) const;
+
+        // Light leaving the surface toward the ray that needs no further tests:
+        // emission and ambient light (or the plain color, for Flat), already
+        // multiplied by the ray's weight.
+        Vector emitted(const PathRay& ray, const ShadingPoint& point) const;
+
+        // Shadow ray toward light id. Returns false when the light cannot
+        // reach the surface anyway (it is behind it, or the integrator is Flat).
+        bool shadow_ray(const PathRay& ray, const ShadingPoint& point, uint32_t light, ShadowRay& shadow) const;
+
+        // Writes the rays to follow from the hit (at most two) to children
+        // and returns how many there are. seed is the camera sample's.
+        uint32_t scatter(const PathRay& ray, const ShadingPoint& point, uint32_t seed, PathRay* children) const;
+
+        // Light along a camera ray whose first hit is already known (e.g.
+        // from a packet trace). seed selects the sample's random choices
+        // (Russian roulette and branch picks); give every sample its own.
+        Vector radiance(const Ray& ray, const Trace& first_hit, uint32_t seed) const;
+
+        Vector radiance(const Ray& ray, uint32_t seed) const { return radiance(ray, scene.trace(ray), seed); }
+    };
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include "../lib/vector.h"
+
+namespace RT
+{
+    // Running mean and variance of a pixel's samples (Welford's update), so
+    // the renderer can tell how far the mean still is from converging
+    // without keeping the samples.
+    struct PixelEstimate
+    {
+        Vector mean {};
+        Vector m2 {};  // sum of squared deviations from the mean, per channel
+        uint32_t count {};
+
+        void add(const Vector& sample)
+        {
+            ++count;
+            Vector delta = sample - mean;
+            mean += delta / static_cast<float>(count);
+            m2 += delta * (sample - mean);
+        }
+
+        // Standard error of the mean of the noisiest channel; unknown (and
+        // so infinite) with fewer than two samples.
+        float error() const
+        {
+            if (count < 2)
+            {
+                return std::numeric_limits<float>::infinity();
+            }
+            const float variance = std::max(std::max(m2.x, m2.y), m2.z) / static_cast<float>(count - 1);
+            return std::sqrt(variance / static_cast<float>(count));
+        }
+    };
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+
+namespace RT
+{
+    // Well-mixed 32-bit hash (lowbias32), the building block of the
+    // counter-based generators below.
+    inline uint32_t hash(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    inline uint32_t hash_combine(uint32_t seed, uint32_t value)
+    {
+        return hash(seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2)));
+    }
+
+    // Maps the upper 24 bits to [0, 1).
+    inline float to_unit_float(uint32_t bits)
+    {
+        return static_cast<float>(bits >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Counter-based random numbers: the n-th value of a stream is a hash of
+    // (stream, n), so there is no shared state to contend on and a stream
+    // keyed by e.g. pixel and sample gives the same numbers whichever thread
+    // draws them.
+    class Random
+    {
+    private:
+        uint32_t stream {};
+        uint32_t counter {};
+
+    public:
+        explicit Random(uint32_t stream, uint32_t counter = 0) : stream { hash(stream) }, counter { counter } {}
+
+        Random() = default;
+        Random(const Random&) = default;
+        ~Random() = default;
+        Random& operator=(const Random&) = default;
+
+        uint32_t next_uint() { return hash_combine(stream, counter++); }
+        float next_float() { return to_unit_float(next_uint()); }
+    };
+
+    enum class SamplePattern
+    {
+        Sobol,   // Owen-scrambled Sobol points
+        Random,  // independent uniform points, for comparison
+    };
+
+    // Sub-pixel sample positions. Sample i of a pixel is a pure function of
+    // (seed, pixel, i): the image does not depend on how pixels are split
+    // between threads.
+    //
+    // The Sobol pattern uses the first two Sobol dimensions with hash-based
+    // Owen scrambling and index shuffling (Burley, "Practical Hash-based Owen
+    // Scrambling", 2020). Every pixel gets its own decorrelated scramble, and
+    // any prefix of 2^k samples is stratified like a (0, 2)-sequence, so the
+    // error falls faster than with independent random samples.
+    class Sampler
+    {
+    private:
+        SamplePattern pattern { SamplePattern::Sobol };
+        uint32_t seed {};
+
+        static uint32_t reverse_bits(uint32_t x)
+        {
+            x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+            x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+            x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+            x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+            return (x >> 16) | (x << 16);
+        }
+
+        // Random permutation of the bits that only lets higher bits affect
+        // lower ones (Laine-Karras); applied to the reversed value it
+        // becomes a nested uniform (Owen) scramble.
+        static uint32_t owen_scramble(uint32_t x, uint32_t seed)
+        {
+            x = reverse_bits(x);
+            x += seed;
+            x ^= x * 0x6c50b47cu;
+            x ^= x * 0xb82f1e52u;
+            x ^= x * 0xc7afe638u;
+            x ^= x * 0x8d22f6e6u;
+            return reverse_bits(x);
+        }
+
+        // Dimension 0 is the van der Corput sequence; dimension 1 is generated
+        // by the Pascal matrix, whose columns follow v ^= v >> 1.
+        static uint32_t sobol(uint32_t index, uint32_t dimension)
+        {
+            if (dimension == 0)
+            {
+                return reverse_bits(index);
+            }
+
+            uint32_t result = 0;
+            for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1)
+            {
+                if (index & 1u)
+                {
+                    result ^= v;
+                }
+            }
+            return result;
+        }
+
+    public:
+        explicit Sampler(SamplePattern pattern, uint32_t seed = 0) : pattern { pattern }, seed { seed } {}
+
+        Sampler() = default;
+        Sampler(const Sampler&) = default;
+        ~Sampler() = default;
+        Sampler& operator=(const Sampler&) = default;
+
+        // Position of a pixel's sample in [0, 1)^2.
+        void sample_2d(uint32_t pixel, uint32_t sample, float& x, float& y) const
+        {
+            const uint32_t pixel_seed = hash_combine(seed, pixel);
+
+            if (pattern == SamplePattern::Random)
+            {
+                Random random { pixel_seed, 2 * sample };
+                x = random.next_float();
+                y = random.next_float();
+                return;
+            }
+
+            const uint32_t index = owen_scramble(sample, pixel_seed);
+            x = to_unit_float(owen_scramble(sobol(index, 0), hash_combine(pixel_seed, 0)));
+            y = to_unit_float(owen_scramble(sobol(index, 1), hash_combine(pixel_seed, 1)));
+        }
+    };
+}
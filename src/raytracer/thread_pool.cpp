@@ -0,0 +1,134 @@
+#include <algorithm>
+#include "thread_pool.h"
+
+namespace RT
+{
+    ThreadPool::ThreadPool(unsigned threads)
+    {
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (unsigned i = 0; i < threads; ++i)
+        {
+            queues.push_back(std::make_unique<WorkQueue>());
+        }
+
+        // Worker 0 is whoever calls run().
+        for (unsigned i = 1; i < threads; ++i)
+        {
+            workers.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard { state_lock };
+            stopping = true;
+        }
+        work_ready.notify_all();
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    bool ThreadPool::pop(unsigned worker, size_t& item)
+    {
+        {
+            WorkQueue& own = *queues[worker];
+            std::lock_guard<std::mutex> guard { own.lock };
+            if (!own.items.empty())
+            {
+                item = own.items.front();
+                own.items.pop_front();
+                return true;
+            }
+        }
+
+        for (unsigned offset = 1; offset < queues.size(); ++offset)
+        {
+            WorkQueue& victim = *queues[(worker + offset) % queues.size()];
+            std::lock_guard<std::mutex> guard { victim.lock };
+            if (!victim.items.empty())
+            {
+                item = victim.items.back();
+                victim.items.pop_back();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void ThreadPool::drain(unsigned worker)
+    {
+        size_t item;
+        while (pop(worker, item))
+        {
+            (*job)(item, worker);
+
+            if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                std::lock_guard<std::mutex> guard { state_lock };
+                work_done.notify_all();
+            }
+        }
+    }
+
+    void ThreadPool::worker_loop(unsigned worker)
+    {
+        uint64_t seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> guard { state_lock };
+                work_ready.wait(guard, [&] { return stopping || generation != seen; });
+                if (stopping)
+                {
+                    return;
+                }
+                seen = generation;
+            }
+
+            drain(worker);
+        }
+    }
+
+    void ThreadPool::run(size_t count, const std::function<void(size_t, unsigned)>& job)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        this->job = &job;
+        pending.store(count, std::memory_order_release);
+
+        // Contiguous blocks keep neighbouring tiles on the same worker.
+        const size_t n = queues.size();
+        for (size_t w = 0; w < n; ++w)
+        {
+            WorkQueue& queue = *queues[w];
+            std::lock_guard<std::mutex> guard { queue.lock };
+            for (size_t item = w * count / n; item < (w + 1) * count / n; ++item)
+            {
+                queue.items.push_back(item);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> guard { state_lock };
+            generation++;
+        }
+        work_ready.notify_all();
+
+        drain(0);
+
+        std::unique_lock<std::mutex> guard { state_lock };
+        work_done.wait(guard, [&] { return pending.load(std::memory_order_acquire) == 0; });
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RT
+{
+    // Fixed set of workers with one job queue each. A batch handed to run() is
+    // dealt out in contiguous blocks; a worker drains its own queue from the
+    // front and, once empty, steals from the back of the others.
+    class ThreadPool
+    {
+    private:
+        struct WorkQueue
+        {
+            std::mutex lock {};
+            std::deque<size_t> items {};
+        };
+
+        std::vector<std::unique_ptr<WorkQueue>> queues {};
+        std::vector<std::thread> workers {};
+
+        const std::function<void(size_t, unsigned)>* job { nullptr };
+        std::atomic<size_t> pending { 0 };
+
+        std::mutex state_lock {};
+        std::condition_variable work_ready {};
+        std::condition_variable work_done {};
+        uint64_t generation { 0 };
+        bool stopping { false };
+
+        bool pop(unsigned worker, size_t& item);
+        void drain(unsigned worker);
+        void worker_loop(unsigned worker);
+
+    public:
+        // 0 threads = std::thread::hardware_concurrency(). The thread calling
+        // run() is counted as one of them.
+        explicit ThreadPool(unsigned threads = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        unsigned size() const { return static_cast<unsigned>(queues.size()); }
+
+        // Calls job(item, worker) for every item in [0, count) and returns once
+        // all of them have finished. worker is in [0, size()).
+        void run(size_t count, const std::function<void(size_t, unsigned)>& job);
+    };
+}
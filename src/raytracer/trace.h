@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include "../lib/point.h"
+#include "../lib/vector.h"
+
+namespace RT
+{
+    enum class PrimitiveKind : uint8_t
+    {
+        None,
+        Sphere,
+        Plane,
+        Triangle,
+    };
+
+    // Closest hit found so far while tracing a ray: only the distance and which
+    // primitive it belongs to. Intersection tests shrink t and overwrite the id;
+    // nothing about the surface is computed until the search is over.
+    struct Trace
+    {
+        float t { std::numeric_limits<float>::max() };
+        uint32_t primitive {};
+        uint32_t instance {};  // instance of the mesh the triangle belongs to
+        PrimitiveKind kind { PrimitiveKind::None };
+
+        bool hit() const { return kind != PrimitiveKind::None; }
+    };
+
+    // Surface data of the winning hit, computed once per ray from its Trace.
+    struct SurfaceInteraction
+    {
+        Point position {};
+        Vector normal {};  // unit length, as oriented by the primitive
+        uint32_t material {};
+    };
+}
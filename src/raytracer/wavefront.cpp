@@ -0,0 +1,223 @@
+#include <algorithm>
+#include "../accel/bvh.h"
+#include "../lib/aabb.h"
+#include "../lib/ray_packet.h"
+#include "wavefront.h"
+
+namespace RT
+{
+    namespace
+    {
+        constexpr uint64_t index_bits = 31;
+        constexpr uint64_t index_mask = (uint64_t { 1 } << index_bits) - 1;
+
+        // The 33 key bits above the index are sorted in three 11-bit radix passes
+        constexpr uint32_t radix_bits = 11;
+        constexpr uint32_t radix_passes = 3;
+    }
+
+    void Wavefront::PathQueue::resize(size_t count)
+    {
+        rays.resize(count);
+        weight.resize(count);
+        depth.resize(count);
+        path.resize(count);
+        sample.resize(count);
+    }
+
+    void Wavefront::PathQueue::set(size_t i, const PathRay& ray, uint32_t sample_index)
+    {
+        rays.set(i, ray.ray);
+        weight[i] = ray.weight;
+        depth[i] = ray.depth;
+        path[i] = ray.path;
+        sample[i] = sample_index;
+    }
+
+    PathRay Wavefront::PathQueue::get(size_t i) const
+    {
+        return PathRay { rays.get(i), weight[i], depth[i], path[i] };
+    }
+
+    void Wavefront::ShadowQueue::resize(size_t count)
+    {
+        rays.resize(count);
+        t_max.resize(count);
+        light.resize(count);
+        sample.resize(count);
+    }
+
+    Wavefront::Wavefront(const Integrator& integrator, bool sort) : integrator { integrator }, sort { sort } {}
+
+    void Wavefront::sort_rays(const RayBuffer& rays)
+    {
+        const size_t count = rays.size();
+        order.resize(count);
+
+        if (!sort)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                order[i] = i;
+            }
+            return;
+        }
+
+        AABB frame {};
+        for (size_t i = 0; i < count; ++i)
+        {
+            frame.expand(Point { rays.ox[i], rays.oy[i], rays.oz[i] });
+        }
+
+        // Octant of the direction (3 bits) above the origin's Morton code (30 bits)
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint64_t octant = (rays.dx[i] < 0.0f ? 4u : 0u) | (rays.dy[i] < 0.0f ? 2u : 0u) | (rays.dz[i] < 0.0f ? 1u : 0u);
+            const uint64_t key = (octant << 30) | Accel::morton_code(Point { rays.ox[i], rays.oy[i], rays.oz[i] }, frame);
+            order[i] = (key << index_bits) | i;
+        }
+
+        // LSD radix sort: stable, so rays with equal keys stay in generation order
+        uint32_t histogram[1u << radix_bits];
+        scratch.resize(count);
+        for (uint32_t pass = 0; pass < radix_passes; ++pass)
+        {
+            const uint32_t shift = index_bits + pass * radix_bits;
+            std::fill(std::begin(histogram), std::end(histogram), 0u);
+            for (uint64_t entry : order)
+            {
+                ++histogram[(entry >> shift) & ((1u << radix_bits) - 1)];
+            }
+
+            uint32_t offset = 0;
+            for (uint32_t& bucket : histogram)
+            {
+                const uint32_t size = bucket;
+                bucket = offset;
+                offset += size;
+            }
+
+            for (uint64_t entry : order)
+            {
+                scratch[histogram[(entry >> shift) & ((1u << radix_bits) - 1)]++] = entry;
+            }
+            order.swap(scratch);
+        }
+    }
+
+    // Camera rays of a tile stay coherent enough for packets; later
+    // generations scatter widely and are traced one at a time.
+    void Wavefront::intersect(bool packets)
+    {
+        const Scene& scene = integrator.get_scene();
+        const size_t count = current.size();
+        hits.resize(count);
+        sort_rays(current.rays);
+
+        RayPacket8 packet;
+        Trace packet_hits[RayPacket8::size];
+        size_t k = 0;
+
+        for (; packets && k + RayPacket8::size <= count; k += RayPacket8::size)
+        {
+            for (size_t lane = 0; lane < RayPacket8::size; ++lane)
+            {
+                packet.set(lane, current.rays.get(order[k + lane] & index_mask));
+            }
+            scene.trace(packet, packet_hits);
+            for (size_t lane = 0; lane < RayPacket8::size; ++lane)
+            {
+                hits[order[k + lane] & index_mask] = packet_hits[lane];
+            }
+        }
+        for (; k < count; ++k)
+        {
+            const size_t i = order[k] & index_mask;
+            hits[i] = scene.trace(current.rays.get(i));
+        }
+    }
+
+    void Wavefront::shade(const uint32_t* seeds, Vector* colors)
+    {
+        const Scene& scene = integrator.get_scene();
+        const size_t count = current.size();
+        const uint32_t lights = static_cast<uint32_t>(scene.light_count());
+
+        // Room for the most each hit can emit; trimmed to what was used below
+        next.resize(2 * count);
+        shadows.resize(lights * count);
+        size_t next_count = 0, shadow_count = 0;
+
+        PathRay children[2];
+        ShadowRay shadow {};
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const PathRay ray = current.get(i);
+            const uint32_t sample = current.sample[i];
+
+            if (!hits[i].hit())
+            {
+                colors[sample] += ray.weight * Integrator::background(ray.ray);
+                continue;
+            }
+
+            const ShadingPoint point = integrator.shading_point(ray.ray, hits[i]);
+            colors[sample] += integrator.emitted(ray, point);
+
+            for (uint32_t id = 0; id < lights; ++id)
+            {
+                if (integrator.shadow_ray(ray, point, id, shadow))
+                {
+                    shadows.rays.set(shadow_count, shadow.ray);
+                    shadows.t_max[shadow_count] = shadow.t_max;
+                    shadows.light[shadow_count] = shadow.light;
+                    shadows.sample[shadow_count++] = sample;
+                }
+            }
+
+            const uint32_t child_count = integrator.scatter(ray, point, seeds[sample], children);
+            for (uint32_t c = 0; c < child_count; ++c)
+            {
+                next.set(next_count++, children[c], sample);
+            }
+        }
+
+        next.resize(next_count);
+        shadows.resize(shadow_count);
+    }
+
+    void Wavefront::trace_shadows(Vector* colors)
+    {
+        const Scene& scene = integrator.get_scene();
+        sort_rays(shadows.rays);
+
+        for (size_t k = 0; k < shadows.size(); ++k)
+        {
+            const size_t i = order[k] & index_mask;
+            if (!scene.occluded(shadows.rays.get(i), shadows.t_max[i]))
+            {
+                colors[shadows.sample[i]] += shadows.light[i];
+            }
+        }
+    }
+
+    void Wavefront::radiance(const RayBuffer& rays, const uint32_t* seeds, size_t first, size_t count, Vector* colors)
+    {
+        current.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            colors[first + i] = Vector {};
+            current.set(i, PathRay { rays.get(first + i), Vector { 1.0f, 1.0f, 1.0f }, 0, 1 },
+                        static_cast<uint32_t>(first + i));
+        }
+
+        for (bool primary = true; current.size() > 0; primary = false)
+        {
+            intersect(primary);
+            shade(seeds, colors);
+            trace_shadows(colors);
+            std::swap(current, next);
+        }
+    }
+}
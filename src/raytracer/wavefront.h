@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../lib/ray_buffer.h"
+#include "../lib/vector.h"
+#include "integrator.h"
+#include "trace.h"
+
+namespace RT
+{
+    // Breadth-first alternative to Integrator::radiance() for a whole batch of
+    // camera rays. Instead of following one sample's rays to the end before
+    // starting the next, every bounce of the batch goes through the same
+    // stages together:
+    //
+    //   intersect  all rays of the current generation (camera rays 8 at a time
+    //              in packets, later generations one by one)
+    //   shade      each hit: emitted light, one shadow ray per light and the
+    //              reflected/refracted rays of the next generation
+    //   shadow     all shadow rays of the generation
+    //
+    // Rays wait in structure-of-arrays queues and, before the intersect and
+    // shadow stages, are sorted by direction octant and then by the Morton
+    // code of their origin, so consecutive rays walk the same BVH nodes. The
+    // random choices come from Integrator::scatter() with the same seeds, so
+    // the image matches radiance() up to floating-point summation order.
+    //
+    // Holds its queues between calls; use one per thread.
+    class Wavefront
+    {
+    private:
+        struct PathQueue
+        {
+            RayBuffer rays {};
+            std::vector<Vector> weight {};
+            std::vector<uint32_t> depth {}, path {};
+            std::vector<uint32_t> sample {};  // camera ray the path belongs to
+
+            size_t size() const { return rays.size(); }
+            void resize(size_t count);
+            void set(size_t i, const PathRay& ray, uint32_t sample);
+            PathRay get(size_t i) const;
+        };
+
+        struct ShadowQueue
+        {
+            RayBuffer rays {};
+            std::vector<float> t_max {};
+            std::vector<Vector> light {};
+            std::vector<uint32_t> sample {};
+
+            size_t size() const { return rays.size(); }
+            void resize(size_t count);
+        };
+
+        const Integrator& integrator;
+        bool sort { true };
+
+        PathQueue current {}, next {};
+        ShadowQueue shadows {};
+        std::vector<Trace> hits {};
+        std::vector<uint64_t> order {};  // sort key in the high bits, ray index in the low 31
+        std::vector<uint64_t> scratch {};
+
+        // Fills order with the rays' indices, grouped for coherent traversal.
+        void sort_rays(const RayBuffer& rays);
+
+        void intersect(bool packets);
+        void shade(const uint32_t* seeds, Vector* colors);
+        void trace_shadows(Vector* colors);
+
+    public:
+        // sort = false keeps the rays in generation order, for comparison.
+        explicit Wavefront(const Integrator& integrator, bool sort = true);
+
+        Wavefront(const Wavefront&) = delete;
+        Wavefront& operator=(const Wavefront&) = delete;
+
+        // colors[first + i] = light along camera ray rays[first + i], with seeds
+        // as in Integrator::radiance().
+        void radiance(const RayBuffer& rays, const uint32_t* seeds, size_t first, size_t count, Vector* colors);
+    };
+}
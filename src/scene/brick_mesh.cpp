@@ -0,0 +1,471 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <type_traits>
+#include "brick_mesh.h"
+
+namespace
+{
+    // Start of a brick section; the bricks follow it, then the directory
+    // (one BrickMesh::Record per brick) and the nodes of the top tree.
+    struct SectionHeader
+    {
+        char magic[8];
+        uint64_t triangle_count;
+        uint64_t brick_count;
+        uint64_t node_count;
+        uint64_t directory_offset;  // from the start of the section
+    };
+
+    // Start of a brick, followed by its BVH nodes, its vertices, three
+    // indices into them per triangle and one material per triangle.
+    struct BrickHeader
+    {
+        uint32_t node_count;
+        uint32_t vertex_count;
+        uint32_t triangle_count;
+        uint32_t reserved;
+    };
+
+    constexpr char section_magic[8] = { 'R', 'T', 'B', 'R', 'I', 'C', 'K', '\0' };
+
+    static_assert(std::is_trivially_copyable<Accel::BVHNode>::value && std::is_trivially_copyable<Point>::value,
+                  "nodes and points are written as they are in memory");
+
+    template <typename T>
+    void put(std::ostream& out, const T* data, size_t count)
+    {
+        out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(count * sizeof(T)));
+    }
+
+    // Copies count values out of [cursor, end), or returns false if they are not all there.
+    template <typename T>
+    bool take(const char*& cursor, const char* end, T* data, size_t count)
+    {
+        if (count > static_cast<size_t>(end - cursor) / sizeof(T))
+        {
+            return false;
+        }
+        if (count > 0)
+        {
+            std::memcpy(static_cast<void*>(data), cursor, count * sizeof(T));
+        }
+        cursor += count * sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool take(const char*& cursor, const char* end, std::vector<T>& data, size_t count)
+    {
+        if (count > static_cast<size_t>(end - cursor) / sizeof(T))
+        {
+            return false;
+        }
+        data.resize(count);
+        return take(cursor, end, data.data(), count);
+    }
+}
+
+BrickCache::Shard& BrickCache::shard_of(uint64_t key)
+{
+    // Fibonacci hashing: neighbouring bricks of a mesh land in different shards
+    return shards[((key * 0x9e3779b97f4a7c15ull) >> 32) % shard_count];
+}
+
+void BrickCache::evict()
+{
+    while (resident_bytes > budget && clock.size() > 1)
+    {
+        Shard& shard = shard_of(clock.front());
+        std::lock_guard<std::mutex> lock { shard.mutex };
+        auto victim = shard.entries.find(clock.front());
+        if (victim->second.used)
+        {
+            // Spared until the clock comes round again
+            victim->second.used = false;
+            clock.splice(clock.end(), clock, clock.begin());
+            continue;
+        }
+        resident_bytes -= victim->second.bytes;
+        shard.entries.erase(victim);
+        clock.pop_front();
+        ++evictions;
+    }
+}
+
+void BrickCache::set_budget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock { mutex };
+    budget = bytes;
+    evict();
+}
+
+uint32_t BrickCache::add_mesh()
+{
+    std::lock_guard<std::mutex> lock { mutex };
+    return mesh_count++;
+}
+
+std::shared_ptr<const Brick> BrickCache::acquire(const BrickMesh& mesh, uint32_t brick)
+{
+    const uint64_t key = uint64_t { mesh.cache_id } << 32 | brick;
+    Shard& shard = shard_of(key);
+    {
+        std::lock_guard<std::mutex> lock { shard.mutex };
+        auto found = shard.entries.find(key);
+        if (found != shard.entries.end())
+        {
+            found->second.used = true;
+            ++shard.hits;
+            return found->second.brick;
+        }
+    }
+
+    // Read without holding a lock, so that rays elsewhere keep going. A
+    // brick that cannot be read is cached empty rather than retried by every ray.
+    std::shared_ptr<const Brick> loaded = mesh.load(brick);
+    const bool failed = !loaded;
+    if (failed)
+    {
+        loaded = std::make_shared<const Brick>();
+    }
+    const size_t bytes = loaded->memory_bytes();
+
+    {
+        std::lock_guard<std::mutex> lock { shard.mutex };
+        auto inserted = shard.entries.emplace(key, Entry { loaded, bytes, false });
+        if (!inserted.second)
+        {
+            // Another ray read it in the meantime
+            inserted.first->second.used = true;
+            ++shard.duplicate_reads;
+            return inserted.first->second.brick;
+        }
+        ++shard.misses;
+        shard.failures += failed ? 1 : 0;
+        shard.bytes_read += mesh.records[brick].bytes;
+    }
+
+    // Only evict() removes entries, and only those on the clock, so the
+    // brick stays in the map until it is added here
+    std::lock_guard<std::mutex> lock { mutex };
+    clock.push_back(key);
+    resident_bytes += bytes;
+    peak_bytes = std::max(peak_bytes, resident_bytes);
+    evict();
+    return loaded;
+}
+
+BrickCacheStats BrickCache::get_stats() const
+{
+    std::lock_guard<std::mutex> lock { mutex };
+    BrickCacheStats stats {};
+    for (const Shard& shard : shards)
+    {
+        std::lock_guard<std::mutex> shard_lock { shard.mutex };
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.duplicate_reads += shard.duplicate_reads;
+        stats.failures += shard.failures;
+        stats.bytes_read += shard.bytes_read;
+    }
+    stats.evictions = evictions;
+    stats.resident_bytes = resident_bytes;
+    stats.peak_bytes = peak_bytes;
+    return stats;
+}
+
+bool BrickMesh::write(std::ostream& out, Span<const Point> vertices, Span<const uint32_t> indices,
+                      Span<const uint32_t> face_materials, const Accel::BuildOptions& options, uint32_t brick_size)
+{
+    const size_t face_count = std::min(indices.size() / 3, face_materials.size());
+    if (face_count > std::numeric_limits<uint32_t>::max())
+    {
+        return false;
+    }
+
+    std::vector<uint32_t> faces;
+    std::vector<AABB> bounds;
+    for (size_t face = 0; face < face_count; ++face)
+    {
+        const uint32_t* corner = &indices[3 * face];
+        if (corner[0] >= vertices.size() || corner[1] >= vertices.size() || corner[2] >= vertices.size())
+        {
+            continue;
+        }
+        AABB box {};
+        box.expand(vertices[corner[0]]);
+        box.expand(vertices[corner[1]]);
+        box.expand(vertices[corner[2]]);
+        faces.push_back(static_cast<uint32_t>(face));
+        bounds.push_back(box);
+    }
+
+    // The bricks are the leaves of a tree that stops at brick_size triangles,
+    // as the clusters of an Accel::LazyBVH
+    Accel::BVH top {};
+    Accel::BuildOptions top_options = options;
+    top_options.max_leaf_size = std::max(brick_size, options.max_leaf_size);
+    top.build(bounds, top_options);
+    const std::vector<uint32_t>& order = top.get_indices();
+
+    // Bricks are numbered and written in the order of their ranges, which
+    // keeps neighbours in space close together in the file
+    std::vector<Accel::BVHNode> nodes = top.get_nodes();
+    std::vector<uint32_t> leaves;
+    for (uint32_t i = 0; i < nodes.size(); ++i)
+    {
+        if (nodes[i].is_leaf())
+        {
+            leaves.push_back(i);
+        }
+    }
+    std::sort(leaves.begin(), leaves.end(), [&](uint32_t a, uint32_t b) { return nodes[a].offset < nodes[b].offset; });
+
+    const std::streampos start = out.tellp();
+    SectionHeader header {};
+    std::memcpy(header.magic, section_magic, sizeof(header.magic));
+    header.triangle_count = faces.size();
+    header.brick_count = leaves.size();
+    header.node_count = nodes.size();
+    put(out, &header, 1);
+
+    Accel::BuildOptions brick_options = options;
+    brick_options.max_leaf_size = Geometry::TriangleStore::batch_width;
+    std::vector<Record> records(leaves.size());
+    for (uint32_t id = 0; id < leaves.size(); ++id)
+    {
+        Accel::BVHNode& leaf = nodes[leaves[id]];
+        Record& record = records[id];
+        record.offset = static_cast<uint64_t>(out.tellp() - start);
+        record.first = leaf.offset;
+        record.count = leaf.count;
+
+        std::vector<AABB> brick_bounds(leaf.count);
+        for (uint32_t k = 0; k < leaf.count; ++k)
+        {
+            brick_bounds[k] = bounds[order[leaf.offset + k]];
+        }
+        Accel::BVH bvh {};
+        bvh.build(brick_bounds, brick_options);
+
+        // Triangles in the order of the brick's tree, over the vertices they use
+        std::vector<uint32_t> corners, materials;
+        corners.reserve(3 * size_t { leaf.count });
+        materials.reserve(leaf.count);
+        for (uint32_t k : bvh.get_indices())
+        {
+            const uint32_t face = faces[order[leaf.offset + k]];
+            corners.insert(corners.end(), &indices[3 * size_t { face }], &indices[3 * size_t { face }] + 3);
+            materials.push_back(face_materials[face]);
+        }
+        std::vector<uint32_t> used = corners;
+        std::sort(used.begin(), used.end());
+        used.erase(std::unique(used.begin(), used.end()), used.end());
+
+        std::vector<Point> points;
+        points.reserve(used.size());
+        for (uint32_t vertex : used)
+        {
+            points.push_back(vertices[vertex]);
+        }
+        for (uint32_t& corner : corners)
+        {
+            corner = static_cast<uint32_t>(std::lower_bound(used.begin(), used.end(), corner) - used.begin());
+        }
+
+        const BrickHeader brick { static_cast<uint32_t>(bvh.get_nodes().size()), static_cast<uint32_t>(points.size()),
+                                  leaf.count, 0 };
+        put(out, &brick, 1);
+        put(out, bvh.get_nodes().data(), bvh.get_nodes().size());
+        put(out, points.data(), points.size());
+        put(out, corners.data(), corners.size());
+        put(out, materials.data(), materials.size());
+        record.bytes = static_cast<uint64_t>(out.tellp() - start) - record.offset;
+
+        // In the stored top tree, a leaf is its brick
+        leaf.offset = id;
+        leaf.count = 1;
+    }
+
+    header.directory_offset = static_cast<uint64_t>(out.tellp() - start);
+    put(out, records.data(), records.size());
+    put(out, nodes.data(), nodes.size());
+
+    const std::streampos end = out.tellp();
+    out.seekp(start);
+    put(out, &header, 1);
+    out.seekp(end);
+    return static_cast<bool>(out);
+}
+
+bool BrickMesh::open(const std::string& file, uint64_t offset, uint32_t base, BrickCache& brick_cache)
+{
+    *this = BrickMesh {};
+
+    std::ifstream in(file, std::ios::binary | std::ios::ate);
+    if (!in.is_open())
+    {
+        return false;
+    }
+    const uint64_t size = static_cast<uint64_t>(in.tellg());
+    SectionHeader header {};
+    if (offset > size || size - offset < sizeof(header) ||
+        !in.seekg(static_cast<std::streamoff>(offset)).read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        return false;
+    }
+
+    const uint64_t available = size - offset;
+    if (std::memcmp(header.magic, section_magic, sizeof(section_magic)) != 0 ||
+        header.directory_offset > available ||
+        header.brick_count > (available - header.directory_offset) / sizeof(Record) ||
+        header.node_count > (available - header.directory_offset - header.brick_count * sizeof(Record)) /
+                                sizeof(Accel::BVHNode))
+    {
+        return false;
+    }
+
+    std::vector<Record> directory(header.brick_count);
+    std::vector<Accel::BVHNode> nodes(header.node_count);
+    in.seekg(static_cast<std::streamoff>(offset + header.directory_offset));
+    in.read(reinterpret_cast<char*>(directory.data()), static_cast<std::streamsize>(directory.size() * sizeof(Record)));
+    in.read(reinterpret_cast<char*>(nodes.data()), static_cast<std::streamsize>(nodes.size() * sizeof(Accel::BVHNode)));
+    if (!in)
+    {
+        return false;
+    }
+
+    // The bricks number the triangles in order, and all lie before the directory
+    uint64_t next = 0;
+    for (const Record& record : directory)
+    {
+        if (record.first != next || record.count == 0 || record.offset < sizeof(SectionHeader) ||
+            record.offset > header.directory_offset || record.bytes > header.directory_offset - record.offset)
+        {
+            return false;
+        }
+        next += record.count;
+    }
+    if (next != header.triangle_count || next > std::numeric_limits<uint32_t>::max())
+    {
+        return false;
+    }
+
+    std::vector<uint32_t> identity(directory.size());
+    std::iota(identity.begin(), identity.end(), 0u);
+    Accel::BVH tree {};
+    if (!tree.assign(std::move(nodes), std::move(identity), directory.size()))
+    {
+        return false;
+    }
+
+    path = file;
+    section = offset;
+    top = std::move(tree);
+    records = std::move(directory);
+    material_base = base;
+    cache = &brick_cache;
+    cache_id = brick_cache.add_mesh();
+    return true;
+}
+
+std::shared_ptr<Brick> BrickMesh::load(uint32_t id) const
+{
+    const Record& record = records[id];
+    std::vector<char> bytes(record.bytes);
+    std::ifstream in(path, std::ios::binary);
+    if (!in.seekg(static_cast<std::streamoff>(section + record.offset))
+             .read(bytes.data(), static_cast<std::streamsize>(bytes.size())))
+    {
+        return nullptr;
+    }
+
+    const char* cursor = bytes.data();
+    const char* end = cursor + bytes.size();
+    BrickHeader header {};
+    std::vector<Accel::BVHNode> nodes;
+    std::vector<Point> vertices;
+    std::vector<uint32_t> corners;
+    auto brick = std::make_shared<Brick>();
+    if (!take(cursor, end, &header, 1) || header.triangle_count != record.count ||
+        !take(cursor, end, nodes, header.node_count) || !take(cursor, end, vertices, header.vertex_count) ||
+        !take(cursor, end, corners, 3 * size_t { header.triangle_count }) ||
+        !take(cursor, end, brick->materials, header.triangle_count))
+    {
+        return nullptr;
+    }
+
+    // Triangles with a corner out of range are dropped by the store, which
+    // would shift the others out of their leaves
+    brick->triangles = Geometry::TriangleStore { vertices, corners };
+    std::vector<uint32_t> identity(record.count);
+    std::iota(identity.begin(), identity.end(), 0u);
+    if (brick->triangles.size() != record.count || !brick->bvh.assign(std::move(nodes), std::move(identity), record.count))
+    {
+        return nullptr;
+    }
+
+    for (uint32_t& material : brick->materials)
+    {
+        material += material_base;
+    }
+    return brick;
+}
+
+uint32_t BrickMesh::brick_of(uint32_t triangle) const
+{
+    auto after = std::upper_bound(records.begin(), records.end(), triangle,
+                                  [](uint32_t id, const Record& record) { return id < record.first; });
+    return static_cast<uint32_t>(after - records.begin()) - 1;
+}
+
+bool BrickMesh::hit(const Ray& ray, float& t_max, uint32_t& hit_id) const
+{
+    return top.traverse(ray, t_max, [&](uint32_t first, uint32_t count, float& t) {
+        bool found { false };
+        for (uint32_t id = first; id < first + count; ++id)
+        {
+            const std::shared_ptr<const Brick> brick = cache->acquire(*this, id);
+            uint32_t local {};
+            if (brick->bvh.traverse(ray, t, [&](uint32_t leaf_first, uint32_t leaf_count, float& t_leaf) {
+                    return brick->triangles.hit(leaf_first, leaf_count, ray, t_leaf, local);
+                }))
+            {
+                hit_id = records[id].first + local;
+                found = true;
+            }
+        }
+        return found;
+    });
+}
+
+bool BrickMesh::occluded(const Ray& ray, float t_max) const
+{
+    return top.traverse_any(ray, t_max, [&](uint32_t first, uint32_t count) {
+        for (uint32_t id = first; id < first + count; ++id)
+        {
+            const std::shared_ptr<const Brick> brick = cache->acquire(*this, id);
+            if (brick->bvh.traverse_any(ray, t_max, [&](uint32_t leaf_first, uint32_t leaf_count) {
+                    return brick->triangles.occluded(leaf_first, leaf_count, ray, t_max);
+                }))
+            {
+                return true;
+            }
+        }
+        return false;
+    });
+}
+
+void BrickMesh::get_surface(uint32_t id, Vector& normal, uint32_t& material) const
+{
+    const uint32_t brick = brick_of(id);
+    const std::shared_ptr<const Brick> resident = cache->acquire(*this, brick);
+    const uint32_t local = id - records[brick].first;
+
+    // A brick that could not be read back is empty
+    normal = local < resident->triangles.size() ? resident->triangles.get_normal(local) : Vector {};
+    material = local < resident->materials.size() ? resident->materials[local] : material_base;
+}
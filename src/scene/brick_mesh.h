@@ -0,0 +1,196 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../accel/bvh.h"
+#include "../geometry/triangle_store.h"
+#include "../lib/aabb.h"
+#include "../lib/point.h"
+#include "../lib/ray.h"
+#include "../lib/span.h"
+#include "../lib/vector.h"
+
+class BrickMesh;
+
+// The triangles of one brick once read back: a TriangleStore already in the
+// order of the brick's own BVH, as for a mesh kept in memory.
+struct Brick
+{
+    Geometry::TriangleStore triangles {};
+    Accel::BVH bvh {};
+    std::vector<uint32_t> materials {};  // per triangle, in store order
+
+    size_t memory_bytes() const
+    {
+        return triangles.memory_bytes() + bvh.memory_bytes() + materials.capacity() * sizeof(uint32_t);
+    }
+};
+
+// What a BrickCache has done since it was created.
+struct BrickCacheStats
+{
+    uint64_t hits {};
+    uint64_t misses {};           // bricks read from disk and kept
+    uint64_t duplicate_reads {};  // bricks read again while another ray was already reading them
+    uint64_t evictions {};
+    uint64_t failures {};         // bricks that could not be read back and were left empty
+    uint64_t bytes_read {};       // by the misses
+    size_t resident_bytes {};
+    size_t peak_bytes {};
+};
+
+// Bricks held in memory for every BrickMesh of a scene, within a budget of
+// bytes: reading a brick past the budget evicts bricks that no ray has used
+// lately. Eviction only drops the cache's reference, so a brick that a ray is
+// still inside lives until that ray leaves it; the budget can be exceeded by
+// about one brick per render thread.
+//
+// Every brick a ray visits goes through acquire(), so a hit locks only the
+// shard of the map holding that brick and marks it used. The order of use is
+// approximated with a clock: eviction sweeps the bricks in the order they were
+// read, sparing once those used since the last sweep.
+class BrickCache
+{
+private:
+    struct Entry
+    {
+        std::shared_ptr<const Brick> brick {};
+        size_t bytes {};
+        bool used {};  // since the clock last passed it
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex {};
+        std::unordered_map<uint64_t, Entry> entries {};  // key: mesh << 32 | brick
+        uint64_t hits {};
+        uint64_t misses {};
+        uint64_t duplicate_reads {};
+        uint64_t failures {};
+        uint64_t bytes_read {};
+    };
+
+    static constexpr size_t shard_count = 64;
+
+    std::array<Shard, shard_count> shards {};
+
+    // Guards the rest; taken before a shard's mutex, never while holding one.
+    mutable std::mutex mutex {};
+    std::list<uint64_t> clock {};  // resident bricks, the next one to sweep first
+    size_t budget { default_budget };
+    uint32_t mesh_count {};
+    uint64_t evictions {};
+    size_t resident_bytes {};
+    size_t peak_bytes {};
+
+    Shard& shard_of(uint64_t key);
+
+    // Drops bricks not used since the clock last passed them, but never the
+    // last one left. Needs mutex.
+    void evict();
+
+public:
+    static constexpr size_t default_budget = size_t { 1 } << 30;
+
+    BrickCache() = default;
+    ~BrickCache() = default;
+    BrickCache(const BrickCache&) = delete;
+    BrickCache& operator=(const BrickCache&) = delete;
+
+    void set_budget(size_t bytes);
+    size_t get_budget() const { return budget; }
+
+    // Id under which a new mesh keeps its bricks.
+    uint32_t add_mesh();
+
+    // Brick of mesh, read from disk if it is not resident.
+    std::shared_ptr<const Brick> acquire(const BrickMesh& mesh, uint32_t brick);
+
+    BrickCacheStats get_stats() const;
+};
+
+// Mesh whose triangles stay on disk, split spatially into bricks of about
+// brick_size triangles: the leaves of a top BVH over the whole mesh. Only
+// the top tree and the brick directory are kept in memory; a brick is read
+// back, with a BVH of its own built when it was written, the first time a
+// ray enters its box after it last left the cache.
+//
+// Triangles are numbered brick after brick, so a brick is a contiguous
+// range of ids and the ids handed out by hit() stay valid while the brick
+// comes and goes.
+class BrickMesh
+{
+private:
+    friend class BrickCache;
+
+    // Directory entry of a brick.
+    struct Record
+    {
+        uint64_t offset {};  // from the start of the section
+        uint64_t bytes {};
+        uint32_t first {};   // id of its first triangle
+        uint32_t count {};
+    };
+
+    std::string path {};
+    uint64_t section {};
+    Accel::BVH top {};  // one leaf per brick, whose offset is the brick's id
+    std::vector<Record> records {};
+    uint32_t material_base {};
+    BrickCache* cache {};
+    uint32_t cache_id {};
+
+    // Reads a brick from disk; nullptr if the file does not hold a valid one.
+    std::shared_ptr<Brick> load(uint32_t brick) const;
+
+    uint32_t brick_of(uint32_t triangle) const;
+
+public:
+    static constexpr uint32_t default_brick_size = 16384;
+
+    BrickMesh() = default;
+    BrickMesh(const BrickMesh&) = default;
+    BrickMesh(BrickMesh&&) = default;
+    ~BrickMesh() = default;
+    BrickMesh& operator=(const BrickMesh&) = default;
+    BrickMesh& operator=(BrickMesh&&) = default;
+
+    // Writes a mesh as one brick section at the current position of out
+    // (which must be seekable). indices holds three vertex indices per face,
+    // face_materials one material per face; faces referencing vertices out
+    // of range are skipped, as in TriangleStore. The bricks are split and
+    // built with options, at most one brick in memory at a time.
+    static bool write(std::ostream& out, Span<const Point> vertices, Span<const uint32_t> indices,
+                      Span<const uint32_t> face_materials, const Accel::BuildOptions& options,
+                      uint32_t brick_size = default_brick_size);
+
+    // Opens the section written at offset of path, reading only its top
+    // tree and directory. Materials read back are shifted by material_base.
+    // Returns false, leaving the mesh empty, if the section is not valid.
+    bool open(const std::string& path, uint64_t offset, uint32_t material_base, BrickCache& cache);
+
+    bool empty() const { return top.empty(); }
+    size_t brick_count() const { return records.size(); }
+    size_t triangle_count() const { return records.empty() ? 0 : size_t { records.back().first } + records.back().count; }
+    const AABB& get_bounds() const { return top.get_nodes()[0].bounds; }
+    const Accel::BVH& get_top() const { return top; }
+
+    // Heap bytes held in memory for good (the bricks are the cache's).
+    size_t memory_bytes() const { return top.memory_bytes() + records.capacity() * sizeof(Record); }
+
+    // Same contracts as TriangleStore::hit and TriangleStore::occluded, over
+    // the whole mesh.
+    bool hit(const Ray& ray, float& t_max, uint32_t& hit_id) const;
+    bool occluded(const Ray& ray, float t_max) const;
+
+    // Normal and material of triangle id, with a single cache access.
+    void get_surface(uint32_t id, Vector& normal, uint32_t& material) const;
+};
@@ -1,5 +1,7 @@
 #include <cassert>
 #include <cmath>
+#include "../kernels/kernels.h"
+#include "../lib/simd.h"
 #include "camera.h"
 
 Camera::Camera(Point center, Point target, Vector up, float vertical_fov,
@@ -25,15 +27,114 @@ Camera::Camera(Point center, Point target, Vector up, float vertical_fov,
 
     u = cross(v, w);
     lower_left_pixel = center - (sensor_width / 2.0f) * u - (sensor_height / 2.0f) * v - w;
+
+    // A single pixel column or row sits at the lower left corner
+    pixel_du = pixel_width > 1 ? (sensor_width / (pixel_width - 1)) * u : Vector {};
+    pixel_dv = pixel_height > 1 ? (sensor_height / (pixel_height - 1)) * v : Vector {};
 }
 
 Ray Camera::cast_ray(const uint32_t& px, const uint32_t& py) const
 {
-    float sx = (px * sensor_width) / (pixel_width - 1);
-    float sy = (py * sensor_height) / (pixel_height - 1);
+    if (has_direction_cache())
+    {
+        const size_t i = static_cast<size_t>(py) * pixel_width + px;
+        return Ray { center, Vector { cached_dx[i], cached_dy[i], cached_dz[i] } };
+    }
 
-    Point pixel = lower_left_pixel + sx * u + sy * v;
+    Point pixel = lower_left_pixel + static_cast<float>(px) * pixel_du + static_cast<float>(py) * pixel_dv;
     Vector direction = (pixel - center).normalized();
 
     return Ray { center, direction };
 }
+
+Ray Camera::cast_sample(float x, float y) const
+{
+    Vector direction = ((lower_left_pixel - center) + x * pixel_du + y * pixel_dv).normalized();
+    return Ray { center, direction };
+}
+
+void Camera::directions8(uint32_t px, uint32_t py, const float* offset_x, const float* offset_y,
+                         float* dx, float* dy, float* dz) const
+{
+    using SIMD::float8;
+
+    if (!offset_x && has_direction_cache())
+    {
+        const size_t i = static_cast<size_t>(py) * pixel_width + px;
+        float8::loadu(&cached_dx[i]).storeu(dx);
+        float8::loadu(&cached_dy[i]).storeu(dy);
+        float8::loadu(&cached_dz[i]).storeu(dz);
+        return;
+    }
+
+    const Kernels::Film film { lower_left_pixel - center, pixel_du, pixel_dv };
+    Kernels::active().primary_directions(film, px, py, offset_x, offset_y, dx, dy, dz);
+}
+
+void Camera::cast_packet(const uint32_t& px, const uint32_t& py, RayPacket8& rays) const
+{
+    using SIMD::float8;
+
+    directions8(px, py, nullptr, nullptr, rays.dx, rays.dy, rays.dz);
+    float8 { center.x }.store(rays.ox);
+    float8 { center.y }.store(rays.oy);
+    float8 { center.z }.store(rays.oz);
+}
+
+void Camera::cast_row(uint32_t px, uint32_t py, uint32_t count, RayBuffer& rays, size_t first) const
+{
+    cast_row(px, py, count, nullptr, nullptr, rays, first);
+}
+
+void Camera::cast_row(uint32_t px, uint32_t py, uint32_t count, const float* offset_x, const float* offset_y,
+                      RayBuffer& rays, size_t first) const
+{
+    using SIMD::float8;
+    assert(first + count <= rays.size());
+
+    uint32_t i = 0;
+    for (; i + float8::width <= count; i += float8::width)
+    {
+        directions8(px + i, py, offset_x ? offset_x + i : nullptr, offset_y ? offset_y + i : nullptr,
+                    &rays.dx[first + i], &rays.dy[first + i], &rays.dz[first + i]);
+        float8 { center.x }.storeu(&rays.ox[first + i]);
+        float8 { center.y }.storeu(&rays.oy[first + i]);
+        float8 { center.z }.storeu(&rays.oz[first + i]);
+    }
+    for (; i < count; ++i)
+    {
+        rays.set(first + i, offset_x ? cast_sample(px + i + offset_x[i], py + offset_y[i]) : cast_ray(px + i, py));
+    }
+}
+
+void Camera::cache_directions()
+{
+    clear_direction_cache();
+
+    RayBuffer row;
+    row.resize(pixel_width);
+    std::vector<float> dx, dy, dz;
+    const size_t pixels = static_cast<size_t>(pixel_width) * pixel_height;
+    dx.reserve(pixels);
+    dy.reserve(pixels);
+    dz.reserve(pixels);
+
+    for (uint32_t py = 0; py < pixel_height; ++py)
+    {
+        cast_row(0, py, pixel_width, row);
+        dx.insert(dx.end(), row.dx.begin(), row.dx.begin() + pixel_width);
+        dy.insert(dy.end(), row.dy.begin(), row.dy.begin() + pixel_width);
+        dz.insert(dz.end(), row.dz.begin(), row.dz.begin() + pixel_width);
+    }
+
+    cached_dx.swap(dx);
+    cached_dy.swap(dy);
+    cached_dz.swap(dz);
+}
+
+void Camera::clear_direction_cache()
+{
+    cached_dx = {};
+    cached_dy = {};
+    cached_dz = {};
+}
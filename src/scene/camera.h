@@ -1,8 +1,11 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 #include "../lib/point.h"
 #include "../lib/ray.h"
+#include "../lib/ray_buffer.h"
+#include "../lib/ray_packet.h"
 #include "../lib/vector.h"
 
 class Camera
@@ -22,6 +25,19 @@ private:
 
     Point lower_left_pixel {};
 
+    // World-space step from one pixel to the next along u and v, so a pixel
+    // is lower_left_pixel + px * pixel_du + py * pixel_dv.
+    Vector pixel_du {}, pixel_dv {};
+
+    // Unit directions of every pixel, row-major from py = 0; empty unless
+    // cache_directions() was called.
+    std::vector<float> cached_dx {}, cached_dy {}, cached_dz {};
+
+    // Directions through pixels px .. px + 7 of row py, each moved by
+    // (offset_x[i], offset_y[i]) pixels unless the offsets are null.
+    void directions8(uint32_t px, uint32_t py, const float* offset_x, const float* offset_y,
+                     float* dx, float* dy, float* dz) const;
+
 public:
     explicit Camera(Point center, Point target, Vector up, float vertical_fov,
                     uint32_t pixel_height, uint32_t pixel_width);
@@ -35,4 +51,27 @@ public:
     Camera &operator=(const Camera &) = default;
 
     Ray cast_ray(const uint32_t& px, const uint32_t& py) const;
+
+    // Ray through a point of the film in pixel units: (px, py) is the same
+    // ray as cast_ray(px, py), and a pixel covers [px - 0.5, px + 0.5).
+    Ray cast_sample(float x, float y) const;
+
+    // Primary rays through pixels px .. px + 7 of row py, in SoA layout.
+    void cast_packet(const uint32_t& px, const uint32_t& py, RayPacket8& rays) const;
+
+    // Primary rays through pixels px .. px + count - 1 of row py, written to
+    // rays[first ..]; the buffer must already hold first + count rays.
+    void cast_row(uint32_t px, uint32_t py, uint32_t count, RayBuffer& rays, size_t first = 0) const;
+
+    // Same, with ray i moved by (offset_x[i], offset_y[i]) pixels, e.g. to
+    // spread several samples over each pixel. Never uses the direction cache.
+    void cast_row(uint32_t px, uint32_t py, uint32_t count, const float* offset_x, const float* offset_y,
+                  RayBuffer& rays, size_t first = 0) const;
+
+    // Stores the direction of every pixel (12 bytes each) so later calls
+    // only copy them; worth it when the same camera casts the same rays for
+    // many frames or passes. The rays are bit-identical to uncached ones.
+    void cache_directions();
+    void clear_direction_cache();
+    bool has_direction_cache() const { return !cached_dx.empty(); }
 };
@@ -0,0 +1,537 @@
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <utility>
+#include "scene.h"
+
+uint32_t Scene::add_material(const Material& material)
+{
+    materials.push_back(material);
+    return static_cast<uint32_t>(materials.size() - 1);
+}
+
+uint32_t Scene::add_light(const Light& light)
+{
+    lights.push_back(light);
+    return static_cast<uint32_t>(lights.size() - 1);
+}
+
+uint32_t Scene::add_sphere(const Point& center, float radius, uint32_t material)
+{
+    sphere_materials.push_back(material);
+    return spheres.add(center, radius);
+}
+
+void Scene::add_spheres(Span<const float> xyzr, uint32_t material)
+{
+    spheres.add_records(xyzr);
+    sphere_materials.resize(spheres.size(), material);
+}
+
+uint32_t Scene::add_plane(const Point& point, const Vector& normal, uint32_t material)
+{
+    planes.px.push_back(point.x);
+    planes.py.push_back(point.y);
+    planes.pz.push_back(point.z);
+    planes.nx.push_back(normal.x);
+    planes.ny.push_back(normal.y);
+    planes.nz.push_back(normal.z);
+    planes.material.push_back(material);
+    return static_cast<uint32_t>(planes.nx.size() - 1);
+}
+
+uint32_t Scene::add_mesh(Span<const Point> vertices, Span<const uint32_t> indices, Span<const uint32_t> face_materials)
+{
+    Mesh mesh {};
+    mesh.triangles = Geometry::TriangleStore { vertices, indices };
+    mesh.face_materials.assign(face_materials.begin(), face_materials.end());
+    meshes.push_back(std::move(mesh));
+    return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+uint32_t Scene::add_brick_mesh(const std::string& path, uint64_t offset, uint32_t material_base)
+{
+    Mesh mesh {};
+    if (!mesh.bricks.open(path, offset, material_base, brick_cache))
+    {
+        return std::numeric_limits<uint32_t>::max();
+    }
+    meshes.push_back(std::move(mesh));
+    return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+uint32_t Scene::add_instance(uint32_t mesh, const Transform& object_to_world)
+{
+    if (object_to_world.determinant() == 0.0f)
+    {
+        return std::numeric_limits<uint32_t>::max();
+    }
+
+    instances.push_back(Instance { mesh, object_to_world, object_to_world.inverse() });
+    return static_cast<uint32_t>(instances.size() - 1);
+}
+
+Accel::BuildStats Scene::build_spheres(const Accel::BuildOptions& options)
+{
+    Accel::BuildOptions sphere_options = options;
+    sphere_options.max_leaf_size = Geometry::SphereStore::batch_width;
+    Accel::BuildStats stats = sphere_bvh.build(spheres.all_bounds(), sphere_options);
+
+    // Same as the meshes: every leaf becomes a contiguous range of spheres
+    const std::vector<uint32_t>& order = sphere_bvh.get_indices();
+    spheres.reorder(order);
+    std::vector<uint32_t> sorted(order.size());
+    std::vector<uint32_t> moved_to(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        sorted[i] = sphere_materials[order[i]];
+        moved_to[order[i]] = static_cast<uint32_t>(i);
+    }
+    sphere_materials.swap(sorted);
+
+    // Spheres added since the last build were still at their own id
+    const size_t known = sphere_slots.size();
+    sphere_slots.resize(order.size());
+    for (size_t id = 0; id < order.size(); ++id)
+    {
+        sphere_slots[id] = moved_to[id < known ? sphere_slots[id] : id];
+    }
+    return stats;
+}
+
+Accel::BuildStats Scene::build_mesh(uint32_t id, const Accel::BuildOptions& options)
+{
+    Mesh& mesh = meshes[id];
+
+    // Leaves of up to 8 triangles, tested together by the SIMD kernel
+    Accel::BuildOptions mesh_options = options;
+    mesh_options.max_leaf_size = Geometry::TriangleStore::batch_width;
+    Accel::BuildStats stats = mesh.bvh.build(mesh.triangles.all_bounds(), mesh_options);
+    mesh.lazy = Accel::LazyBVH {};
+
+    // Reorder the triangles along the BVH so that every leaf is a contiguous range
+    mesh.triangles.reorder(mesh.bvh.get_indices());
+    return stats;
+}
+
+Accel::BuildStats Scene::build_mesh_lazy(uint32_t id, const Accel::BuildOptions& options)
+{
+    Mesh& mesh = meshes[id];
+    Accel::BuildOptions mesh_options = options;
+    mesh_options.max_leaf_size = Geometry::TriangleStore::batch_width;
+
+    // The callbacks look the mesh up again, since meshes may move in memory
+    Accel::BuildStats stats = mesh.lazy.build(
+        mesh.triangles.all_bounds(), mesh_options,
+        [this, id](uint32_t first, uint32_t count) { return meshes[id].triangles.range_bounds(first, count); },
+        [this, id](uint32_t first, const std::vector<uint32_t>& order) { meshes[id].triangles.reorder(first, order); });
+
+    // Clusters become contiguous ranges; each is reordered again when expanded
+    mesh.triangles.reorder(mesh.lazy.get_indices());
+    mesh.bvh = Accel::BVH {};
+    return stats;
+}
+
+bool Scene::compress_mesh(uint32_t id, Span<const Point> vertices, Span<const uint32_t> indices)
+{
+    Mesh& mesh = meshes[id];
+    if (mesh.bvh.empty())
+    {
+        return false;
+    }
+    for (uint32_t slot = 0; slot < mesh.triangles.size(); ++slot)
+    {
+        if (3 * size_t { mesh.triangles.get_face(slot) } + 2 >= indices.size())
+        {
+            return false;
+        }
+    }
+
+    // Snapping moves the vertices, so the boxes are refitted to the decoded
+    // triangles before they are quantized in turn
+    Geometry::QuantizedTriangleStore packed { vertices, indices, mesh.triangles };
+    mesh.bvh.refit(packed.all_bounds());
+
+    Accel::WideBVH wide {};
+    std::vector<uint32_t> order;
+    if (!wide.build(mesh.bvh, order))
+    {
+        mesh.bvh.refit(mesh.triangles.all_bounds());
+        return false;
+    }
+    packed.reorder(order);
+
+    mesh.packed = std::move(packed);
+    mesh.wide = std::move(wide);
+    mesh.triangles = Geometry::TriangleStore {};
+    mesh.bvh = Accel::BVH {};
+    return true;
+}
+
+size_t Scene::mesh_memory(uint32_t id) const
+{
+    const Mesh& mesh = meshes[id];
+    return mesh.triangles.memory_bytes() + mesh.bvh.memory_bytes() + mesh.lazy.memory_bytes() +
+           mesh.packed.memory_bytes() + mesh.wide.memory_bytes() + mesh.bricks.memory_bytes() +
+           mesh.face_materials.capacity() * sizeof(uint32_t);
+}
+
+bool Scene::assign_mesh_bvh(uint32_t id, std::vector<Accel::BVHNode> nodes, std::vector<uint32_t> indices)
+{
+    Mesh& mesh = meshes[id];
+    Accel::BVH bvh {};
+    if (!bvh.assign(std::move(nodes), std::move(indices), mesh.triangles.size()))
+    {
+        return false;
+    }
+
+    mesh.bvh = std::move(bvh);
+    mesh.lazy = Accel::LazyBVH {};
+    mesh.triangles.reorder(mesh.bvh.get_indices());
+    return true;
+}
+
+AABB Scene::instance_bounds(const Instance& instance) const
+{
+    // A mesh without triangles still gets a (point) box, so the builder sees no empty ones
+    const Mesh& mesh = meshes[instance.mesh];
+    const Accel::BVH& bvh = mesh.lazy.empty() ? mesh.bvh : mesh.lazy.get_top();
+    const Point origin = instance.object_to_world.apply(Point {});
+    if (!mesh.wide.empty())
+    {
+        return instance.object_to_world.apply(mesh.wide.get_bounds());
+    }
+    if (!mesh.bricks.empty())
+    {
+        return instance.object_to_world.apply(mesh.bricks.get_bounds());
+    }
+    return bvh.empty() ? AABB { origin, origin } : instance.object_to_world.apply(bvh.get_nodes()[0].bounds);
+}
+
+Accel::BuildStats Scene::build_instances(const Accel::BuildOptions& options)
+{
+    std::vector<AABB> bounds;
+    bounds.reserve(instances.size());
+    for (const Instance& instance : instances)
+    {
+        bounds.push_back(instance_bounds(instance));
+    }
+
+    // An instance costs a whole mesh traversal, so leaves hold as few as the tree allows
+    Accel::BuildOptions instance_options = options;
+    instance_options.max_leaf_size = 1;
+    return instance_bvh.build(bounds, instance_options);
+}
+
+void Scene::set_sphere(uint32_t id, const Point& center, float radius)
+{
+    spheres.set(id < sphere_slots.size() ? sphere_slots[id] : id, center, radius);
+    spheres_moved = true;
+}
+
+bool Scene::set_instance_transform(uint32_t id, const Transform& object_to_world)
+{
+    if (object_to_world.determinant() == 0.0f)
+    {
+        return false;
+    }
+
+    instances[id].object_to_world = object_to_world;
+    instances[id].world_to_object = object_to_world.inverse();
+    instances_moved = true;
+    return true;
+}
+
+bool Scene::set_mesh_vertices(uint32_t id, Span<const Point> vertices, Span<const uint32_t> indices)
+{
+    Mesh& mesh = meshes[id];
+    if (!mesh.wide.empty() || !mesh.bricks.empty() || !mesh.triangles.update(vertices, indices))
+    {
+        return false;
+    }
+    mesh.moved = true;
+    return true;
+}
+
+UpdateStats Scene::update(const Accel::BuildOptions& options, float rebuild_threshold)
+{
+    const auto start = std::chrono::steady_clock::now();
+    UpdateStats stats {};
+
+    // Stores are kept in leaf order, so their boxes are already what refit() expects
+    auto refresh = [&](Accel::BVH& bvh, const std::vector<AABB>& bounds, auto&& rebuild) {
+        if (bvh.refit(bounds) > rebuild_threshold * bvh.get_build_cost())
+        {
+            rebuild();
+            ++stats.rebuilds;
+        }
+        else
+        {
+            ++stats.refits;
+        }
+    };
+
+    if (spheres_moved)
+    {
+        refresh(sphere_bvh, spheres.all_bounds(), [&] { build_spheres(options); });
+        spheres_moved = false;
+    }
+
+    for (uint32_t id = 0; id < meshes.size(); ++id)
+    {
+        Mesh& mesh = meshes[id];
+        if (mesh.moved && !mesh.lazy.empty())
+        {
+            // Most of a lazy tree may not exist yet, and its top is cheap to rebuild
+            build_mesh_lazy(id, options);
+            ++stats.rebuilds;
+            mesh.moved = false;
+            instances_moved = true;
+        }
+        else if (mesh.moved)
+        {
+            refresh(mesh.bvh, mesh.triangles.all_bounds(), [&] { build_mesh(id, options); });
+            mesh.moved = false;
+            instances_moved = true;  // the boxes of its instances changed too
+        }
+    }
+
+    if (instances_moved)
+    {
+        const std::vector<uint32_t>& order = instance_bvh.get_indices();
+        std::vector<AABB> bounds(order.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            bounds[i] = instance_bounds(instances[order[i]]);
+        }
+        refresh(instance_bvh, bounds, [&] { build_instances(options); });
+        instances_moved = false;
+    }
+
+    stats.update_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+bool Scene::trace_instances(const Ray& ray, RT::Trace& closest) const
+{
+    const std::vector<uint32_t>& order = instance_bvh.get_indices();
+    return instance_bvh.traverse(ray, closest.t, [&](uint32_t first, uint32_t count, float& t_max) {
+        bool hit { false };
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            const Instance& instance = instances[order[i]];
+            const Mesh& mesh = meshes[instance.mesh];
+
+            // The object-space ray keeps its length, so distances need no conversion
+            const Ray local = instance.world_to_object.apply(ray);
+            uint32_t triangle {};
+            bool found { false };
+            if (!mesh.bricks.empty())
+            {
+                found = mesh.bricks.hit(local, t_max, triangle);
+            }
+            else if (!mesh.wide.empty())
+            {
+                found = mesh.wide.traverse(local, t_max, [&](uint32_t leaf_first, uint32_t leaf_count, float& t) {
+                    return mesh.packed.hit(leaf_first, leaf_count, local, t, triangle);
+                });
+            }
+            else
+            {
+                auto leaf = [&](uint32_t leaf_first, uint32_t leaf_count, float& t) {
+                    return mesh.triangles.hit(leaf_first, leaf_count, local, t, triangle);
+                };
+                found = mesh.lazy.empty() ? mesh.bvh.traverse(local, t_max, leaf) : mesh.lazy.traverse(local, t_max, leaf);
+            }
+            if (found)
+            {
+                closest.primitive = triangle;
+                closest.instance = order[i];
+                closest.kind = RT::PrimitiveKind::Triangle;
+                hit = true;
+            }
+        }
+        return hit;
+    });
+}
+
+bool Scene::instances_occluded(const Ray& ray, float t_max) const
+{
+    const std::vector<uint32_t>& order = instance_bvh.get_indices();
+    return instance_bvh.traverse_any(ray, t_max, [&](uint32_t first, uint32_t count) {
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            const Instance& instance = instances[order[i]];
+            const Mesh& mesh = meshes[instance.mesh];
+            const Ray local = instance.world_to_object.apply(ray);
+            if (!mesh.bricks.empty())
+            {
+                if (mesh.bricks.occluded(local, t_max))
+                {
+                    return true;
+                }
+                continue;
+            }
+            if (!mesh.wide.empty())
+            {
+                if (mesh.wide.traverse_any(local, t_max, [&](uint32_t leaf_first, uint32_t leaf_count) {
+                        return mesh.packed.occluded(leaf_first, leaf_count, local, t_max);
+                    }))
+                {
+                    return true;
+                }
+                continue;
+            }
+
+            auto leaf = [&](uint32_t leaf_first, uint32_t leaf_count) {
+                return mesh.triangles.occluded(leaf_first, leaf_count, local, t_max);
+            };
+            if (mesh.lazy.empty() ? mesh.bvh.traverse_any(local, t_max, leaf) : mesh.lazy.traverse_any(local, t_max, leaf))
+            {
+                return true;
+            }
+        }
+        return false;
+    });
+}
+
+RT::Trace Scene::trace(const Ray& ray) const
+{
+    RT::Trace closest {};
+
+    uint32_t sphere {};
+    if (sphere_bvh.traverse(ray, closest.t, [&](uint32_t first, uint32_t count, float& t_max) {
+            return spheres.hit(first, count, ray, t_max, sphere);
+        }))
+    {
+        closest.primitive = sphere;
+        closest.kind = RT::PrimitiveKind::Sphere;
+    }
+
+    trace_instances(ray, closest);
+
+    for (uint32_t id = 0; id < plane_count(); ++id)
+    {
+        if (get_plane(id).hit(ray, closest.t))
+        {
+            closest.primitive = id;
+            closest.kind = RT::PrimitiveKind::Plane;
+        }
+    }
+
+    return closest;
+}
+
+void Scene::trace(const RayPacket8& rays, RT::Trace* hits) const
+{
+    float closest_t[RayPacket8::size];
+    std::fill(closest_t, closest_t + RayPacket8::size, std::numeric_limits<float>::max());
+    std::fill(hits, hits + RayPacket8::size, RT::Trace {});
+
+    auto assign = [&](uint32_t mask, RT::PrimitiveKind kind, uint32_t id) {
+        for (size_t lane = 0; lane < RayPacket8::size; ++lane)
+        {
+            if (mask & (1u << lane))
+            {
+                hits[lane].primitive = id;
+                hits[lane].kind = kind;
+            }
+        }
+    };
+
+    // Leaves hold contiguous ranges of spheres, tested one sphere against the whole packet
+    sphere_bvh.traverse(rays, closest_t, [&](uint32_t first, uint32_t count, uint32_t, float* t_max) {
+        uint32_t mask = 0;
+        for (uint32_t id = first; id < first + count; ++id)
+        {
+            uint32_t hit = get_sphere(id).hit(rays, t_max);
+            assign(hit, RT::PrimitiveKind::Sphere, id);
+            mask |= hit;
+        }
+        return mask;
+    });
+
+    // Mesh leaves batch triangles instead of rays, and every instance has its
+    // own object space, so each lane walks the instances on its own
+    for (size_t lane = 0; lane < RayPacket8::size; ++lane)
+    {
+        RT::Trace closest = hits[lane];
+        closest.t = closest_t[lane];
+        if (trace_instances(rays.get(lane), closest))
+        {
+            hits[lane] = closest;
+            closest_t[lane] = closest.t;
+        }
+    }
+
+    for (uint32_t id = 0; id < plane_count(); ++id)
+    {
+        assign(get_plane(id).hit(rays, closest_t), RT::PrimitiveKind::Plane, id);
+    }
+
+    for (size_t lane = 0; lane < RayPacket8::size; ++lane)
+    {
+        hits[lane].t = closest_t[lane];
+    }
+}
+
+bool Scene::occluded(const Ray& ray, float t_max) const
+{
+    // Planes are few and need no traversal, so they go first
+    for (uint32_t id = 0; id < plane_count(); ++id)
+    {
+        float t = t_max;
+        if (get_plane(id).hit(ray, t))
+        {
+            return true;
+        }
+    }
+
+    if (sphere_bvh.traverse_any(ray, t_max, [&](uint32_t first, uint32_t count) {
+            return spheres.occluded(first, count, ray, t_max);
+        }))
+    {
+        return true;
+    }
+
+    return instances_occluded(ray, t_max);
+}
+
+RT::SurfaceInteraction Scene::interact(const Ray& ray, const RT::Trace& hit) const
+{
+    RT::SurfaceInteraction surface {};
+    surface.position = ray.at(hit.t);
+
+    switch (hit.kind)
+    {
+    case RT::PrimitiveKind::Sphere:
+        surface.normal = get_sphere(hit.primitive).normal_at(surface.position);
+        surface.material = sphere_materials[hit.primitive];
+        break;
+    case RT::PrimitiveKind::Plane:
+        surface.normal = get_plane(hit.primitive).normal_at(surface.position);
+        surface.material = planes.material[hit.primitive];
+        break;
+    case RT::PrimitiveKind::Triangle:
+    {
+        const Instance& instance = instances[hit.instance];
+        const Mesh& mesh = meshes[instance.mesh];
+        if (!mesh.bricks.empty())
+        {
+            Vector normal {};
+            mesh.bricks.get_surface(hit.primitive, normal, surface.material);
+            surface.normal = instance.world_to_object.apply_transposed(normal).normalized();
+            break;
+        }
+        const bool packed = !mesh.wide.empty();
+        const Vector normal = packed ? mesh.packed.get_normal(hit.primitive) : mesh.triangles.get_normal(hit.primitive);
+        surface.normal = instance.world_to_object.apply_transposed(normal).normalized();
+        surface.material = mesh.face_materials[packed ? mesh.packed.get_face(hit.primitive) : mesh.triangles.get_face(hit.primitive)];
+        break;
+    }
+    case RT::PrimitiveKind::None:
+        break;
+    }
+
+    return surface;
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../accel/bvh.h"
+#include "../accel/lazy_bvh.h"
+#include "../accel/wide_bvh.h"
+#include "../geometry/geometry.h"
+#include "../geometry/quantized_triangle_store.h"
+#include "../geometry/sphere_store.h"
+#include "../geometry/triangle_store.h"
+#include "../lib/point.h"
+#include "../lib/ray.h"
+#include "../lib/ray_packet.h"
+#include "../lib/span.h"
+#include "../lib/transform.h"
+#include "../lib/vector.h"
+#include "../raytracer/trace.h"
+#include "brick_mesh.h"
+
+struct Material
+{
+    Vector color {};         // diffuse (Kd)
+    Vector specular {};      // Ks
+    Vector emission {};      // Ke
+    float shininess {};      // Ns
+    float ior { 1.0f };      // Ni
+    float opacity { 1.0f };  // d
+};
+
+// Point light; the light reaching a surface falls off with the squared distance.
+struct Light
+{
+    Point position {};
+    Vector intensity {};
+};
+
+// Camera placement and image size.
+struct View
+{
+    Point position { 0.0f, 0.0f, 5.0f };
+    Point look_at {};
+    Vector up { 0.0f, 1.0f, 0.0f };
+    float vertical_fov { 90.0f };  // degrees
+    uint32_t width { 500 };
+    uint32_t height { 500 };
+};
+
+// Work done by Scene::update() for one frame.
+struct UpdateStats
+{
+    double update_ms {};
+    uint32_t refits {};    // hierarchies whose boxes were refitted
+    uint32_t rebuilds {};  // hierarchies rebuilt because refitting left them too slow
+};
+
+// Everything that can be hit, one structure-of-arrays buffer per primitive
+// kind. Primitives and materials are referred to by index: a primitive's
+// material is an index into the material list, and RT::Trace::primitive is an
+// index into the arrays of its kind (for triangles, into the mesh of the
+// instance named by RT::Trace::instance).
+//
+// Meshes are not placed in the scene directly. Each one is a bottom-level
+// BVH in its own object space, built once, and instances place it with a
+// transform; a top-level BVH over the instances' world bounds decides which
+// of them a ray enters. A thousand copies of a mesh cost a thousand
+// transforms, not a thousand copies of its triangles.
+class Scene
+{
+private:
+    struct PlaneArrays
+    {
+        std::vector<float> px {}, py {}, pz {}, nx {}, ny {}, nz {};
+        std::vector<uint32_t> material {};
+    };
+
+    struct Mesh
+    {
+        Geometry::TriangleStore triangles {};
+        Accel::BVH bvh {};
+        Accel::LazyBVH lazy {};                   // used instead of bvh when not empty
+        std::vector<uint32_t> face_materials {};  // indexed by TriangleStore::get_face()
+        bool moved {};                            // vertices changed since the last update()
+
+        // Compressed form, replacing triangles and bvh when wide is not empty
+        Geometry::QuantizedTriangleStore packed {};
+        Accel::WideBVH wide {};
+
+        // Out-of-core form, replacing all of the above when not empty
+        BrickMesh bricks {};
+    };
+
+    struct Instance
+    {
+        uint32_t mesh {};
+        Transform object_to_world {};
+        Transform world_to_object {};
+    };
+
+    std::vector<Material> materials {};
+    std::vector<Light> lights {};
+    Geometry::SphereStore spheres {};
+    std::vector<uint32_t> sphere_materials {};
+    std::vector<uint32_t> sphere_slots {};  // add_sphere() id -> position in spheres, which follows the BVH
+    PlaneArrays planes {};
+    std::vector<Mesh> meshes {};
+    std::vector<Instance> instances {};
+    BrickCache brick_cache {};
+
+    // Spheres are bounded and live in a BVH whose leaves are tested 8 spheres
+    // at a time; planes are infinite and are tested one by one.
+    Accel::BVH sphere_bvh {};
+    Accel::BVH instance_bvh {};
+    bool spheres_moved {}, instances_moved {};
+
+    AABB instance_bounds(const Instance& instance) const;
+
+    // Walks the instances the ray enters, in each one's object space.
+    bool trace_instances(const Ray& ray, RT::Trace& closest) const;
+    bool instances_occluded(const Ray& ray, float t_max) const;
+
+public:
+    View view {};
+    Vector ambient {};  // light reaching every surface regardless of the lights
+
+    Scene() = default;
+    ~Scene() = default;
+
+    // Lazy meshes finish building while the scene is traced, in place
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    uint32_t add_material(const Material& material);
+    uint32_t add_light(const Light& light);
+    uint32_t add_sphere(const Point& center, float radius, uint32_t material);
+
+    // Appends a sphere soup given as interleaved x, y, z, radius records, all
+    // with the same material (e.g. the records of a point-radius file).
+    void add_spheres(Span<const float> xyzr, uint32_t material);
+    uint32_t add_plane(const Point& point, const Vector& normal, uint32_t material);
+
+    // indices holds three vertex indices per face and face_materials one
+    // material per face. Returns the mesh id; its BVH is empty until
+    // build_mesh() or assign_mesh_bvh(), and it is not visible until an
+    // instance places it.
+    uint32_t add_mesh(Span<const Point> vertices, Span<const uint32_t> indices, Span<const uint32_t> face_materials);
+
+    // Places mesh in the world. Returns the instance id, or UINT32_MAX if the
+    // transform is singular.
+    uint32_t add_instance(uint32_t mesh, const Transform& object_to_world);
+
+    Accel::BuildStats build_spheres(const Accel::BuildOptions& options);
+    Accel::BuildStats build_mesh(uint32_t mesh, const Accel::BuildOptions& options);
+
+    // Builds only the top of the mesh's hierarchy; the rest is built as rays
+    // reach it (see Accel::LazyBVH). Cheaper when most of a large mesh is
+    // never seen, e.g. one view of a huge scan. The stats are the top tree's.
+    Accel::BuildStats build_mesh_lazy(uint32_t mesh, const Accel::BuildOptions& options);
+
+    // Adopts a hierarchy saved from an earlier build_mesh() of the same mesh.
+    // Returns false, leaving the mesh untouched, if it does not fit.
+    bool assign_mesh_bvh(uint32_t mesh, std::vector<Accel::BVHNode> nodes, std::vector<uint32_t> indices);
+
+    // Swaps a built mesh for its compressed form: vertices on a 16-bit grid
+    // and an eight-wide BVH with 8-bit child boxes (see
+    // Geometry::QuantizedTriangleStore and Accel::WideBVH), several times
+    // smaller. vertices and indices must be the ones given to add_mesh().
+    // Compressed meshes cannot be animated. Returns false, leaving the mesh
+    // as it was, if it has no (complete) BVH yet or cannot be compressed.
+    bool compress_mesh(uint32_t mesh, Span<const Point> vertices, Span<const uint32_t> indices);
+
+    // Adds a mesh kept on disk: the brick section written by
+    // BrickMesh::write() at offset of path, whose bricks are read back
+    // through a cache shared by the scene's brick meshes (see
+    // set_brick_budget()). Its materials are shifted by material_base. The
+    // mesh needs no build and cannot be animated or compressed. Returns the
+    // mesh id, or UINT32_MAX if the section is not valid.
+    uint32_t add_brick_mesh(const std::string& path, uint64_t offset, uint32_t material_base);
+
+    // Bytes the resident bricks may take before the least recently used
+    // are dropped (BrickCache::default_budget until set).
+    void set_brick_budget(size_t bytes) { brick_cache.set_budget(bytes); }
+    BrickCacheStats get_brick_stats() const { return brick_cache.get_stats(); }
+
+    // Heap bytes held by a mesh's triangles, hierarchy and materials.
+    size_t mesh_memory(uint32_t mesh) const;
+
+    // Top-level BVH over the instances; call after every mesh has its BVH.
+    Accel::BuildStats build_instances(const Accel::BuildOptions& options);
+
+    // Animation, for scenes rendered as a sequence of frames. The setters
+    // only record the change (ids are the ones returned when adding); once a
+    // frame's changes are in, update() brings the hierarchies they touched
+    // up to date. A refit keeps the tree and only moves its boxes, which is
+    // far cheaper than a build but leaves the tree worse as things drift
+    // apart. A tree is rebuilt instead once its SAH cost after the refit
+    // exceeds rebuild_threshold times its cost when last built.
+    void set_sphere(uint32_t id, const Point& center, float radius);
+    bool set_instance_transform(uint32_t instance, const Transform& object_to_world);
+
+    // indices must be the list given to add_mesh(); only the vertices move.
+    bool set_mesh_vertices(uint32_t mesh, Span<const Point> vertices, Span<const uint32_t> indices);
+
+    UpdateStats update(const Accel::BuildOptions& options, float rebuild_threshold);
+
+    size_t material_count() const { return materials.size(); }
+    size_t light_count() const { return lights.size(); }
+    size_t sphere_count() const { return spheres.size(); }
+    size_t plane_count() const { return planes.nx.size(); }
+    size_t mesh_count() const { return meshes.size(); }
+    size_t instance_count() const { return instances.size(); }
+    size_t triangle_count(uint32_t mesh) const
+    {
+        const Mesh& m = meshes[mesh];
+        return !m.bricks.empty() ? m.bricks.triangle_count() : m.wide.empty() ? m.triangles.size() : m.packed.size();
+    }
+
+    const Material& get_material(uint32_t id) const { return materials[id]; }
+    const Light& get_light(uint32_t id) const { return lights[id]; }
+    const Accel::BVH& get_mesh_bvh(uint32_t mesh) const { return meshes[mesh].bvh; }
+    const Accel::LazyBVH& get_mesh_lazy_bvh(uint32_t mesh) const { return meshes[mesh].lazy; }
+    const BrickMesh& get_mesh_bricks(uint32_t mesh) const { return meshes[mesh].bricks; }
+
+    Geometry::Sphere get_sphere(uint32_t id) const { return spheres.get(id); }
+
+    Geometry::Plane get_plane(uint32_t id) const
+    {
+        return Geometry::Plane { Point { planes.px[id], planes.py[id], planes.pz[id] },
+                                 Vector { planes.nx[id], planes.ny[id], planes.nz[id] } };
+    }
+
+    // Closest hit along the ray; only the distance and the primitive.
+    RT::Trace trace(const Ray& ray) const;
+
+    // Packet version: fills one trace per lane.
+    void trace(const RayPacket8& rays, RT::Trace* hits) const;
+
+    // Shadow-ray query: true as soon as anything is hit before t_max.
+    bool occluded(const Ray& ray, float t_max) const;
+
+    // Position, normal and material of a hit returned by trace().
+    RT::SurfaceInteraction interact(const Ray& ray, const RT::Trace& hit) const;
+};
@@ -0,0 +1,233 @@
+#ifndef BRICKFILEHEADER
+#define BRICKFILEHEADER
+
+/*
+Arquivo de malhas fora da memória (--out-of-core), gravado ao lado do .obj com a extensão .rtbricks.
+
+Cada grupo ("o"/"g") do .obj é dividido no espaço em tijolos de uns 16 mil triângulos, cada um com a
+sua própria BVH já construída (ver src/scene/brick_mesh.h). Na renderização só o topo da árvore e o
+índice dos tijolos ficam na memória: um tijolo é lido do disco quando um raio chega nele e descartado
+(os usados há mais tempo primeiro) quando os tijolos carregados passam do orçamento de memória.
+
+Gravar o arquivo exige ler o .obj (ou o cache .rtmesh dele) inteiro uma vez. Depois disso o .obj não
+é mais lido enquanto ele e o .mtl não mudarem, com as mesmas regras do cache .rtmesh (ver MeshCache.cpp).
+
+Layout: brickFileHeader, o caminho do .mtl, os materiais (cachedMaterial), os nomes dos grupos
+separados por '\0', um brickFileGroup por grupo e, depois, a seção de tijolos de cada grupo, no
+formato de BrickMesh::write.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../accel/bvh.h"
+#include "../lib/span.h"
+#include "../scene/brick_mesh.h"
+#include "ColorMap.cpp"
+#include "MeshCache.cpp"
+#include "ObjReader.cpp"
+#include "TextParser.cpp"
+
+struct brickFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+    uint64_t mtlSize;
+    int64_t mtlTime;
+    uint64_t mtlPathLength;
+    uint64_t materialCount;
+    uint64_t groupCount;
+    uint64_t groupNamesLength;
+};
+
+// Grupo gravado no arquivo: onde começa a seção de tijolos dele
+struct brickFileGroup {
+    uint64_t section;
+    uint64_t faceCount;
+};
+
+// O que é preciso para colocar as malhas no Scene sem ler o .obj
+struct brickFileData {
+    std::vector<MaterialProperties> materials;  // indexados pelo id de material das faces (0 = padrão)
+    std::vector<std::string> groupNames;
+    std::vector<uint64_t> sections;             // posição da seção de tijolos de cada grupo
+};
+
+class brickFile {
+
+public:
+    static constexpr uint32_t version = 2;
+
+    static std::string pathFor(const std::string& objPath) {
+        return meshCache::pathFor(objPath, ".rtbricks");
+    }
+
+    // Lê o cabeçalho do arquivo de objPath, se existir e ainda valer para o .obj e o .mtl atuais
+    static bool read(const std::string& objPath, brickFileData& data) {
+        const std::string path = pathFor(objPath);
+        std::error_code error;
+        uint64_t remaining = std::filesystem::file_size(path, error);
+        std::ifstream in(path, std::ios::binary);
+        if (error || !in.is_open()) {
+            return false;
+        }
+
+        auto section = [&](void* out, uint64_t bytes) {
+            if (bytes > remaining) {
+                return false;
+            }
+            remaining -= bytes;
+            return bytes == 0 || static_cast<bool>(in.read(static_cast<char*>(out), static_cast<std::streamsize>(bytes)));
+        };
+
+        brickFileHeader header;
+        if (!section(&header, sizeof(header)) || std::memcmp(header.magic, "RTBRICKS", 8) != 0 ||
+            header.version != version || header.byteOrder != meshCache::byteOrderMark) {
+            return false;
+        }
+
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        if (!meshCache::fileStamp(objPath, sourceSize, sourceTime) || sourceSize != header.sourceSize) {
+            return false;
+        }
+        if (sourceTime != header.sourceTime) {
+            mappedFile source(objPath);
+            if (!source.is_open() || meshCache::contentHash(source) != header.sourceHash) {
+                return false;
+            }
+        }
+
+        // Os tamanhos são conferidos com o que resta do arquivo antes de alocar qualquer lista
+        if (header.mtlPathLength > remaining || header.groupNamesLength > remaining ||
+            header.materialCount > remaining / sizeof(cachedMaterial) ||
+            header.groupCount > remaining / sizeof(brickFileGroup)) {
+            return false;
+        }
+
+        std::string mtlPath(header.mtlPathLength, '\0');
+        std::vector<cachedMaterial> materials(header.materialCount);
+        std::string names(header.groupNamesLength, '\0');
+        std::vector<brickFileGroup> groups(header.groupCount);
+        if (!section(mtlPath.data(), mtlPath.size()) ||
+            !section(materials.data(), materials.size() * sizeof(cachedMaterial)) ||
+            !section(names.data(), names.size()) || !section(groups.data(), groups.size() * sizeof(brickFileGroup))) {
+            return false;
+        }
+
+        if (!mtlPath.empty()) {
+            uint64_t mtlSize;
+            int64_t mtlTime;
+            if (!meshCache::fileStamp(mtlPath, mtlSize, mtlTime) || mtlSize != header.mtlSize || mtlTime != header.mtlTime) {
+                return false;
+            }
+        }
+
+        data.groupNames = meshCache::splitNames(names);
+        if (data.groupNames.size() != groups.size()) {
+            return false;
+        }
+        data.sections.clear();
+        for (const auto& group : groups) {
+            data.sections.push_back(group.section);
+        }
+        data.materials.clear();
+        for (const auto& m : materials) {
+            data.materials.push_back(meshCache::fromCached(m));
+        }
+        return true;
+    }
+
+    // Grava o arquivo de objPath a partir do .obj já lido em obj. Como no cache .rtmesh, o arquivo
+    // é escrito com outro nome e renomeado no fim.
+    static bool write(const std::string& objPath, const objReader& obj, const Accel::BuildOptions& options) {
+        brickFileHeader header {};
+        std::memcpy(header.magic, "RTBRICKS", 8);
+        header.version = version;
+        header.byteOrder = meshCache::byteOrderMark;
+
+        mappedFile source(objPath);
+        if (!source.is_open() || !meshCache::fileStamp(objPath, header.sourceSize, header.sourceTime)) {
+            return false;
+        }
+        header.sourceHash = meshCache::contentHash(source);
+        const std::string& mtlPath = obj.getMtlPath();
+        if (!mtlPath.empty() && !meshCache::fileStamp(mtlPath, header.mtlSize, header.mtlTime)) {
+            return false;
+        }
+
+        std::vector<cachedMaterial> materials;
+        for (const auto& material : obj.getMaterials()) {
+            materials.push_back(meshCache::toCached(material));
+        }
+        std::string names;
+        for (const auto& group : obj.getGroups()) {
+            names += group.name;
+            names += '\0';
+        }
+        std::vector<brickFileGroup> groups(obj.getGroups().size());
+
+        header.mtlPathLength = mtlPath.size();
+        header.materialCount = materials.size();
+        header.groupCount = groups.size();
+        header.groupNamesLength = names.size();
+
+        const std::string path = pathFor(objPath);
+        const std::string temporary = path + ".tmp";
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+
+        auto section = [&](const void* bytes, size_t size) {
+            out.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(size));
+        };
+        section(&header, sizeof(header));
+        section(mtlPath.data(), mtlPath.size());
+        section(materials.data(), materials.size() * sizeof(cachedMaterial));
+        section(names.data(), names.size());
+        const std::streampos groupTable = out.tellp();
+        section(groups.data(), groups.size() * sizeof(brickFileGroup));
+
+        // Os ids de material das faces ficam os do .obj; o Scene soma a posição dos materiais dele
+        const std::vector<uint32_t> indices = obj.getIndices();
+        std::vector<uint32_t> faceMaterials;
+        faceMaterials.reserve(obj.getFaces().size());
+        for (const auto& face : obj.getFaces()) {
+            faceMaterials.push_back(face.material);
+        }
+
+        bool written = static_cast<bool>(out);
+        Span<const meshGroup> objGroups = obj.getGroups();
+        for (size_t g = 0; g < objGroups.size() && written; ++g) {
+            groups[g].section = static_cast<uint64_t>(out.tellp());
+            groups[g].faceCount = objGroups[g].faceCount;
+            written = BrickMesh::write(out, obj.getVertices(),
+                                       Span<const uint32_t>(indices.data() + 3 * objGroups[g].firstFace, 3 * objGroups[g].faceCount),
+                                       Span<const uint32_t>(faceMaterials.data() + objGroups[g].firstFace, objGroups[g].faceCount),
+                                       options);
+        }
+
+        out.seekp(groupTable);
+        section(groups.data(), groups.size() * sizeof(brickFileGroup));
+        out.close();
+        if (!written || !out) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        return !error;
+    }
+};
+
+#endif
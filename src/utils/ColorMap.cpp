@@ -12,18 +12,24 @@ A saber que:
     - ka = Ambiente
     - ns = Brilho
     - ni = Índice de refração
-    - d = Opacidade
+    - d = Opacidade (ou Tr = 1 - d)
 
-A classe precisa ser instânciada passando o caminho do arquivo .mtl correspondente
+Como manda o formato .mtl, um material sem Ni ou d é opaco e tem índice de refração 1.
+
+A classe precisa ser instânciada passando o caminho do arquivo .mtl correspondente. Os materiais ficam numa
+materialTable: uma lista contígua (o índice é o id do material) com busca por nome em tabela hash.
 */
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <string>
-#include <sstream>
-#include <map>
+#include <string_view>
+#include "../lib/span.h"
 #include "../lib/vector.h"
+#include "TextParser.cpp"
 
 using namespace std;
 
@@ -36,86 +42,169 @@ struct MaterialProperties {
     double ni; // Índice de refração
     double d;  // Opacidade
 
-    MaterialProperties() : kd(0, 0, 0), ks(0, 0, 0), ke(0, 0, 0), ka(0, 0, 0), ns(0), ni(0), d(0) {}
+    MaterialProperties() : kd(0, 0, 0), ks(0, 0, 0), ke(0, 0, 0), ka(0, 0, 0), ns(0), ni(1), d(1) {}
+};
+
+// Lista de materiais indexada por id, com busca por nome em uma tabela hash de endereçamento aberto
+class materialTable {
+
+private:
+    vector<MaterialProperties> materials;
+    vector<string> names;
+    vector<uint32_t> slots;     // id + 1 do material em cada posição (0 = vazia); tamanho potência de 2
+
+    static size_t hashName(string_view name) {
+        return std::hash<string_view>()(name);
+    }
+
+    // Posição de name na tabela, ou a posição vazia onde ele entraria
+    size_t slotOf(string_view name) const {
+        const size_t mask = slots.size() - 1;
+        size_t slot = hashName(name) & mask;
+        while (slots[slot] != 0 && names[slots[slot] - 1] != name) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    void rehash(size_t capacity) {
+        slots.assign(capacity, 0);
+        for (uint32_t id = 0; id < names.size(); ++id) {
+            slots[slotOf(names[id])] = id + 1;
+        }
+    }
+
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    // Id do material com esse nome, ou npos
+    uint32_t find(string_view name) const {
+        if (slots.empty()) {
+            return npos;
+        }
+        uint32_t entry = slots[slotOf(name)];
+        return entry == 0 ? npos : entry - 1;
+    }
+
+    // Acrescenta um material (ou substitui o de mesmo nome) e retorna o id dele
+    uint32_t add(string_view name, const MaterialProperties& material) {
+        uint32_t id = find(name);
+        if (id != npos) {
+            materials[id] = material;
+            return id;
+        }
+
+        // Mantém a tabela no máximo meio cheia
+        if (2 * (names.size() + 1) > slots.size()) {
+            rehash(std::max<size_t>(16, 2 * slots.size()));
+        }
+        id = static_cast<uint32_t>(materials.size());
+        materials.push_back(material);
+        names.emplace_back(name);
+        slots[slotOf(name)] = id + 1;
+        return id;
+    }
+
+    size_t size() const { return materials.size(); }
+    const MaterialProperties& operator[](uint32_t id) const { return materials[id]; }
+    const string& getName(uint32_t id) const { return names[id]; }
+    Span<const MaterialProperties> getMaterials() const { return materials; }
 };
 
 class colormap {
 
 public:
-    map<string, MaterialProperties> mp;
+    materialTable table;
 
     //Construtor    
     colormap(){};
     colormap(string input){
 
-        // construtor: lê arquivo cores.mtl e guarda valores RGB associados a cada nome
+        // construtor: lê o arquivo .mtl (mapeado na memória) e guarda as propriedades de cada material
 
-        std::ifstream mtlFile(input);
+        mappedFile mtlFile(input);
 
         if (!mtlFile.is_open()) {
-            std::cerr << "erro abrindo arquivo cores.mtl\n";
+            std::cerr << "erro abrindo arquivo " << input << "\n";
+            return;
         }
 
-        string line, currentMaterial;
+        textCursor cursor(mtlFile.begin(), mtlFile.end());
+        std::string_view name;
+        MaterialProperties material;
+        MaterialProperties* current = nullptr;
 
-        while (std::getline(mtlFile, line)) {
-            std::istringstream iss(line);
-            std::string keyword;
-            iss >> keyword;
+        while (!cursor.at_end()) {
+            std::string_view keyword = cursor.token();
 
             if (keyword == "newmtl") {
-                iss >> currentMaterial;
-                if (!currentMaterial.empty()) {
-                    mp[currentMaterial] = MaterialProperties();
-                }
-            } else if (keyword == "Kd") {
-                double kdR, kdG, kdB;
-                iss >> kdR >> kdG >> kdB;
-                if (!currentMaterial.empty()) {
-                    mp[currentMaterial].kd = Vector(kdR, kdG, kdB);
-                }
-            } else if (keyword == "Ks") {
-                double ksR, ksG, ksB;
-                iss >> ksR >> ksG >> ksB;
-                if (!currentMaterial.empty()) {
-                    mp[currentMaterial].ks = Vector(ksR, ksG, ksB);
+                if (current) {
+                    table.add(name, material);
                 }
-            } else if (keyword == "Ke") {
-                double keR, keG, keB;
-                iss >> keR >> keG >> keB;
-                if (!currentMaterial.empty()) {
-                    mp[currentMaterial].ke = Vector(keR, keG, keB);
+                name = cursor.token();
+                material = MaterialProperties();
+                current = name.empty() ? nullptr : &material;
+            } else if (current) {
+                if (keyword == "Kd") {
+                    current->kd = readVector(cursor);
+                } else if (keyword == "Ks") {
+                    current->ks = readVector(cursor);
+                } else if (keyword == "Ke") {
+                    current->ke = readVector(cursor);
+                } else if (keyword == "Ka") {
+                    current->ka = readVector(cursor);
+                } else if (keyword == "Ns") {
+                    current->ns = readScalar(cursor);
+                } else if (keyword == "Ni") {
+                    current->ni = readScalar(cursor);
+                } else if (keyword == "d") {
+                    current->d = readScalar(cursor);
+                } else if (keyword == "Tr") {
+                    current->d = 1.0 - readScalar(cursor);
                 }
-            } else if (keyword == "Ka") {
-                double kaR, kaG, kaB;
-                iss >> kaR >> kaG >> kaB;
-                if (!currentMaterial.empty()) {
-                    mp[currentMaterial].ka = Vector(kaR, kaG, kaB);
-                }
-            } else if (keyword == "Ns") {
-                iss >> mp[currentMaterial].ns;
-            } else if (keyword == "Ni") {
-                iss >> mp[currentMaterial].ni;
-            } else if (keyword == "d") {
-                iss >> mp[currentMaterial].d;
             }
+
+            cursor.next_line();
         }
+        if (current) {
+            table.add(name, material);
+        }
+    }
+
+    // Lê três números da linha atual (valores ausentes ficam em 0)
+    static Vector readVector(textCursor& cursor){
+        float r = 0, g = 0, b = 0;
+        cursor.read_float(r);
+        cursor.read_float(g);
+        cursor.read_float(b);
+        return Vector(r, g, b);
+    }
+
+    static double readScalar(textCursor& cursor){
+        float value = 0;
+        cursor.read_float(value);
+        return value;
+    }
 
-        mtlFile.close();
+    // Id do material na tabela (materialTable::npos se não existir)
+    uint32_t find(string_view s) const {
+        return table.find(s);
     }
 
-    Vector getColor(string& s){
-        if (mp.find(s) != mp.end()) {
-            return mp[s].kd;
+    Vector getColor(string_view s) const {
+        uint32_t id = table.find(s);
+        if (id != materialTable::npos) {
+            return table[id].kd;
         } else {
             cerr << "Error: cor " << s << " indefinida no arquivo .mtl\n";
             return Vector(0,0,0);
         }
     }
 
-    MaterialProperties getMaterialProperties(string& s){
-        if (mp.find(s) != mp.end()) {
-            return mp[s];
+    MaterialProperties getMaterialProperties(string_view s) const {
+        uint32_t id = table.find(s);
+        if (id != materialTable::npos) {
+            return table[id];
         } else {
             cerr << "Error: Cor " << s << " indefinida no arquivo .mtl\n";
             return MaterialProperties();
@@ -0,0 +1,182 @@
+#ifndef KEYFRAMEREADERHEADER
+#define KEYFRAMEREADERHEADER
+
+/*
+Classe leitora de arquivos de animação (.keys): uma sequência de quadros, cada um com o que muda em
+relação ao anterior numa cena já lida pelo sceneReader.
+
+Cada linha "frame" começa um quadro, e as linhas seguintes valem para ele; o que um quadro não muda
+fica como estava. '#' começa um comentário, e os caminhos são relativos à pasta do arquivo .keys.
+
+    frame
+    camera <x> <y> <z> <alvo x> <alvo y> <alvo z> <up x> <up y> <up z> <fov vertical em graus>
+    instance <n> [translate <x> <y> <z>] [rotate <eixo x> <eixo y> <eixo z> <graus>] [scale <x> <y> <z>]
+                                        nova transformação (a partir da identidade) das cópias colocadas
+                                        pela n-ésima linha "mesh"/"instance" da cena (a primeira é a 0)
+    sphere <n> <cx> <cy> <cz> <raio>    move a n-ésima esfera da cena, na ordem das linhas "sphere" e
+                                        dos registros dos arquivos "spheres" (a primeira é a 0)
+    deform <arquivo.obj> <arquivo.obj do quadro>
+                                        move os pontos de um .obj da cena para os do .obj do quadro, que
+                                        precisa ter a mesma quantidade de pontos; as faces não mudam
+
+O Scene só registra as mudanças; depois de cada quadro, Scene::update() reajusta (ou reconstrói) as
+BVHs afetadas.
+
+Exemplo: inputs/turntable.keys
+*/
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../lib/transform.h"
+#include "../scene/scene.h"
+#include "ObjReader.cpp"
+#include "SceneReader.cpp"
+#include "TextParser.cpp"
+
+class keyframeReader {
+
+private:
+    std::string filename;
+    std::string directory;
+    mappedFile file;
+    textCursor cursor;
+    size_t line = 0;
+    bool pending = false;       // uma linha "frame" foi lida e o quadro dela ainda não foi aplicado
+
+    bool readInstance(Scene& scene, const sceneReader& description) {
+        long id = -1;
+        cursor.skip_blanks();
+        if (!cursor.read_int(id) || id < 0 || static_cast<size_t>(id) >= description.placementCount()) {
+            return false;
+        }
+
+        Transform transform;
+        while (!cursor.at_line_end()) {
+            if (!sceneReader::readTransform(cursor.token(), cursor, transform)) {
+                return false;
+            }
+        }
+
+        if (transform.determinant() == 0.0f) {
+            return false;
+        }
+
+        uint32_t first = 0, count = 0;
+        description.getPlacement(static_cast<size_t>(id), first, count);
+        for (uint32_t instance = first; instance < first + count; ++instance) {
+            scene.set_instance_transform(instance, transform);
+        }
+        return true;
+    }
+
+    bool readSphere(Scene& scene) {
+        long id = -1;
+        Point center;
+        float radius = 0;
+        cursor.skip_blanks();
+        if (!cursor.read_int(id) || id < 0 || static_cast<size_t>(id) >= scene.sphere_count() ||
+            !sceneReader::readPoint(cursor, center) || !cursor.read_float(radius)) {
+            return false;
+        }
+        scene.set_sphere(static_cast<uint32_t>(id), center, radius);
+        return true;
+    }
+
+    bool readDeform(Scene& scene, sceneReader& description, bool useCache, unsigned threads) {
+        std::string_view original = cursor.token();
+        std::string_view moved = cursor.token();
+        size_t id = 0;
+        if (original.empty() || moved.empty() || !description.findObj(directory + std::string(original), id) ||
+            description.isOutOfCore(id)) {
+            return false;
+        }
+
+        objReader& obj = description.getObj(id);
+        objReader frame(directory + std::string(moved), threads, useCache);
+        if (!frame.is_open() || frame.getVertices().size() != obj.getVertices().size()) {
+            return false;
+        }
+
+        const std::vector<uint32_t> indices = obj.getIndices();
+        Span<const meshGroup> groups = obj.getGroups();
+        for (size_t g = 0; g < groups.size(); ++g) {
+            Span<const uint32_t> faces(indices.data() + 3 * groups[g].firstFace, 3 * groups[g].faceCount);
+            if (!scene.set_mesh_vertices(description.getFirstMesh(id) + static_cast<uint32_t>(g), frame.getVertices(), faces)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+public:
+    explicit keyframeReader(const std::string& filename)
+        : filename(filename), directory(filename.substr(0, filename.find_last_of("/\\") + 1)), file(filename),
+          cursor(file.begin(), file.end()) {
+        if (!file.is_open()) {
+            std::cerr << "Erro ao abrir o arquivo: " << filename << std::endl;
+            return;
+        }
+
+        // Tudo antes da primeira linha "frame" é ignorado
+        while (!cursor.at_end()) {
+            ++line;
+            if (!cursor.at_line_end() && cursor.token() == "frame") {
+                cursor.next_line();
+                pending = true;
+                return;
+            }
+            cursor.next_line();
+        }
+    }
+
+    bool is_open() const {
+        return file.is_open();
+    }
+
+    // Aplica à cena as mudanças do próximo quadro. Retorna false quando não há mais quadros.
+    // useCache e threads são repassados ao objReader dos .obj de "deform".
+    bool nextFrame(Scene& scene, sceneReader& description, bool useCache = true, unsigned threads = 0) {
+        if (!pending) {
+            return false;
+        }
+        pending = false;
+
+        while (!cursor.at_end()) {
+            ++line;
+            if (cursor.at_line_end()) {
+                cursor.next_line();
+                continue;
+            }
+
+            std::string_view command = cursor.token();
+            if (command == "frame") {
+                cursor.next_line();
+                pending = true;
+                return true;
+            }
+
+            bool valid = false;
+            if (command == "camera") {
+                valid = sceneReader::readCamera(cursor, scene.view);
+            } else if (command == "instance") {
+                valid = readInstance(scene, description);
+            } else if (command == "sphere") {
+                valid = readSphere(scene);
+            } else if (command == "deform") {
+                valid = readDeform(scene, description, useCache, threads);
+            }
+
+            if (!valid) {
+                std::cerr << filename << ":" << line << ": linha inválida ignorada" << std::endl;
+            }
+            cursor.next_line();
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,430 @@
+#ifndef MESHCACHEHEADER
+#define MESHCACHEHEADER
+
+/*
+Cache binário de malhas lidas de arquivos .obj.
+
+Depois da primeira leitura, o objReader grava ao lado do .obj um arquivo .rtmesh com as listas
+já prontas (pontos, normais, faces com o id do material e a tabela de materiais), os grupos
+("o"/"g") em que as faces se dividem e opcionalmente a BVH construída sobre cada grupo. Nas execuções seguintes o arquivo é mapeado na
+memória e as listas são copiadas em bloco, sem passar pelo parser de texto.
+
+O cache é descartado quando:
+    - a versão do formato ou a ordem dos bytes da máquina não batem;
+    - o tamanho do .obj mudou;
+    - a data de modificação do .obj mudou e o hash do conteúdo inteiro também;
+    - o .mtl usado mudou de tamanho ou de data.
+
+Layout: cabeçalho fixo seguido das seções na ordem de meshCacheHeader, cada uma alinhada em 64 bytes.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../lib/point.h"
+#include "../lib/vector.h"
+#include "ColorMap.cpp"
+#include "TextParser.cpp"
+
+// Nó de BVH no mesmo layout de Accel::BVHNode (caixa min/max + offset + count)
+struct cachedBvhNode {
+    float min[3];
+    float max[3];
+    uint32_t offset;
+    uint32_t count;
+};
+
+// Face gravada no cache, no mesmo layout da Face do objReader
+struct cachedFace {
+    int32_t vertex[3];
+    int32_t normal[3];   // -1 quando a face não tem normal
+    uint32_t material;
+};
+
+// Grupo de faces de um .obj: faces [firstFace, firstFace + faceCount) e a BVH construída sobre
+// elas, com índices relativos a firstFace (vazia se ainda não foi construída)
+struct meshGroup {
+    std::string name;
+    uint64_t firstFace = 0;
+    uint64_t faceCount = 0;
+    std::vector<cachedBvhNode> bvhNodes;
+    std::vector<uint32_t> bvhIndices;
+};
+
+// Grupo gravado no cache; as BVHs dos grupos ficam uma depois da outra, na ordem dos grupos
+struct cachedGroup {
+    uint64_t firstFace;
+    uint64_t faceCount;
+    uint64_t bvhNodeCount;
+    uint64_t bvhIndexCount;
+};
+
+// Material gravado no cache (MaterialProperties sem construtores)
+struct cachedMaterial {
+    float ka[3], kd[3], ks[3], ke[3];
+    double ns, ni, d;
+};
+
+struct meshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+    uint64_t mtlSize;
+    int64_t mtlTime;
+    uint64_t mtlPathLength;
+    uint64_t vertexCount;
+    uint64_t normalCount;
+    uint64_t faceCount;
+    uint64_t materialCount;
+    uint64_t materialNamesLength;
+    uint64_t currentMaterial;
+    uint64_t groupCount;
+    uint64_t groupNamesLength;
+    uint64_t bvhNodeCount;
+    uint64_t bvhIndexCount;
+};
+
+// Conteúdo de um cache: tudo em listas planas
+struct meshCacheData {
+    std::vector<Point> vertices;
+    std::vector<Vector> normals;
+    std::vector<cachedFace> faces;
+    std::vector<MaterialProperties> materials;
+    std::vector<std::string> materialNames;
+    uint32_t currentMaterial = 0;         // material ativo no fim do arquivo
+    std::vector<meshGroup> groups;        // cobrem as faces em ordem, sem buracos
+    std::string mtlPath;                  // .mtl de onde vieram os materiais (vazio se nenhum)
+};
+
+class meshCache {
+
+public:
+    static constexpr uint32_t version = 4;
+    static constexpr uint32_t byteOrderMark = 0x01020304;
+
+    // Caminho do cache de um .obj: mesmo nome, extensão .rtmesh (ou a dada)
+    static std::string pathFor(const std::string& objPath, const char* extension = ".rtmesh") {
+        size_t dot = objPath.find_last_of('.');
+        size_t slash = objPath.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+            return objPath + extension;
+        }
+        return objPath.substr(0, dot) + extension;
+    }
+
+    // Hash FNV-1a do arquivo inteiro (e do tamanho dele), de 8 em 8 bytes. Só é conferido quando
+    // a data do .obj mudou; amostrar o arquivo deixaria passar uma edição do mesmo tamanho (uma
+    // coordenada trocada, por exemplo) fora dos trechos amostrados.
+    static uint64_t contentHash(const mappedFile& file) {
+        uint64_t hash = 1469598103934665603ull;
+        auto mix = [&](uint64_t word) {
+            hash = (hash ^ word) * 1099511628211ull;
+        };
+
+        const size_t size = file.size();
+        mix(size);
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, file.begin() + i, sizeof(word));
+            mix(word);
+        }
+        for (; i < size; ++i) {
+            mix(static_cast<unsigned char>(file.begin()[i]));
+        }
+        return hash;
+    }
+
+    static bool fileStamp(const std::string& path, uint64_t& size, int64_t& time) {
+        std::error_code error;
+        size = std::filesystem::file_size(path, error);
+        if (error) {
+            return false;
+        }
+        time = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+        return !error;
+    }
+
+    static cachedMaterial toCached(const MaterialProperties& m) {
+        return { { m.ka.x, m.ka.y, m.ka.z }, { m.kd.x, m.kd.y, m.kd.z }, { m.ks.x, m.ks.y, m.ks.z },
+                 { m.ke.x, m.ke.y, m.ke.z }, m.ns, m.ni, m.d };
+    }
+
+    static MaterialProperties fromCached(const cachedMaterial& m) {
+        MaterialProperties material;
+        material.ka = Vector(m.ka[0], m.ka[1], m.ka[2]);
+        material.kd = Vector(m.kd[0], m.kd[1], m.kd[2]);
+        material.ks = Vector(m.ks[0], m.ks[1], m.ks[2]);
+        material.ke = Vector(m.ke[0], m.ke[1], m.ke[2]);
+        material.ns = m.ns;
+        material.ni = m.ni;
+        material.d = m.d;
+        return material;
+    }
+
+    // Lê o cache de objPath, se existir e ainda valer para o .obj e o .mtl atuais
+    static bool read(const std::string& objPath, meshCacheData& data) {
+        mappedFile file(pathFor(objPath));
+        if (!file.is_open() || file.size() < sizeof(meshCacheHeader)) {
+            return false;
+        }
+
+        meshCacheHeader header;
+        std::memcpy(&header, file.begin(), sizeof(header));
+        if (std::memcmp(header.magic, "RTMESH\0\0", 8) != 0 || header.version != version ||
+            header.byteOrder != byteOrderMark) {
+            return false;
+        }
+
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        if (!fileStamp(objPath, sourceSize, sourceTime) || sourceSize != header.sourceSize) {
+            return false;
+        }
+        if (sourceTime != header.sourceTime) {
+            mappedFile source(objPath);
+            if (!source.is_open() || contentHash(source) != header.sourceHash) {
+                return false;
+            }
+        }
+
+        size_t offset = align(sizeof(header));
+        auto section = [&](void* out, size_t bytes) {
+            if (offset + bytes > file.size()) {
+                return false;
+            }
+            if (bytes > 0) {
+                std::memcpy(out, file.begin() + offset, bytes);
+            }
+            offset = align(offset + bytes);
+            return true;
+        };
+
+        // Cada lista é conferida com o que resta do arquivo antes de ser alocada, para que um
+        // cache truncado ou corrompido seja só descartado
+        auto fits = [&](uint64_t count, size_t size) {
+            return offset <= file.size() && count <= (file.size() - offset) / size;
+        };
+
+        if (!fits(header.mtlPathLength, 1)) {
+            return false;
+        }
+        data.mtlPath.resize(header.mtlPathLength);
+        if (!section(data.mtlPath.data(), header.mtlPathLength)) {
+            return false;
+        }
+        if (!data.mtlPath.empty()) {
+            uint64_t mtlSize;
+            int64_t mtlTime;
+            if (!fileStamp(data.mtlPath, mtlSize, mtlTime) || mtlSize != header.mtlSize || mtlTime != header.mtlTime) {
+                return false;
+            }
+        }
+
+        if (!fits(header.vertexCount, sizeof(Point)) || !fits(header.normalCount, sizeof(Vector)) ||
+            !fits(header.faceCount, sizeof(cachedFace)) || !fits(header.materialCount, sizeof(cachedMaterial)) ||
+            !fits(header.materialNamesLength, 1) || !fits(header.groupCount, sizeof(cachedGroup)) ||
+            !fits(header.groupNamesLength, 1) || !fits(header.bvhNodeCount, sizeof(cachedBvhNode)) ||
+            !fits(header.bvhIndexCount, sizeof(uint32_t))) {
+            return false;
+        }
+
+        std::vector<cachedMaterial> materials(header.materialCount);
+        std::string names(header.materialNamesLength, '\0');
+        std::vector<cachedGroup> groups(header.groupCount);
+        std::string groupNames(header.groupNamesLength, '\0');
+        std::vector<cachedBvhNode> bvhNodes(header.bvhNodeCount);
+        std::vector<uint32_t> bvhIndices(header.bvhIndexCount);
+        data.vertices.resize(header.vertexCount);
+        data.normals.resize(header.normalCount);
+        data.faces.resize(header.faceCount);
+
+        bool complete = section(data.vertices.data(), data.vertices.size() * sizeof(Point)) &&
+                        section(data.normals.data(), data.normals.size() * sizeof(Vector)) &&
+                        section(data.faces.data(), data.faces.size() * sizeof(cachedFace)) &&
+                        section(materials.data(), materials.size() * sizeof(cachedMaterial)) &&
+                        section(names.data(), names.size()) &&
+                        section(groups.data(), groups.size() * sizeof(cachedGroup)) &&
+                        section(groupNames.data(), groupNames.size()) &&
+                        section(bvhNodes.data(), bvhNodes.size() * sizeof(cachedBvhNode)) &&
+                        section(bvhIndices.data(), bvhIndices.size() * sizeof(uint32_t));
+        if (!complete) {
+            return false;
+        }
+
+        if (header.currentMaterial >= std::max<uint64_t>(1, header.materialCount)) {
+            return false;
+        }
+        data.currentMaterial = static_cast<uint32_t>(header.currentMaterial);
+
+        // Nomes separados por '\0', um por material
+        data.materialNames = splitNames(names);
+        if (data.materialNames.size() != materials.size()) {
+            return false;
+        }
+
+        // Os grupos precisam cobrir as faces em ordem, e as BVHs deles, as listas inteiras
+        std::vector<std::string> groupNameList = splitNames(groupNames);
+        if (groupNameList.size() != groups.size()) {
+            return false;
+        }
+        data.groups.clear();
+        uint64_t face = 0, node = 0, index = 0;
+        for (size_t g = 0; g < groups.size(); ++g) {
+            const cachedGroup& group = groups[g];
+            if (group.firstFace != face || group.faceCount > header.faceCount - face ||
+                group.bvhNodeCount > bvhNodes.size() - node || group.bvhIndexCount > bvhIndices.size() - index) {
+                return false;
+            }
+            meshGroup loaded;
+            loaded.name = groupNameList[g];
+            loaded.firstFace = group.firstFace;
+            loaded.faceCount = group.faceCount;
+            loaded.bvhNodes.assign(bvhNodes.begin() + node, bvhNodes.begin() + node + group.bvhNodeCount);
+            loaded.bvhIndices.assign(bvhIndices.begin() + index, bvhIndices.begin() + index + group.bvhIndexCount);
+            data.groups.push_back(std::move(loaded));
+            face += group.faceCount;
+            node += group.bvhNodeCount;
+            index += group.bvhIndexCount;
+        }
+        if (face != header.faceCount || node != bvhNodes.size() || index != bvhIndices.size()) {
+            return false;
+        }
+        for (const auto& face : data.faces) {
+            if (face.material >= materials.size()) {
+                return false;
+            }
+            for (int k = 0; k < 3; ++k) {
+                if (face.vertex[k] < 0 || static_cast<uint64_t>(face.vertex[k]) >= header.vertexCount ||
+                    face.normal[k] < -1 || (face.normal[k] >= 0 && static_cast<uint64_t>(face.normal[k]) >= header.normalCount)) {
+                    return false;
+                }
+            }
+        }
+
+        data.materials.clear();
+        for (const auto& m : materials) {
+            data.materials.push_back(fromCached(m));
+        }
+        return true;
+    }
+
+    // Grava o cache de objPath. O arquivo é escrito com outro nome e renomeado no fim,
+    // para que uma execução interrompida nunca deixe um cache pela metade.
+    static bool write(const std::string& objPath, const meshCacheData& data) {
+        meshCacheHeader header {};
+        std::memcpy(header.magic, "RTMESH\0\0", 8);
+        header.version = version;
+        header.byteOrder = byteOrderMark;
+
+        mappedFile source(objPath);
+        if (!source.is_open() || !fileStamp(objPath, header.sourceSize, header.sourceTime)) {
+            return false;
+        }
+        header.sourceHash = contentHash(source);
+        if (!data.mtlPath.empty() && !fileStamp(data.mtlPath, header.mtlSize, header.mtlTime)) {
+            return false;
+        }
+
+        header.mtlPathLength = data.mtlPath.size();
+        header.vertexCount = data.vertices.size();
+        header.normalCount = data.normals.size();
+        header.faceCount = data.faces.size();
+        header.materialCount = data.materials.size();
+        header.currentMaterial = data.currentMaterial;
+
+        std::vector<cachedGroup> groups;
+        std::vector<cachedBvhNode> bvhNodes;
+        std::vector<uint32_t> bvhIndices;
+        std::string groupNames;
+        for (const auto& group : data.groups) {
+            groups.push_back({ group.firstFace, group.faceCount, group.bvhNodes.size(), group.bvhIndices.size() });
+            bvhNodes.insert(bvhNodes.end(), group.bvhNodes.begin(), group.bvhNodes.end());
+            bvhIndices.insert(bvhIndices.end(), group.bvhIndices.begin(), group.bvhIndices.end());
+            groupNames += group.name;
+            groupNames += '\0';
+        }
+        header.groupCount = groups.size();
+        header.groupNamesLength = groupNames.size();
+        header.bvhNodeCount = bvhNodes.size();
+        header.bvhIndexCount = bvhIndices.size();
+
+        std::vector<cachedMaterial> materials;
+        for (const auto& m : data.materials) {
+            materials.push_back(toCached(m));
+        }
+
+        std::string names;
+        for (const auto& name : data.materialNames) {
+            names += name;
+            names += '\0';
+        }
+        header.materialNamesLength = names.size();
+
+        const std::string path = pathFor(objPath);
+        const std::string temporary = path + ".tmp";
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+
+        size_t offset = 0;
+        auto section = [&](const void* bytes, size_t size) {
+            out.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(size));
+            static const char padding[64] = {};
+            size_t padded = align(offset + size);
+            out.write(padding, static_cast<std::streamsize>(padded - offset - size));
+            offset = padded;
+        };
+
+        section(&header, sizeof(header));
+        section(data.mtlPath.data(), data.mtlPath.size());
+        section(data.vertices.data(), data.vertices.size() * sizeof(Point));
+        section(data.normals.data(), data.normals.size() * sizeof(Vector));
+        section(data.faces.data(), data.faces.size() * sizeof(cachedFace));
+        section(materials.data(), materials.size() * sizeof(cachedMaterial));
+        section(names.data(), names.size());
+        section(groups.data(), groups.size() * sizeof(cachedGroup));
+        section(groupNames.data(), groupNames.size());
+        section(bvhNodes.data(), bvhNodes.size() * sizeof(cachedBvhNode));
+        section(bvhIndices.data(), bvhIndices.size() * sizeof(uint32_t));
+
+        out.close();
+        if (!out) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        return !error;
+    }
+
+    // Nomes separados (e terminados) por '\0'
+    static std::vector<std::string> splitNames(const std::string& names) {
+        std::vector<std::string> list;
+        for (size_t begin = 0; begin < names.size();) {
+            size_t end = names.find('\0', begin);
+            end = end == std::string::npos ? names.size() : end;
+            list.push_back(names.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        return list;
+    }
+
+private:
+    static size_t align(size_t offset) {
+        return (offset + 63) / 64 * 64;
+    }
+};
+
+#endif
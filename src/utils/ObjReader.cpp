@@ -9,13 +9,27 @@ No arquivo .obj, temos:
     - v = pontos
     - vn = normais
     - vt = texturas
-    - f = faces
+    - f = faces, nas formas "f v", "f v/vt", "f v//vn" e "f v/vt/vn". Índices negativos contam a
+      partir do último ponto lido, e polígonos com mais de 3 pontos são divididos em triângulos (em leque).
+      Faces com um ponto fora da lista (índice 0 ou além do fim) são descartadas, e normais fora da lista
+      são ignoradas; as quantidades aparecem num aviso.
+    - o, g = objetos e grupos: cada linha começa um grupo com o nome dado, e as faces seguintes
+      pertencem a ele. Linhas com o mesmo nome continuam o mesmo grupo, e as faces antes da primeira
+      linha formam um grupo sem nome. Cada grupo vira uma malha separada no Scene.
+
+O arquivo é mapeado na memória e lido sem alocações por linha (ver TextParser.cpp). Depois da primeira
+leitura, o resultado fica num cache binário ao lado do .obj (ver MeshCache.cpp), que é usado enquanto o
+.obj e o .mtl não mudarem.
 
 Nessa classe podem ser obtidas as seguintes informações (por meio dos Getters):
     - Pontos
     - Normais
-    - Lista de faces com seus respectivos pontos
-    - Informações de cor, brilho, opacidade, etc.
+    - Lista de faces com seus respectivos pontos e o id do material, ordenada por grupo
+    - Grupos ("o"/"g"), cada um um intervalo contíguo de faces
+    - Tabela de materiais, com cor, brilho, opacidade, etc.
+
+Os Getters de listas retornam Spans: visões (sem cópia) das listas guardadas aqui, válidas enquanto o
+objReader existir.
 
 Obs: -  Para fins de abstração, as normais de cada ponto são ignoradas e assumimos apenas uma normal para cada face. 
      -  As texturas também são ignoradas.
@@ -24,137 +38,575 @@ Caso sintam necessidade, podem editar a classe para obter mais informações.
 */
 
 
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <string>
-#include <sstream>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 
 #include "../lib/point.h"
+#include "../lib/span.h"
 #include "../lib/vector.h"
 #include "ColorMap.cpp"
+#include "MeshCache.cpp"
+#include "TextParser.cpp"
 
 struct Face {
     int verticeIndice[3];
     int normalIndice[3];
-    Vector ka;
-    Vector kd;
-    Vector ks;
-    Vector ke;
-    double ns;
-    double ni;
-    double d;
+    uint32_t material;      // Índice em getMaterials()
 
     Face() {
         for (int i = 0; i < 3; ++i) {
             verticeIndice[i] = 0;
             normalIndice[i] = 0;
         }
-        ka = Vector();
-        kd = Vector();
-        ks = Vector();
-        ke = Vector();
-        ns = 0.0;
-        ni = 0.0;
-        d = 0.0;
+        material = 0;
     }
 };
 
+// O cache grava as faces em bloco, então os dois layouts precisam ser iguais
+static_assert(sizeof(Face) == sizeof(cachedFace) && std::is_trivially_copyable<Face>::value,
+              "Face e cachedFace precisam ter o mesmo layout");
+
+// Resultado da leitura de um trecho do arquivo. Os índices negativos dependem de quantos
+// pontos/normais vieram antes do trecho, então ficam relativos ao início dele e as posições
+// (face * 3 + canto) são guardadas para corrigir na junção.
+struct objChunk {
+    std::vector<Point> vertices;
+    std::vector<Vector> normals;
+    std::vector<Face> faces;
+    std::vector<size_t> relativeVertices;
+    std::vector<size_t> relativeNormals;
+
+    // Linhas "mtllib"/"usemtl" na ordem em que aparecem, com o número de faces lidas até ali
+    struct MaterialEvent {
+        size_t face;
+        bool library;
+        std::string name;
+    };
+    std::vector<MaterialEvent> events;
+
+    // Linhas "o"/"g", com o número de faces lidas até ali
+    struct GroupEvent {
+        size_t face;
+        std::string name;
+    };
+    std::vector<GroupEvent> groups;
+};
+
 class objReader {
 
 private:
-    std::ifstream file;                         // Arquivo .obj
     std::vector<Point> vertices;                // Lista de pontos
     std::vector<Vector> normals;                 // Lista de normais
     std::vector<Face> faces;                    // Lista de indices de faces
-    std::vector<std::vector<Point>> facePoints; // Lista de pontos das faces
     MaterialProperties curMaterial;             // Material atual
     colormap cmap;                              // Objeto de leitura de arquivos .mtl
 
+    std::string sourcePath;                     // .obj lido
+    std::string mtlPath;                        // Último .mtl carregado (vazio se nenhum)
+    materialTable materials;                    // Materiais usados, na ordem do primeiro "usemtl" (0 = padrão)
+    uint32_t curMaterialId = 0;
+    std::vector<meshGroup> groups;              // Grupos de faces, com a BVH de cada um (se houver)
+    bool cached = false;
+    bool opened = false;
+
+    // Trechos menores que isso não compensam uma thread
+    static constexpr size_t minChunkSize = 1 << 20;
+
+    // Converte um índice do .obj (a partir de 1) para um índice a partir de 0. Índices negativos
+    // contam a partir do fim e, aqui, ficam relativos ao início do trecho. O índice 0 vira -1, e os que
+    // não cabem num int viram INT_MIN, que continua negativo depois da junção; parse() descarta os dois.
+    static int resolveIndex(long index, size_t count) {
+        const long resolved = index < 0 ? static_cast<long>(count) + index : index - 1;
+        return resolved < INT_MIN || resolved > INT_MAX ? INT_MIN : static_cast<int>(resolved);
+    }
+
+    // Indica se os três pontos da face existem
+    static bool validFace(const Face& face, size_t vertexCount) {
+        for (int i = 0; i < 3; ++i) {
+            if (face.verticeIndice[i] < 0 || static_cast<size_t>(face.verticeIndice[i]) >= vertexCount) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Lê os vértices de uma linha "f" e gera uma face por triângulo do leque
+    static void readFace(textCursor& cursor, objChunk& chunk, std::vector<long>& polygon, std::vector<long>& polygonNormals) {
+        polygon.clear();
+        polygonNormals.clear();
+
+        while (!cursor.at_line_end()) {
+            long v = 0, vn = 0;
+            if (!cursor.read_int(v)) {
+                break;
+            }
+            if (cursor.consume('/')) {
+                if (!cursor.consume('/')) {
+                    long vt = 0;
+                    cursor.read_int(vt);
+                    cursor.consume('/');
+                }
+                cursor.read_int(vn);
+            }
+
+            polygon.push_back(v);
+            polygonNormals.push_back(vn);
+        }
+
+        for (size_t k = 1; k + 1 < polygon.size(); ++k) {
+            Face face;
+            const size_t corners[3] = { 0, k, k + 1 };
+            for (int i = 0; i < 3; ++i) {
+                const size_t position = 3 * chunk.faces.size() + i;
+                const long v = polygon[corners[i]];
+                const long vn = polygonNormals[corners[i]];
+
+                face.verticeIndice[i] = resolveIndex(v, chunk.vertices.size());
+                if (v < 0) {
+                    chunk.relativeVertices.push_back(position);
+                }
+
+                face.normalIndice[i] = vn == 0 ? -1 : resolveIndex(vn, chunk.normals.size());
+                if (vn < 0) {
+                    chunk.relativeNormals.push_back(position);
+                }
+            }
+            chunk.faces.push_back(face);
+        }
+    }
+
+    // Executa body(i) para cada trecho, um por thread
+    template <typename Body>
+    static void forEachChunk(size_t count, Body&& body) {
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < count; ++i) {
+            workers.emplace_back([&body, i] { body(i); });
+        }
+        if (count > 0) {
+            body(0);
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Lê as linhas de [begin, end), que começa no início de uma linha
+    static void readChunk(const char* begin, const char* end, objChunk& chunk) {
+        textCursor cursor(begin, end);
+        std::vector<long> polygon, polygonNormals;  // reaproveitados entre as linhas "f"
+
+        while (!cursor.at_end()) {
+            std::string_view prefix = cursor.token();
+
+            if (prefix == "v") {
+                float x = 0, y = 0, z = 0;
+                cursor.read_float(x);
+                cursor.read_float(y);
+                cursor.read_float(z);
+                chunk.vertices.emplace_back(x, y, z);
+            } else if (prefix == "vn") {
+                float x = 0, y = 0, z = 0;
+                cursor.read_float(x);
+                cursor.read_float(y);
+                cursor.read_float(z);
+                chunk.normals.emplace_back(x, y, z);
+            } else if (prefix == "f") {
+                readFace(cursor, chunk, polygon, polygonNormals);
+            } else if (prefix == "mtllib" || prefix == "usemtl") {
+                chunk.events.push_back({ chunk.faces.size(), prefix == "mtllib", std::string(cursor.token()) });
+            } else if (prefix == "o" || prefix == "g") {
+                chunk.groups.push_back({ chunk.faces.size(), std::string(cursor.token()) });
+            }
+
+            cursor.next_line();
+        }
+    }
+
 public:
-    objReader(std::string filename) : cmap(cmap) {
+    // threads = 0 usa std::thread::hardware_concurrency(); useCache = false ignora o cache binário
+    objReader(std::string filename, unsigned threads = 0, bool useCache = true) : sourcePath(filename) {
+
+        if (useCache && readCache()) {
+            return;
+        }
+
+        parse(filename, threads);
+
+        if (useCache && opened && !writeCache()) {
+            std::cerr << "Aviso: não foi possível gravar o cache " << meshCache::pathFor(filename) << std::endl;
+        }
+    }
+
+private:
+    void parse(const std::string& filename, unsigned threads) {
 
-        // Abre o arquivo
-        file.open(filename);
+        // Mapeia o arquivo na memória
+        mappedFile file(filename);
         if (!file.is_open()) {
             std::cerr << "Erro ao abrir o arquivo: " << filename << std::endl;
             return;
         }
+        opened = true;
 
-        // Leitura do arquivo
-        std::string line, mtlfile, colorname, filename_mtl;
-        while (std::getline(file, line)) {
-            std::istringstream iss(line);
-            std::string prefix;
-            iss >> prefix;
-
-            if (prefix == "mtllib") {
-                iss >> filename_mtl;
-                std::string filename_mtl_path = filename.replace(filename.length() - 3, 3, "mtl");
-                cmap = colormap(filename_mtl_path);
-            } else if (prefix == "usemtl") {
-                iss >> colorname;
-                curMaterial = cmap.getMaterialProperties(colorname);
-            } else if (prefix == "v") {
-                double x, y, z;
-                iss >> x >> y >> z;
-                vertices.emplace_back(x, y, z);
-            } else if (prefix == "vn") {
-                double x, y, z;
-                iss >> x >> y >> z;
-                normals.emplace_back(x, y, z);
-            } else if (prefix == "f") {
-                Face face;
-                char slash;
-                for (int i = 0; i < 3; ++i) {
-                    int _;
-                    iss >> face.verticeIndice[i] >> slash >> _ >> slash >> face.normalIndice[i];
-                    face.ka = curMaterial.ka;
-                    face.kd = curMaterial.kd;
-                    face.ks = curMaterial.ks;
-                    face.ke = curMaterial.ke;
-                    face.ns = curMaterial.ns;
-                    face.ni = curMaterial.ni;
-                    face.d = curMaterial.d;
-                    face.verticeIndice[i]--;
-                    face.normalIndice[i]--;
+        // Divide o arquivo em trechos terminados em '\n' e lê cada um em uma thread
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        const size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threads, file.size() / minChunkSize));
+
+        std::vector<const char*> bounds { file.begin() };
+        for (size_t i = 1; i < chunkCount; ++i) {
+            const char* cut = std::max(bounds.back(), file.begin() + i * file.size() / chunkCount);
+            while (cut < file.end() && cut[-1] != '\n') {
+                ++cut;
+            }
+            bounds.push_back(cut);
+        }
+        bounds.push_back(file.end());
+
+        std::vector<objChunk> chunks(chunkCount);
+        forEachChunk(chunkCount, [&](size_t i) { readChunk(bounds[i], bounds[i + 1], chunks[i]); });
+
+        // Soma de prefixos: posição de cada trecho nas listas finais
+        std::vector<size_t> vertexOffset(chunkCount + 1, 0), normalOffset(chunkCount + 1, 0), faceOffset(chunkCount + 1, 0);
+        for (size_t i = 0; i < chunkCount; ++i) {
+            vertexOffset[i + 1] = vertexOffset[i] + chunks[i].vertices.size();
+            normalOffset[i + 1] = normalOffset[i] + chunks[i].normals.size();
+            faceOffset[i + 1] = faceOffset[i] + chunks[i].faces.size();
+        }
+
+        // O material ativo atravessa os trechos: cada um começa com o último "usemtl" dos anteriores
+        std::string directory = filename.substr(0, filename.find_last_of("/\\") + 1);
+        // Cada material do .mtl recebe um id na primeira vez em que é usado. O id 0 é o material
+        // padrão, das faces antes de qualquer "usemtl" ou com um nome que não existe no .mtl.
+        materials = materialTable();
+        materials.add("", curMaterial);
+        std::vector<uint32_t> libraryIds;       // id no .mtl atual -> id em materials
+        std::vector<uint32_t> startMaterial(chunkCount);
+        std::vector<std::vector<uint32_t>> eventMaterial(chunkCount);
+        for (size_t i = 0; i < chunkCount; ++i) {
+            startMaterial[i] = curMaterialId;
+            for (auto& event : chunks[i].events) {
+                if (event.library) {
+                    // O .mtl é procurado na mesma pasta do .obj
+                    mtlPath = directory + event.name;
+                    cmap = colormap(mtlPath);
+                    libraryIds.assign(cmap.table.size(), materialTable::npos);
+                } else {
+                    uint32_t id = cmap.find(event.name);
+                    if (id == materialTable::npos) {
+                        std::cerr << "Error: Cor " << event.name << " indefinida no arquivo .mtl\n";
+                        curMaterialId = 0;
+                    } else {
+                        if (libraryIds[id] == materialTable::npos) {
+                            // Um nome repetido em outro .mtl ganha um id próprio
+                            std::string name = event.name;
+                            while (materials.find(name) != materialTable::npos) {
+                                name = mtlPath + ":" + name;
+                            }
+                            libraryIds[id] = materials.add(name, cmap.table[id]);
+                        }
+                        curMaterialId = libraryIds[id];
+                    }
+                    curMaterial = materials[curMaterialId];
                 }
-                faces.push_back(face);
+                eventMaterial[i].push_back(curMaterialId);
             }
+        }
 
+        // Com um trecho só, as listas dele já são as finais
+        if (chunkCount > 1) {
+            vertices.resize(vertexOffset[chunkCount]);
+            normals.resize(normalOffset[chunkCount]);
+            faces.resize(faceOffset[chunkCount]);
         }
-        for (const auto& face : faces) {
-            std::vector<Point> Points = {
-                vertices[face.verticeIndice[0]],
-                vertices[face.verticeIndice[1]],
-                vertices[face.verticeIndice[2]]
-            };
-            facePoints.push_back(Points);
+
+        // Faces descartadas e normais ignoradas em cada trecho, por terem índices fora das listas
+        std::vector<size_t> badFaces(chunkCount, 0), badNormals(chunkCount, 0);
+        forEachChunk(chunkCount, [&](size_t i) {
+            objChunk& chunk = chunks[i];
+            if (chunkCount > 1) {
+                std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertices.begin() + vertexOffset[i]);
+                std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalOffset[i]);
+            }
+
+            for (size_t position : chunk.relativeVertices) {
+                chunk.faces[position / 3].verticeIndice[position % 3] += static_cast<int>(vertexOffset[i]);
+            }
+            for (size_t position : chunk.relativeNormals) {
+                chunk.faces[position / 3].normalIndice[position % 3] += static_cast<int>(normalOffset[i]);
+            }
+
+            // Só agora os índices negativos apontam para as listas finais e podem ser conferidos
+            for (Face& face : chunk.faces) {
+                if (!validFace(face, vertexOffset[chunkCount])) {
+                    ++badFaces[i];
+                }
+                for (int k = 0; k < 3; ++k) {
+                    int& normal = face.normalIndice[k];
+                    if (normal != -1 && (normal < 0 || static_cast<size_t>(normal) >= normalOffset[chunkCount])) {
+                        normal = -1;
+                        ++badNormals[i];
+                    }
+                }
+            }
+
+            // Aplica o material ativo em cada intervalo de faces entre dois eventos
+            uint32_t material = startMaterial[i];
+            size_t next = 0;
+            for (size_t f = 0; f < chunk.faces.size(); ++f) {
+                while (next < chunk.events.size() && chunk.events[next].face <= f) {
+                    material = eventMaterial[i][next++];
+                }
+                chunk.faces[f].material = material;
+            }
+            if (chunkCount > 1) {
+                std::copy(chunk.faces.begin(), chunk.faces.end(), faces.begin() + faceOffset[i]);
+            }
+        });
+
+        if (chunkCount == 1) {
+            vertices.swap(chunks[0].vertices);
+            normals.swap(chunks[0].normals);
+            faces.swap(chunks[0].faces);
+        }
+
+        std::vector<objChunk::GroupEvent> groupEvents;
+        for (size_t i = 0; i < chunkCount; ++i) {
+            for (auto& event : chunks[i].groups) {
+                groupEvents.push_back({ faceOffset[i] + event.face, std::move(event.name) });
+            }
+        }
+        groupFaces(groupEvents);
+
+        size_t droppedFaces = 0, droppedNormals = 0;
+        for (size_t i = 0; i < chunkCount; ++i) {
+            droppedFaces += badFaces[i];
+            droppedNormals += badNormals[i];
+        }
+        if (droppedFaces > 0) {
+            dropInvalidFaces();
+            std::cerr << "Aviso: " << droppedFaces << " faces de " << filename
+                      << " com pontos fora da lista foram descartadas" << std::endl;
+        }
+        if (droppedNormals > 0) {
+            std::cerr << "Aviso: " << droppedNormals << " índices de normais fora da lista foram ignorados em "
+                      << filename << std::endl;
+        }
+    }
+
+    // Remove as faces com pontos fora da lista (depois de groupFaces, para que as posições das linhas
+    // "o"/"g" ainda contem com elas) e ajusta os intervalos dos grupos, que continuam contíguos
+    void dropInvalidFaces() {
+        std::vector<meshGroup> kept;
+        size_t count = 0;
+        for (meshGroup& group : groups) {
+            const size_t first = count;
+            for (uint64_t f = group.firstFace; f < group.firstFace + group.faceCount; ++f) {
+                if (validFace(faces[f], vertices.size())) {
+                    faces[count++] = faces[f];
+                }
+            }
+            if (count > first) {
+                group.firstFace = first;
+                group.faceCount = count - first;
+                kept.push_back(std::move(group));
+            }
+        }
+        faces.resize(count);
+        groups.swap(kept);
+    }
+
+    // Divide as faces nos grupos das linhas "o"/"g" (em ordem, com a posição em faces) e reordena
+    // as faces para que cada grupo seja um intervalo contíguo, na ordem do primeiro uso do nome.
+    void groupFaces(const std::vector<objChunk::GroupEvent>& events) {
+        std::vector<std::string> names { "" };
+        std::unordered_map<std::string, uint32_t> ids { { "", 0 } };
+        std::vector<uint32_t> faceGroup(faces.size());
+        uint32_t current = 0;
+        size_t next = 0;
+        for (size_t f = 0; f < faces.size(); ++f) {
+            while (next < events.size() && events[next].face <= f) {
+                auto inserted = ids.emplace(events[next++].name, static_cast<uint32_t>(names.size()));
+                if (inserted.second) {
+                    names.push_back(inserted.first->first);
+                }
+                current = inserted.first->second;
+            }
+            faceGroup[f] = current;
+        }
+
+        // Soma de prefixos: primeira face de cada grupo
+        std::vector<uint64_t> first(names.size() + 1, 0);
+        for (uint32_t group : faceGroup) {
+            ++first[group + 1];
+        }
+        for (size_t g = 0; g < names.size(); ++g) {
+            first[g + 1] += first[g];
+        }
+
+        groups.clear();
+        for (size_t g = 0; g < names.size(); ++g) {
+            if (first[g + 1] > first[g]) {
+                meshGroup group;
+                group.name = names[g];
+                group.firstFace = first[g];
+                group.faceCount = first[g + 1] - first[g];
+                groups.push_back(std::move(group));
+            }
+        }
+
+        if (!std::is_sorted(faceGroup.begin(), faceGroup.end())) {
+            std::vector<Face> sorted(faces.size());
+            for (size_t f = 0; f < faces.size(); ++f) {
+                sorted[first[faceGroup[f]]++] = faces[f];
+            }
+            faces.swap(sorted);
+        }
+    }
+
+    meshCacheData cacheData() const {
+        meshCacheData data;
+        data.vertices = vertices;
+        data.normals = normals;
+        data.faces.resize(faces.size());
+        if (!faces.empty()) {
+            std::memcpy(data.faces.data(), faces.data(), faces.size() * sizeof(Face));
+        }
+        for (uint32_t id = 0; id < materials.size(); ++id) {
+            data.materials.push_back(materials[id]);
+            data.materialNames.push_back(materials.getName(id));
+        }
+        data.currentMaterial = curMaterialId;
+        data.groups = groups;
+        data.mtlPath = mtlPath;
+        return data;
+    }
+
+    bool writeCache() const {
+        return meshCache::write(sourcePath, cacheData());
+    }
+
+    bool readCache() {
+        meshCacheData data;
+        if (!meshCache::read(sourcePath, data)) {
+            return false;
+        }
+
+        faces.resize(data.faces.size());
+        if (!faces.empty()) {
+            std::memcpy(static_cast<void*>(faces.data()), data.faces.data(), faces.size() * sizeof(Face));
+        }
+        materials = materialTable();
+        for (size_t id = 0; id < data.materials.size(); ++id) {
+            materials.add(data.materialNames[id], data.materials[id]);
+        }
+        if (materials.size() != data.materials.size()) {
+            return false;
+        }
+
+        vertices.swap(data.vertices);
+        normals.swap(data.normals);
+        groups.swap(data.groups);
+        mtlPath = data.mtlPath;
+        curMaterialId = data.currentMaterial;
+        curMaterial = materials.size() == 0 ? MaterialProperties() : materials[curMaterialId];
+        if (!mtlPath.empty()) {
+            cmap = colormap(mtlPath);
         }
+        cached = true;
+        opened = true;
+        return true;
+    }
+
+public:
+    // Indica se o .obj (ou o cache dele) foi lido
+    bool is_open() const {
+        return opened;
+    }
 
-        file.close();
+    // Indica se a malha veio do cache binário em vez do .obj
+    bool fromCache() const {
+        return cached;
+    }
+
+    // BVH do grupo guardada no cache junto com a malha. Retorna false se o cache não tinha uma.
+    bool getCachedBvh(size_t group, std::vector<cachedBvhNode>& nodes, std::vector<uint32_t>& indices) const {
+        if (groups[group].bvhNodes.empty()) {
+            return false;
+        }
+        nodes = groups[group].bvhNodes;
+        indices = groups[group].bvhIndices;
+        return true;
+    }
+
+    // Guarda a BVH construída sobre as faces do grupo; saveCache() grava no cache
+    void storeBvh(size_t group, std::vector<cachedBvhNode> nodes, std::vector<uint32_t> indices) {
+        groups[group].bvhNodes = std::move(nodes);
+        groups[group].bvhIndices = std::move(indices);
+    }
+
+    // Regrava o cache com as BVHs guardadas
+    bool saveCache() const {
+        return writeCache();
     }
 
     // Getters
 
-    // Método para retornar as coordenadas dos pontos das faces
-    std::vector<std::vector<Point>> getFacePoints() {
-        return facePoints;
+    // Método para retornar os índices dos pontos das faces, três por face, em uma única lista
+    // (é o formato esperado por Geometry::TriangleStore)
+    std::vector<uint32_t> getIndices() const {
+        std::vector<uint32_t> indices;
+        indices.reserve(3 * faces.size());
+        for (const auto& face : faces) {
+            for (int i = 0; i < 3; ++i) {
+                indices.push_back(static_cast<uint32_t>(face.verticeIndice[i]));
+            }
+        }
+        return indices;
     }
 
     /*
-    Retorna uma lista com um struct faces do objeto. Cada face contém:
+    Retorna as faces do objeto. Cada face contém:
         - Índices dos pontos
         - Índices das normais
-        - Cores (ka, kd, ks, ke)
-        - Brilho (ns)
-        - Índice de refração (ni)
-        - Opacidade (d)
+        - Id do material, com as cores (ka, kd, ks, ke), o brilho (ns), o índice de refração (ni)
+          e a opacidade (d) em getMaterials()
     */
-    std::vector<Face> getFaces() {
+    Span<const Face> getFaces() const {
         return faces;
     }
 
+    // Método para retornar os grupos ("o"/"g"), na ordem das faces
+    Span<const meshGroup> getGroups() const {
+        return groups;
+    }
+
+    // Método para retornar a tabela de materiais, indexada por Face::material
+    Span<const MaterialProperties> getMaterials() const {
+        return materials.getMaterials();
+    }
+
+    // Método para retornar o .mtl de onde vieram os materiais (vazio se nenhum)
+    const std::string& getMtlPath() const {
+        return mtlPath;
+    }
+
+    // Método para retornar o id de um material pelo nome (materialTable::npos se não foi usado)
+    uint32_t getMaterialId(std::string_view name) const {
+        return materials.find(name);
+    }
+
     // Método para retornar a cor do material (Coeficiente de difusão)
     Vector getKd() {
         return curMaterial.kd;
@@ -191,18 +643,24 @@ public:
     }
 
     // Método para retornar as coordenadas dos pontos
-    std::vector<Point> getVertices() {
+    Span<const Point> getVertices() const {
         return vertices;
     }
 
+    // Método para retornar as normais
+    Span<const Vector> getNormals() const {
+        return normals;
+    }
+
 
     // Emite um output no terminal para cada face, com seus respectivos pontos (x, y, z)
     void print_faces() {
         int i = 0;
-        for (const auto& face : facePoints) {
+        for (const auto& face : faces) {
             i++;
             std::cout << "Face " << i << ": ";
-            for (const auto& point : face) {
+            for (int k = 0; k < 3; ++k) {
+                const Point& point = vertices[face.verticeIndice[k]];
                 std::cout << "(" << point.x << ", " << point.y << ", " << point.z << ")";;
             }
             std::cout << std::endl;
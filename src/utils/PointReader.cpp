@@ -0,0 +1,83 @@
+#ifndef POINTREADERHEADER
+#define POINTREADERHEADER
+
+/*
+Leitura e escrita de arquivos binários de esferas (ponto + raio), usados para nuvens de partículas e
+moléculas com milhões de esferas.
+
+Formato (.xyzr), na ordem de bytes da máquina:
+    - 8 bytes: "RTXYZR" seguido de dois bytes 0
+    - 8 bytes: número de esferas (uint64)
+    - 16 bytes por esfera: x, y, z, raio (float32)
+
+O arquivo é mapeado na memória e os registros são lidos direto do mapeamento, sem cópia.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "../lib/span.h"
+#include "TextParser.cpp"
+
+class pointReader {
+
+private:
+    static constexpr char magic[8] = { 'R', 'T', 'X', 'Y', 'Z', 'R', 0, 0 };
+    static constexpr size_t headerSize = 16;
+
+    mappedFile file;
+    uint64_t count = 0;
+    bool valid = false;
+
+public:
+    explicit pointReader(const std::string& filename) : file(filename) {
+        if (!file.is_open()) {
+            std::cerr << "Erro ao abrir o arquivo: " << filename << std::endl;
+            return;
+        }
+        if (file.size() < headerSize || std::memcmp(file.begin(), magic, sizeof(magic)) != 0) {
+            std::cerr << "Arquivo de esferas inválido: " << filename << std::endl;
+            return;
+        }
+
+        std::memcpy(&count, file.begin() + sizeof(magic), sizeof(count));
+        if (count > (file.size() - headerSize) / (4 * sizeof(float)) ||
+            file.size() != headerSize + count * 4 * sizeof(float)) {
+            std::cerr << "Arquivo de esferas com tamanho errado: " << filename << std::endl;
+            count = 0;
+            return;
+        }
+        valid = true;
+    }
+
+    bool is_open() const {
+        return valid;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // Registros x, y, z, raio intercalados (4 floats por esfera), válidos enquanto o pointReader existir
+    Span<const float> getRecords() const {
+        return Span<const float>(reinterpret_cast<const float*>(file.begin() + headerSize), 4 * count);
+    }
+
+    // Grava um arquivo .xyzr com os registros dados (4 floats por esfera)
+    static bool write(const std::string& filename, Span<const float> xyzr) {
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+        const uint64_t spheres = xyzr.size() / 4;
+        out.write(magic, sizeof(magic));
+        out.write(reinterpret_cast<const char*>(&spheres), sizeof(spheres));
+        out.write(reinterpret_cast<const char*>(xyzr.data()), static_cast<std::streamsize>(4 * spheres * sizeof(float)));
+        return static_cast<bool>(out);
+    }
+};
+
+#endif
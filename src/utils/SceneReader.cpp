@@ -0,0 +1,431 @@
+#ifndef SCENEREADERHEADER
+#define SCENEREADERHEADER
+
+/*
+Classe leitora de arquivos de descrição de cena (.scene), que preenchem um Scene.
+
+Cada linha é um comando; '#' começa um comentário. Os nomes de materiais valem a partir da linha em
+que são definidos, e os caminhos são relativos à pasta do arquivo .scene.
+
+    material <nome> <propriedade> <valores>...   propriedades: kd r g b, ks r g b, ke r g b, ns x, ni x, d x
+    sphere <cx> <cy> <cz> <raio> <material>
+    spheres <arquivo.xyzr> <material>            esferas de um arquivo binário (ver PointReader.cpp)
+    plane <px> <py> <pz> <nx> <ny> <nz> <material>
+    mesh <arquivo.obj>                            materiais vêm do .mtl do próprio .obj
+    instance <arquivo.obj> [group <nome>] [translate <x> <y> <z>] [rotate <eixo x> <eixo y> <eixo z> <graus>] [scale <x> <y> <z>]
+                                                  mais uma cópia do .obj (ou só do grupo "o"/"g" dado),
+                                                  com as transformações aplicadas na ordem em que aparecem
+    light <x> <y> <z> <r> <g> <b>                 luz pontual (intensidade cai com o quadrado da distância)
+    ambient <r> <g> <b>                           luz ambiente, que chega a todas as superfícies
+    camera <x> <y> <z> <alvo x> <alvo y> <alvo z> <up x> <up y> <up z> <fov vertical em graus>
+    image <largura> <altura>
+
+Cada .obj é lido uma vez só, e cada grupo dele vira uma malha do Scene; "mesh" e "instance" apenas
+colocam cópias dessas malhas (instâncias), então repetir um .obj não repete os triângulos na memória.
+Com outOfCore, as malhas vêm do arquivo .rtbricks do .obj (ver BrickFile.cpp), gravado antes se preciso,
+e ficam no disco.
+
+Exemplos: inputs/default.scene, inputs/instances.scene
+*/
+
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../accel/bvh.h"
+#include "../lib/transform.h"
+#include "../scene/scene.h"
+#include "BrickFile.cpp"
+#include "ObjReader.cpp"
+#include "PointReader.cpp"
+#include "TextParser.cpp"
+
+class sceneReader {
+
+private:
+    // Um .obj lido e as malhas do Scene criadas para ele: uma por grupo, com ids consecutivos.
+    // obj fica nulo quando as malhas vieram do arquivo .rtbricks.
+    struct objFile {
+        std::unique_ptr<objReader> obj;
+        uint32_t firstMesh;
+        std::vector<std::string> groupNames;
+    };
+
+    // Instâncias criadas por uma linha "mesh"/"instance" (uma por grupo colocado), com ids consecutivos
+    struct placement {
+        uint32_t firstInstance;
+        uint32_t count;
+    };
+
+    bool opened = false;
+    bool outOfCore = false;
+    std::vector<objFile> objs;
+    std::unordered_map<std::string, size_t> objIds;     // caminho canônico -> índice em objs
+    std::unordered_map<std::string, uint32_t> materialIds;
+    std::vector<placement> placements;
+
+    static std::string canonicalPath(const std::string& path) {
+        std::error_code error;
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+        return error ? path : canonical.string();
+    }
+
+    bool readMaterialId(textCursor& cursor, uint32_t& id) {
+        auto found = materialIds.find(std::string(cursor.token()));
+        if (found == materialIds.end()) {
+            return false;
+        }
+        id = found->second;
+        return true;
+    }
+
+    bool readMaterial(textCursor& cursor, Scene& scene) {
+        std::string name(cursor.token());
+        if (name.empty()) {
+            return false;
+        }
+
+        Material material;
+        while (!cursor.at_line_end()) {
+            std::string_view property = cursor.token();
+            bool valid = false;
+            if (property == "kd") {
+                valid = readVector(cursor, material.color);
+            } else if (property == "ks") {
+                valid = readVector(cursor, material.specular);
+            } else if (property == "ke") {
+                valid = readVector(cursor, material.emission);
+            } else if (property == "ns") {
+                valid = cursor.read_float(material.shininess);
+            } else if (property == "ni") {
+                valid = cursor.read_float(material.ior);
+            } else if (property == "d") {
+                valid = cursor.read_float(material.opacity);
+            }
+            if (!valid) {
+                return false;
+            }
+        }
+
+        materialIds[name] = scene.add_material(material);
+        return true;
+    }
+
+    // Os materiais de um .obj entram no fim da lista do Scene; o 0 do objReader é o material padrão.
+    // Retorna a posição do primeiro.
+    static uint32_t addMaterials(Scene& scene, Span<const MaterialProperties> materials) {
+        const uint32_t base = static_cast<uint32_t>(scene.material_count());
+        for (size_t m = 0; m < materials.size(); ++m) {
+            Material material;
+            if (m > 0) {
+                const MaterialProperties& properties = materials[m];
+                material.color = properties.kd;
+                material.specular = properties.ks;
+                material.emission = properties.ke;
+                material.shininess = static_cast<float>(properties.ns);
+                material.ior = static_cast<float>(properties.ni);
+                material.opacity = static_cast<float>(properties.d);
+            }
+            scene.add_material(material);
+        }
+        return base;
+    }
+
+    // Lê o .obj na primeira vez em que aparece e cria as malhas dele; retorna o índice em objs
+    bool loadObj(const std::string& path, Scene& scene, bool useCache, unsigned threads, size_t& id) {
+        if (findObj(path, id)) {
+            return true;
+        }
+        if (outOfCore) {
+            return loadBricks(path, scene, useCache, threads, id);
+        }
+
+        auto obj = std::make_unique<objReader>(path, threads, useCache);
+        if (!obj->is_open()) {
+            return false;
+        }
+
+        const uint32_t base = addMaterials(scene, obj->getMaterials());
+        std::vector<uint32_t> faceMaterials;
+        faceMaterials.reserve(obj->getFaces().size());
+        for (const auto& face : obj->getFaces()) {
+            faceMaterials.push_back(base + face.material);
+        }
+
+        // Uma malha por grupo, sobre o intervalo de faces dele
+        const std::vector<uint32_t> indices = obj->getIndices();
+        const uint32_t firstMesh = static_cast<uint32_t>(scene.mesh_count());
+        std::vector<std::string> groupNames;
+        for (const meshGroup& group : obj->getGroups()) {
+            scene.add_mesh(obj->getVertices(), Span<const uint32_t>(indices.data() + 3 * group.firstFace, 3 * group.faceCount),
+                           Span<const uint32_t>(faceMaterials.data() + group.firstFace, group.faceCount));
+            groupNames.push_back(group.name);
+        }
+
+        id = objs.size();
+        objIds[canonicalPath(path)] = id;
+        objs.push_back({ std::move(obj), firstMesh, std::move(groupNames) });
+        return true;
+    }
+
+    // Versão de loadObj para as malhas fora da memória: o .obj só é lido (e o .rtbricks gravado)
+    // quando o .rtbricks não existe ou não vale mais
+    bool loadBricks(const std::string& path, Scene& scene, bool useCache, unsigned threads, size_t& id) {
+        brickFileData data;
+        if (!brickFile::read(path, data)) {
+            objReader obj(path, threads, useCache);
+            if (!obj.is_open()) {
+                return false;
+            }
+            Accel::BuildOptions options;
+            options.threads = threads;
+            if (!brickFile::write(path, obj, options) || !brickFile::read(path, data)) {
+                std::cerr << "Erro: não foi possível gravar " << brickFile::pathFor(path) << std::endl;
+                return false;
+            }
+        }
+
+        const uint32_t base = addMaterials(scene, data.materials);
+        const uint32_t firstMesh = static_cast<uint32_t>(scene.mesh_count());
+        for (uint64_t section : data.sections) {
+            if (scene.add_brick_mesh(brickFile::pathFor(path), section, base) == UINT32_MAX) {
+                std::cerr << "Erro: arquivo " << brickFile::pathFor(path) << " inválido" << std::endl;
+                return false;
+            }
+        }
+
+        id = objs.size();
+        objIds[canonicalPath(path)] = id;
+        objs.push_back({ nullptr, firstMesh, std::move(data.groupNames) });
+        return true;
+    }
+
+    // "mesh" e "instance" (transformed, que aceita grupo e transformações): coloca cópias dos grupos do .obj
+    bool readInstance(textCursor& cursor, Scene& scene, const std::string& directory, bool useCache, unsigned threads,
+                      bool transformed) {
+        std::string_view file = cursor.token();
+        size_t id = 0;
+        if (file.empty() || !loadObj(directory + std::string(file), scene, useCache, threads, id)) {
+            return false;
+        }
+
+        const objFile& loaded = objs[id];
+        const std::vector<std::string>& groups = loaded.groupNames;
+        size_t firstGroup = 0, groupCount = groups.size();
+        Transform transform;
+
+        while (transformed && !cursor.at_line_end()) {
+            std::string_view keyword = cursor.token();
+            bool valid = false;
+            if (keyword == "group") {
+                std::string_view name = cursor.token();
+                for (size_t g = 0; g < groups.size() && !valid; ++g) {
+                    if (groups[g] == name) {
+                        firstGroup = g;
+                        groupCount = 1;
+                        valid = true;
+                    }
+                }
+            } else {
+                valid = readTransform(keyword, cursor, transform);
+            }
+            if (!valid) {
+                return false;
+            }
+        }
+
+        if (transform.determinant() == 0.0f) {
+            return false;
+        }
+        placements.push_back({ static_cast<uint32_t>(scene.instance_count()), static_cast<uint32_t>(groupCount) });
+        for (size_t g = firstGroup; g < firstGroup + groupCount; ++g) {
+            scene.add_instance(loaded.firstMesh + static_cast<uint32_t>(g), transform);
+        }
+        return true;
+    }
+
+public:
+    static bool readPoint(textCursor& cursor, Point& point) {
+        return cursor.read_float(point.x) && cursor.read_float(point.y) && cursor.read_float(point.z);
+    }
+
+    static bool readVector(textCursor& cursor, Vector& vector) {
+        return cursor.read_float(vector.x) && cursor.read_float(vector.y) && cursor.read_float(vector.z);
+    }
+
+    // Resto de uma linha "camera"
+    static bool readCamera(textCursor& cursor, View& view) {
+        return readPoint(cursor, view.position) && readPoint(cursor, view.look_at) && readVector(cursor, view.up) &&
+               cursor.read_float(view.vertical_fov);
+    }
+
+    // Lê os valores de uma transformação ("translate", "rotate" ou "scale", já lida em keyword)
+    // e a aplica depois das que já estão em transform
+    static bool readTransform(std::string_view keyword, textCursor& cursor, Transform& transform) {
+        if (keyword == "translate") {
+            Vector offset;
+            if (!readVector(cursor, offset)) {
+                return false;
+            }
+            transform = Transform::translation(offset) * transform;
+        } else if (keyword == "rotate") {
+            Vector axis;
+            float degrees = 0;
+            if (!readVector(cursor, axis) || !cursor.read_float(degrees) || axis.norm_sqr() <= 0.0f) {
+                return false;
+            }
+            transform = Transform::rotation(axis, degrees) * transform;
+        } else if (keyword == "scale") {
+            Vector factors;
+            if (!readVector(cursor, factors)) {
+                return false;
+            }
+            transform = Transform::scaling(factors) * transform;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // useCache e threads são repassados ao objReader de cada malha; outOfCore deixa as malhas no disco
+    sceneReader(const std::string& filename, Scene& scene, bool useCache = true, unsigned threads = 0, bool outOfCore = false)
+        : outOfCore(outOfCore) {
+        mappedFile file(filename);
+        if (!file.is_open()) {
+            std::cerr << "Erro ao abrir o arquivo: " << filename << std::endl;
+            return;
+        }
+        opened = true;
+
+        const std::string directory = filename.substr(0, filename.find_last_of("/\\") + 1);
+        textCursor cursor(file.begin(), file.end());
+        size_t line = 0;
+
+        while (!cursor.at_end()) {
+            ++line;
+            if (cursor.at_line_end()) {
+                cursor.next_line();
+                continue;
+            }
+
+            std::string_view command = cursor.token();
+            bool valid = false;
+
+            if (command == "material") {
+                valid = readMaterial(cursor, scene);
+            } else if (command == "sphere") {
+                Point center;
+                float radius = 0;
+                uint32_t material = 0;
+                valid = readPoint(cursor, center) && cursor.read_float(radius) && readMaterialId(cursor, material);
+                if (valid) {
+                    scene.add_sphere(center, radius, material);
+                }
+            } else if (command == "spheres") {
+                std::string_view file = cursor.token();
+                uint32_t material = 0;
+                valid = !file.empty() && readMaterialId(cursor, material);
+                if (valid) {
+                    pointReader points(directory + std::string(file));
+                    valid = points.is_open();
+                    if (valid) {
+                        scene.add_spheres(points.getRecords(), material);
+                    }
+                }
+            } else if (command == "plane") {
+                Point point;
+                Vector normal;
+                uint32_t material = 0;
+                valid = readPoint(cursor, point) && readVector(cursor, normal) && readMaterialId(cursor, material);
+                if (valid) {
+                    scene.add_plane(point, normal, material);
+                }
+            } else if (command == "mesh" || command == "instance") {
+                valid = readInstance(cursor, scene, directory, useCache, threads, command == "instance");
+            } else if (command == "light") {
+                Light light;
+                valid = readPoint(cursor, light.position) && readVector(cursor, light.intensity);
+                if (valid) {
+                    scene.add_light(light);
+                }
+            } else if (command == "ambient") {
+                valid = readVector(cursor, scene.ambient);
+            } else if (command == "camera") {
+                valid = readCamera(cursor, scene.view);
+            } else if (command == "image") {
+                long width = 0, height = 0;
+                cursor.skip_blanks();
+                valid = cursor.read_int(width);
+                cursor.skip_blanks();
+                valid = valid && cursor.read_int(height) && width > 0 && height > 0;
+                if (valid) {
+                    scene.view.width = static_cast<uint32_t>(width);
+                    scene.view.height = static_cast<uint32_t>(height);
+                }
+            }
+
+            if (!valid) {
+                std::cerr << filename << ":" << line << ": linha inválida ignorada" << std::endl;
+            }
+            cursor.next_line();
+        }
+    }
+
+    bool is_open() const {
+        return opened;
+    }
+
+    // Quantidade de .obj lidos
+    size_t objCount() const {
+        return objs.size();
+    }
+
+    // Indica se as malhas do .obj de índice id estão no disco (e não há objReader para ele)
+    bool isOutOfCore(size_t id) const {
+        return !objs[id].obj;
+    }
+
+    // objReader do .obj de índice id (para ler e gravar as BVHs no cache dele); só existe quando
+    // isOutOfCore(id) é false
+    objReader& getObj(size_t id) {
+        return *objs[id].obj;
+    }
+
+    // Nomes dos grupos do .obj de índice id, na ordem das malhas
+    const std::vector<std::string>& getGroupNames(size_t id) const {
+        return objs[id].groupNames;
+    }
+
+    // Id no Scene da malha do primeiro grupo do .obj de índice id; os outros grupos vêm em seguida
+    uint32_t getFirstMesh(size_t id) const {
+        return objs[id].firstMesh;
+    }
+
+    // Índice em objs do .obj de path, se ele já foi lido
+    bool findObj(const std::string& path, size_t& id) const {
+        auto found = objIds.find(canonicalPath(path));
+        if (found == objIds.end()) {
+            return false;
+        }
+        id = found->second;
+        return true;
+    }
+
+    // Quantidade de linhas "mesh"/"instance" lidas
+    size_t placementCount() const {
+        return placements.size();
+    }
+
+    // Instâncias [first, first + count) criadas pela linha "mesh"/"instance" de índice id
+    void getPlacement(size_t id, uint32_t& first, uint32_t& count) const {
+        first = placements[id].firstInstance;
+        count = placements[id].count;
+    }
+};
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef TEXTPARSERHEADER
+#define TEXTPARSERHEADER
+
+/*
+Ferramentas para ler arquivos de texto grandes (.obj, .mtl) sem alocar memória por linha.
+
+    - mappedFile: mapeia o arquivo inteiro na memória (mmap). Em sistemas sem mmap o arquivo
+      é lido de uma vez para um único buffer.
+    - textCursor: percorre um trecho do arquivo, separando palavras e convertendo números
+      direto do texto com std::from_chars.
+*/
+
+#include <charconv>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32)
+#define TEXTPARSER_NO_MMAP
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class mappedFile {
+
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+    bool opened = false;
+#ifdef TEXTPARSER_NO_MMAP
+    std::vector<char> buffer;
+#else
+    void* mapping = nullptr;
+#endif
+
+public:
+    explicit mappedFile(const std::string& path) {
+#ifdef TEXTPARSER_NO_MMAP
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            return;
+        }
+        buffer.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        data = buffer.data();
+        length = buffer.size();
+        opened = true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+
+        struct stat info;
+        if (::fstat(fd, &info) == 0) {
+            opened = true;
+            length = static_cast<size_t>(info.st_size);
+            if (length > 0) {
+                mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping == MAP_FAILED) {
+                    mapping = nullptr;
+                    length = 0;
+                    opened = false;
+                } else {
+                    ::madvise(mapping, length, MADV_SEQUENTIAL);
+                    data = static_cast<const char*>(mapping);
+                }
+            }
+        }
+        ::close(fd);
+#endif
+    }
+
+    ~mappedFile() {
+#ifndef TEXTPARSER_NO_MMAP
+        if (mapping) {
+            ::munmap(mapping, length);
+        }
+#endif
+    }
+
+    mappedFile(const mappedFile&) = delete;
+    mappedFile& operator=(const mappedFile&) = delete;
+
+    bool is_open() const { return opened; }
+    const char* begin() const { return data; }
+    const char* end() const { return data + length; }
+    size_t size() const { return length; }
+};
+
+struct textCursor {
+    const char* p;
+    const char* end;
+
+    textCursor(const char* begin, const char* end) : p(begin), end(end) {}
+
+    bool at_end() const { return p >= end; }
+
+    // Pula espaços e tabs (e o \r de arquivos do Windows), sem passar para a próxima linha
+    void skip_blanks() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            ++p;
+        }
+    }
+
+    bool at_line_end() {
+        skip_blanks();
+        return p >= end || *p == '\n' || *p == '#';
+    }
+
+    void next_line() {
+        while (p < end && *p != '\n') {
+            ++p;
+        }
+        if (p < end) {
+            ++p;
+        }
+    }
+
+    // Próxima palavra da linha (vazia no fim da linha); aponta direto para o texto do arquivo
+    std::string_view token() {
+        skip_blanks();
+        const char* start = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+            ++p;
+        }
+        return std::string_view(start, static_cast<size_t>(p - start));
+    }
+
+    bool read_float(float& value) {
+        skip_blanks();
+        // from_chars não aceita '+' no início
+        if (p < end && *p == '+') {
+            ++p;
+        }
+        auto result = std::from_chars(p, end, value);
+        if (result.ec != std::errc()) {
+            return false;
+        }
+        p = result.ptr;
+        return true;
+    }
+
+    bool read_int(long& value) {
+        auto result = std::from_chars(p, end, value);
+        if (result.ec != std::errc()) {
+            return false;
+        }
+        p = result.ptr;
+        return true;
+    }
+
+    bool consume(char c) {
+        if (p < end && *p == c) {
+            ++p;
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif
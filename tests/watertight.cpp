@@ -0,0 +1,200 @@
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../src/accel/bvh.h"
+#include "../src/accel/wide_bvh.h"
+#include "../src/geometry/quantized_triangle_store.h"
+#include "../src/geometry/triangle_store.h"
+#include "../src/kernels/kernels.h"
+#include "../src/lib/point.h"
+#include "../src/lib/ray.h"
+#include "../src/lib/vector.h"
+
+// Malha fechada em volta da origem: um octaedro subdividido, com cada vértice
+// levado para a esfera e afastado do centro por um fator pseudoaleatório, para
+// que nenhuma aresta fique alinhada com os eixos. Os vértices são
+// compartilhados entre os triângulos vizinhos.
+struct ClosedMesh
+{
+    std::vector<Point> vertices {};
+    std::vector<uint32_t> indices {};
+};
+
+float jitter(uint32_t i)
+{
+    i = (i ^ 61u) ^ (i >> 16);
+    i *= 9u;
+    i ^= i >> 4;
+    i *= 0x27d4eb2du;
+    i ^= i >> 15;
+    return 0.9f + 0.2f * static_cast<float>(i & 0xffffu) / 65535.0f;
+}
+
+ClosedMesh make_mesh(int subdivisions)
+{
+    ClosedMesh mesh;
+    mesh.vertices = { Point { 1, 0, 0 }, Point { -1, 0, 0 }, Point { 0, 1, 0 },
+                      Point { 0, -1, 0 }, Point { 0, 0, 1 }, Point { 0, 0, -1 } };
+    mesh.indices = { 0, 2, 4, 2, 1, 4, 1, 3, 4, 3, 0, 4, 2, 0, 5, 1, 2, 5, 3, 1, 5, 0, 3, 5 };
+
+    for (int level = 0; level < subdivisions; ++level)
+    {
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t> midpoints;
+        auto midpoint = [&](uint32_t a, uint32_t b) {
+            const std::pair<uint32_t, uint32_t> key { std::min(a, b), std::max(a, b) };
+            auto found = midpoints.find(key);
+            if (found != midpoints.end())
+            {
+                return found->second;
+            }
+            const Point& p = mesh.vertices[a];
+            const Point& q = mesh.vertices[b];
+            mesh.vertices.push_back(Point { (p.x + q.x) / 2, (p.y + q.y) / 2, (p.z + q.z) / 2 });
+            return midpoints[key] = static_cast<uint32_t>(mesh.vertices.size() - 1);
+        };
+
+        std::vector<uint32_t> finer;
+        for (size_t i = 0; i < mesh.indices.size(); i += 3)
+        {
+            const uint32_t a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+            const uint32_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+            finer.insert(finer.end(), { a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca });
+        }
+        mesh.indices.swap(finer);
+    }
+
+    for (uint32_t i = 0; i < mesh.vertices.size(); ++i)
+    {
+        Point& p = mesh.vertices[i];
+        const float scale = jitter(i) / std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+        p = Point { p.x * scale, p.y * scale, p.z * scale };
+    }
+    return mesh;
+}
+
+// Direções dos raios disparados de origin: uma grade em latitude e longitude,
+// mais uma na direção de cada vértice e de cada ponto médio de aresta, onde
+// os raios passam rente às arestas compartilhadas.
+std::vector<Vector> make_directions(const ClosedMesh& mesh, const Point& origin, int rows)
+{
+    const float pi = 3.14159265f;
+    std::vector<Vector> directions;
+    for (int row = 0; row < rows; ++row)
+    {
+        const float theta = pi * (row + 0.5f) / rows;
+        for (int column = 0; column < 2 * rows; ++column)
+        {
+            const float phi = pi * column / rows;
+            directions.push_back(
+                Vector { std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta) });
+        }
+    }
+
+    for (const Point& p : mesh.vertices)
+    {
+        directions.push_back((p - origin).normalized());
+    }
+    for (size_t i = 0; i < mesh.indices.size(); ++i)
+    {
+        const Point& p = mesh.vertices[mesh.indices[i]];
+        const Point& q = mesh.vertices[mesh.indices[i % 3 == 2 ? i - 2 : i + 1]];
+        const Point middle { (p.x + q.x) / 2, (p.y + q.y) / 2, (p.z + q.z) / 2 };
+        directions.push_back((middle - origin).normalized());
+    }
+    return directions;
+}
+
+// Conta os raios que escapam da malha; de dentro de uma malha fechada, todo
+// raio tem que acertar algum triângulo.
+template <typename Tree, typename Hit>
+size_t count_escapes(const Tree& bvh, const Point& origin, const std::vector<Vector>& directions, Hit&& hit)
+{
+    size_t escapes = 0;
+    for (const Vector& direction : directions)
+    {
+        const Ray ray { origin, direction };
+        float t_max = 1e30f;
+        uint32_t id {};
+        const bool found = bvh.traverse(ray, t_max, [&](uint32_t first, uint32_t count, float& t) {
+            return hit(first, count, ray, t, id);
+        });
+        escapes += found ? 0 : 1;
+    }
+    return escapes;
+}
+
+int main()
+{
+    const ClosedMesh mesh = make_mesh(6);
+
+    Geometry::TriangleStore triangles { mesh.vertices, mesh.indices };
+    Accel::BVH bvh;
+    bvh.build(triangles.all_bounds());
+    triangles.reorder(bvh.get_indices());
+
+    // Malha comprimida montada como em Scene: as caixas são reajustadas aos
+    // triângulos decodificados e viram a BVH quantizada de oito filhos
+    Geometry::QuantizedTriangleStore quantized { mesh.vertices, mesh.indices, triangles };
+    Accel::BVH refitted = bvh;
+    refitted.refit(quantized.all_bounds());
+    Accel::WideBVH wide;
+    std::vector<uint32_t> order;
+    if (!wide.build(refitted, order))
+    {
+        std::cout << "Could not build the wide BVH\n";
+        return 1;
+    }
+    quantized.reorder(order);
+
+    // O centro e um ponto fora de qualquer plano de simetria
+    const Point origins[] { Point { 0, 0, 0 }, Point { 0.137f, -0.213f, 0.071f } };
+
+    bool passed = true;
+    auto check = [&](const std::string& name, size_t escapes, size_t rays) {
+        std::cout << name << ": " << escapes << " of " << rays << " rays escaped\n";
+        passed = passed && escapes == 0;
+    };
+
+    for (const Point& origin : origins)
+    {
+        const std::vector<Vector> directions = make_directions(mesh, origin, 256);
+
+        check("scalar", count_escapes(bvh, origin, directions,
+                                      [&](uint32_t first, uint32_t count, const Ray& ray, float& t, uint32_t& id) {
+                                          bool found { false };
+                                          for (uint32_t i = first; i < first + count; ++i)
+                                          {
+                                              if (triangles.hit(i, ray, t))
+                                              {
+                                                  id = i;
+                                                  found = true;
+                                              }
+                                          }
+                                          return found;
+                                      }),
+              directions.size());
+
+        for (const std::string& name : Kernels::available())
+        {
+            Kernels::use(*Kernels::find(name));
+            check(name, count_escapes(bvh, origin, directions,
+                                      [&](uint32_t first, uint32_t count, const Ray& ray, float& t, uint32_t& id) {
+                                          return triangles.hit(first, count, ray, t, id);
+                                      }),
+                  directions.size());
+            check(name + " quantized",
+                  count_escapes(wide, origin, directions,
+                                [&](uint32_t first, uint32_t count, const Ray& ray, float& t, uint32_t& id) {
+                                    return quantized.hit(first, count, ray, t, id);
+                                }),
+                  directions.size());
+        }
+    }
+
+    std::cout << (passed ? "Watertight\n" : "Rays escaped a closed mesh\n");
+    return passed ? 0 : 1;
+}